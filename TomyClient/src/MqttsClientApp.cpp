@@ -78,16 +78,11 @@ int main(int argc, char **argv){
     MQString* on = new MQString("on");
     MQString* off = new MQString("off");
 
-    XTimer tm = XTimer();
-
     while(true){
 
 		for(int i = 0; i < 10; i++){
 			mqtts.publish(topic1,(i % 2 ? on : off));
-			tm.start(5000);
-			while(!tm.isTimeUp()){
-				mqtts.exec();
-			}
+			mqtts.recvMsg(5000);
 		}
 		//mqtts.setClean(false);
 		//mqtts.disconnect();
@@ -0,0 +1,110 @@
+/*
+ * BenchUtil.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Heap counter and timer of the benchmarks.
+ *
+ *  calloc/malloc/free and read/readv are counted with the linker's --wrap,
+ *  operator new and delete by the replacements below. Linux only.
+ */
+
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <new>
+
+static unsigned long theAllocCnt;
+static unsigned long theReadCnt;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void  __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size){
+    theAllocCnt++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size){
+    theAllocCnt++;
+    return __real_calloc(nmemb, size);
+}
+
+void __wrap_free(void* ptr){
+    __real_free(ptr);
+}
+
+ssize_t __real_read(int fd, void* buf, size_t count);
+ssize_t __real_readv(int fd, const struct iovec* iov, int iovcnt);
+
+ssize_t __wrap_read(int fd, void* buf, size_t count){
+    theReadCnt++;
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_readv(int fd, const struct iovec* iov, int iovcnt){
+    theReadCnt++;
+    return __real_readv(fd, iov, iovcnt);
+}
+}
+
+void* operator new(size_t size){
+    theAllocCnt++;
+    void* ptr = __real_malloc(size);
+    if (ptr == NULL){
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) throw(){
+    __real_free(ptr);
+}
+
+double getTime(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void report(const char* name, double sec, unsigned long allocs, long cnt){
+    printf("%-28s %8.1f ns/msg %6.2f allocs/msg\n", name, sec * 1e9 / cnt, (double)allocs / cnt);
+}
+
+unsigned long getAllocCount(){
+    return theAllocCnt;
+}
+
+unsigned long getReadCount(){
+    return theReadCnt;
+}
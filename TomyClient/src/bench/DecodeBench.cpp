@@ -0,0 +1,178 @@
+/*
+ * DecodeBench.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Decode time and heap use of received messages, the message classes
+ *  with a copy of the frame against the views in place.
+ *
+ *  $ DecodeBench [-n messages]
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MQTTS.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void setResponse(ZBResponse* resp, uint8_t* frame){
+    resp->setPayload(frame);
+    resp->setPayloadLength(frame[0]);
+}
+
+int main(int argc, char** argv){
+    long cnt = 1000000;
+    int opt;
+    unsigned long sum = 0;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1){
+        switch (opt){
+        case 'n':
+            cnt = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n messages]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    uint8_t pubAck[MQTTS_LEN_PUBACK];
+    uint8_t subAck[MQTTS_LEN_SUBACK];
+    uint8_t regist[MQTTS_MAX_PACKET_LENGTH];
+    uint8_t publish[MQTTS_MAX_PACKET_LENGTH];
+    uint8_t data[16];
+    MQString topic("sensor/temperature");
+    ZBResponse resp;
+    memset(data, 0x5a, sizeof(data));
+
+    MqttsEncoder enc(pubAck, sizeof(pubAck));
+    enc.pubAck(0x1234, 0x5678, MQTTS_RC_ACCEPTED);
+    subAck[0] = MQTTS_LEN_SUBACK;
+    subAck[1] = MQTTS_TYPE_SUBACK;
+    subAck[2] = MQTTS_FLAG_QOS_1;
+    setUint16(subAck + 3, 0x1234);
+    setUint16(subAck + 5, 0x5678);
+    subAck[7] = MQTTS_RC_ACCEPTED;
+    MqttsEncoder regEnc(regist, sizeof(regist));
+    regEnc.registerTopic(0x1234, 0x5678, &topic);
+    MqttsEncoder pubEnc(publish, sizeof(publish));
+    pubEnc.publish(MQTTS_FLAG_QOS_1, 0x1234, 0x5678, data, sizeof(data));
+
+    printf("%ld messages\n", cnt);
+
+    /*---- PUBACK ----*/
+    setResponse(&resp, pubAck);
+    unsigned long allocs = getAllocCount();
+    double start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPubAck msg = MqttsPubAck();
+        memcpy(msg.getMsgBuff(), resp.getPayload(), resp.getPayload(0));
+        sum += msg.getMsgId() + msg.getReturnCode();
+    }
+    report("MqttsPubAck + copy", getTime() - start, getAllocCount() - allocs, cnt);
+
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPubAckView msg;
+        if (msg.set(&resp)){
+            sum += msg.getMsgId() + msg.getReturnCode();
+        }
+    }
+    report("MqttsPubAckView", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- SUBACK ----*/
+    setResponse(&resp, subAck);
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsSubAck msg = MqttsSubAck();
+        memcpy(msg.getMsgBuff(), resp.getPayload(), resp.getPayload(0));
+        sum += msg.getMsgId() + msg.getTopicId() + msg.getReturnCode();
+    }
+    report("MqttsSubAck + copy", getTime() - start, getAllocCount() - allocs, cnt);
+
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsSubAckView msg;
+        if (msg.set(&resp)){
+            sum += msg.getMsgId() + msg.getTopicId() + msg.getReturnCode();
+        }
+    }
+    report("MqttsSubAckView", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- REGISTER ----*/
+    setResponse(&resp, regist);
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsRegister msg = MqttsRegister();
+        msg.setFrame(&resp);
+        sum += msg.getTopicId() + msg.getTopicName()->getCharLength();
+    }
+    report("MqttsRegister::setFrame()", getTime() - start, getAllocCount() - allocs, cnt);
+
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsRegisterView msg;
+        if (msg.set(&resp)){
+            MQString name;
+            msg.getTopicName(&name);
+            sum += msg.getTopicId() + name.getCharLength();
+        }
+    }
+    report("MqttsRegisterView", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- PUBLISH ----*/
+    setResponse(&resp, publish);
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPublish msg = MqttsPublish();
+        msg.setFrame(&resp);
+        sum += msg.getTopicId() + msg.getData()[0];
+    }
+    report("MqttsPublish::setFrame()", getTime() - start, getAllocCount() - allocs, cnt);
+
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPublishView msg;
+        if (msg.set(&resp)){
+            sum += msg.getTopicId() + msg.getData()[0];
+        }
+    }
+    report("MqttsPublishView", getTime() - start, getAllocCount() - allocs, cnt);
+
+    return (sum == 0xffffffff ? 2 : 0);     // keeps the loops
+}
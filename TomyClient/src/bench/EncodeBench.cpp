@@ -0,0 +1,148 @@
+/*
+ * EncodeBench.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Encode throughput and heap use of the message classes and MqttsEncoder.
+ *
+ *  $ EncodeBench [-n messages] [-s payload size]
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MQTTS.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+MQTTS_STATIC_ASSERT(MQTTS_MAX_PACKET_LENGTH >= 7 + 1, publish_fits);
+
+int main(int argc, char** argv){
+    long cnt = 1000000;
+    int size = 16;
+    int opt;
+    unsigned long sum = 0;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1){
+        switch (opt){
+        case 'n':
+            cnt = atol(optarg);
+            break;
+        case 's':
+            size = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n messages] [-s payload size]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (size < 0 || size > MQTTS_MAX_PACKET_LENGTH - 7){
+        fprintf(stderr, "payload size is 0 to %d\n", MQTTS_MAX_PACKET_LENGTH - 7);
+        return 1;
+    }
+
+    uint8_t data[MQTTS_MAX_PACKET_LENGTH];
+    uint8_t frame[MQTTS_MAX_PACKET_LENGTH];
+    uint8_t ack[MQTTS_LEN_PUBACK];
+    memset(data, 0x5a, sizeof(data));
+
+    /*---- both write the same frames ----*/
+    {
+        MqttsPublish pub = MqttsPublish();
+        pub.setFlags(MQTTS_FLAG_QOS_1);
+        pub.setTopicId(0x1234);
+        pub.setMsgId(0x5678);
+        pub.setData(data, size);
+        MqttsEncoder enc(frame, sizeof(frame));
+        if (enc.publish(MQTTS_FLAG_QOS_1, 0x1234, 0x5678, data, size) != pub.getLength() ||
+            memcmp(frame, pub.getMsgBuff(), pub.getLength())){
+            printf("PUBLISH frames differ\n");
+            return 1;
+        }
+        MqttsPubAck pubAck = MqttsPubAck();
+        pubAck.setTopicId(0x1234);
+        pubAck.setMsgId(0x5678);
+        pubAck.setReturnCode(MQTTS_RC_ACCEPTED);
+        MqttsEncoder ackEnc(ack, sizeof(ack));
+        if (ackEnc.pubAck(0x1234, 0x5678, MQTTS_RC_ACCEPTED) != pubAck.getLength() ||
+            memcmp(ack, pubAck.getMsgBuff(), pubAck.getLength())){
+            printf("PUBACK frames differ\n");
+            return 1;
+        }
+    }
+    printf("%ld messages, PUBLISH payload %d bytes\n", cnt, size);
+
+    /*---- MqttsPublish::setData() ----*/
+    unsigned long allocs = getAllocCount();
+    double start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPublish pub = MqttsPublish();
+        pub.setFlags(MQTTS_FLAG_QOS_1);
+        pub.setTopicId(0x1234);
+        pub.setMsgId((uint16_t)i);
+        pub.setData(data, size);
+        sum += pub.getMsgBuff()[6];
+    }
+    report("MqttsPublish::setData()", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- MqttsEncoder::publish() ----*/
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsEncoder enc(frame, sizeof(frame));
+        enc.publish(MQTTS_FLAG_QOS_1, 0x1234, (uint16_t)i, data, size);
+        sum += frame[6];
+    }
+    report("MqttsEncoder::publish()", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- MqttsPubAck ----*/
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsPubAck pubAck = MqttsPubAck();
+        pubAck.setTopicId(0x1234);
+        pubAck.setMsgId((uint16_t)i);
+        pubAck.setReturnCode(MQTTS_RC_ACCEPTED);
+        sum += pubAck.getMsgBuff()[5];
+    }
+    report("MqttsPubAck", getTime() - start, getAllocCount() - allocs, cnt);
+
+    /*---- MqttsEncoder::pubAck() ----*/
+    allocs = getAllocCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        MqttsEncoder enc(ack, sizeof(ack));
+        enc.pubAck(0x1234, (uint16_t)i, MQTTS_RC_ACCEPTED);
+        sum += ack[5];
+    }
+    report("MqttsEncoder::pubAck()", getTime() - start, getAllocCount() - allocs, cnt);
+
+    return (sum == 0xffffffff ? 2 : 0);     // keeps the loops
+}
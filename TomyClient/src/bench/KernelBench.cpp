@@ -0,0 +1,244 @@
+/*
+ * KernelBench.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Escape, unescape and checksum kernels of ZBeeStack against plain
+ *  byte loops, which are also the reference of the results.
+ *  Prints MB/s for buffers with no, few and many escaped bytes.
+ *
+ *  $ KernelBench [-n buffers] [-s buffer size]
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/ZBeeStack.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace tomyClient;
+
+#define MAX_SIZE  1024
+
+/*---- scalar references ----*/
+static bool needsEscape(uint8_t b){
+    return b == START_BYTE || b == ESCAPE || b == XON || b == XOFF;
+}
+
+static uint16_t refEscape(uint8_t* dst, const uint8_t* src, uint16_t len, uint8_t* checksum){
+    uint16_t pos = 0;
+    for (uint16_t i = 0; i < len; i++){
+        *checksum += src[i];
+        if (needsEscape(src[i])){
+            dst[pos++] = ESCAPE;
+            dst[pos++] = src[i] ^ 0x20;
+        }else{
+            dst[pos++] = src[i];
+        }
+    }
+    return pos;
+}
+
+static uint16_t refUnescape(uint8_t* dst, const uint8_t* src, uint16_t len, uint8_t* checksum){
+    uint16_t pos = 0;
+    for (uint16_t i = 0; i < len; i++){
+        uint8_t b = src[i];
+        if (b == ESCAPE){
+            b = src[++i] ^ 0x20;
+        }
+        *checksum += b;
+        dst[pos++] = b;
+    }
+    return pos;
+}
+
+static uint8_t refChecksum(const uint8_t* buf, uint16_t len){
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < len; i++){
+        sum += buf[i];
+    }
+    return sum;
+}
+
+/*
+ *  Random bytes, every 1/rate of them one of the escaped values.
+ */
+static void fill(uint8_t* buf, uint16_t len, int rate){
+    static const uint8_t esc[] = {START_BYTE, ESCAPE, XON, XOFF};
+    for (uint16_t i = 0; i < len; i++){
+        do {
+            buf[i] = rand() & 0xff;
+        } while (needsEscape(buf[i]));
+        if (rate && rand() % rate == 0){
+            buf[i] = esc[rand() % 4];
+        }
+    }
+}
+
+/*
+ *  Compare the kernels with the references at every length and
+ *  alignment, the unescape also fed in two pieces.
+ */
+static long verify(){
+    static uint8_t src[MAX_SIZE + 16];
+    static uint8_t esc[MAX_SIZE * 2 + 16];
+    static uint8_t ref[MAX_SIZE * 2 + 16];
+    static uint8_t dst[MAX_SIZE + 16];
+    long bad = 0;
+
+    for (int rate = 0; rate <= 16; rate += 4){
+        for (uint16_t len = 0; len <= 300; len++){
+            uint8_t align = len % 16;
+            fill(src + align, len, rate);
+
+            uint8_t sum = 0;
+            uint8_t refSum = 0;
+            uint16_t escLen = zbEscape(esc + align, src + align, len, &sum);
+            uint16_t refLen = refEscape(ref, src + align, len, &refSum);
+            if (escLen != refLen || memcmp(esc + align, ref, refLen) || sum != refSum){
+                printf("zbEscape differs: len %d rate %d\n", len, rate);
+                bad++;
+                continue;
+            }
+            if (zbChecksum(src + align, len) != refChecksum(src + align, len)){
+                printf("zbChecksum differs: len %d\n", len);
+                bad++;
+            }
+            refSum = 0;
+            refUnescape(ref, esc + align, escLen, &refSum);
+
+            uint16_t split = (escLen ? rand() % escLen : 0);
+            uint16_t used;
+            bool escape = false;
+            sum = 0;
+            uint16_t pos = zbUnescape(dst, len, esc + align, split, &used, &escape, &sum);
+            pos += zbUnescape(dst + pos, len - pos, esc + align + used, escLen - used, &used, &escape, &sum);
+            if (pos != len || memcmp(dst, ref, len) || sum != refSum || escape){
+                printf("zbUnescape differs: len %d rate %d split %d\n", len, rate, split);
+                bad++;
+            }
+        }
+    }
+    return bad;
+}
+
+static void result(const char* name, double sec, long bytes){
+    printf("%-28s %10.1f MB/s\n", name, bytes / sec / 1e6);
+}
+
+int main(int argc, char** argv){
+    long cnt = 200000;
+    int size = 128;
+    int opt;
+    unsigned long sum = 0;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1){
+        switch (opt){
+        case 'n':
+            cnt = atol(optarg);
+            break;
+        case 's':
+            size = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n buffers] [-s buffer size]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (size < 1 || size > MAX_SIZE){
+        fprintf(stderr, "buffer size is 1 to %d\n", MAX_SIZE);
+        return 1;
+    }
+    srand(1);
+    long bad = verify();
+    printf("kernels against references: %s\n", (bad ? "FAIL" : "OK"));
+
+#ifdef __SSE2__
+    printf("%ld buffers of %d bytes, SSE2\n", cnt, size);
+#else
+    printf("%ld buffers of %d bytes, word\n", cnt, size);
+#endif
+    static uint8_t src[MAX_SIZE];
+    static uint8_t esc[MAX_SIZE * 2];
+    static uint8_t dst[MAX_SIZE];
+    static const int rates[] = {0, 64, 8};
+    static const char* names[] = {"no escape", "1/64 escaped", "1/8 escaped"};
+
+    for (int r = 0; r < 3; r++){
+        fill(src, size, rates[r]);
+        uint8_t cs = 0;
+        uint16_t escLen = refEscape(esc, src, size, &cs);
+        printf("-- %s\n", names[r]);
+
+        double start = getTime();
+        for (long i = 0; i < cnt; i++){
+            sum += refEscape(dst, src, size, &cs);
+        }
+        result("byte loop escape", getTime() - start, cnt * size);
+        start = getTime();
+        for (long i = 0; i < cnt; i++){
+            sum += zbEscape(esc, src, size, &cs);
+        }
+        result("zbEscape", getTime() - start, cnt * size);
+
+        start = getTime();
+        for (long i = 0; i < cnt; i++){
+            sum += refUnescape(dst, esc, escLen, &cs);
+        }
+        result("byte loop unescape", getTime() - start, cnt * size);
+        start = getTime();
+        for (long i = 0; i < cnt; i++){
+            uint16_t used;
+            bool escape = false;
+            sum += zbUnescape(dst, size, esc, escLen, &used, &escape, &cs);
+        }
+        result("zbUnescape", getTime() - start, cnt * size);
+    }
+
+    printf("-- checksum\n");
+    double start = getTime();
+    for (long i = 0; i < cnt; i++){
+        src[i % size] = i;
+        sum += refChecksum(src, size);
+    }
+    result("byte loop checksum", getTime() - start, cnt * size);
+    start = getTime();
+    for (long i = 0; i < cnt; i++){
+        src[i % size] = i;
+        sum += zbChecksum(src, size);
+    }
+    result("zbChecksum", getTime() - start, cnt * size);
+
+    if (sum == 0xffffffff){
+        return 2;           // keeps the loops
+    }
+    return (bad ? 1 : 0);
+}
@@ -0,0 +1,174 @@
+/*
+ * SerialBench.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Serial receive over a pty pair, one read() per byte against the
+ *  buffered SerialPort. Prints read syscalls per frame and bytes/s.
+ *
+ *  $ SerialBench [-n frames] [-s frame size]
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/ZBeeStack.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+using namespace tomyClient;
+
+#define FRAMES_PER_BATCH  8        // a batch stays below the pty buffer
+
+static int theFrameSize = 64;
+
+/*
+ *  An escape-free API frame of theFrameSize bytes.
+ */
+static void makeFrame(uint8_t* buf){
+    uint16_t len = theFrameSize - 4;
+    buf[0] = START_BYTE;
+    buf[1] = 0;
+    buf[2] = len;
+    for (uint16_t i = 0; i < len; i++){
+        buf[3 + i] = 0x20 + (i % 0x5b);
+    }
+    buf[theFrameSize - 1] = 0xff - zbChecksum(buf + 3, len);
+}
+
+static void waitIn(int fd){
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, 1000);
+}
+
+static void sendBatch(int master, uint8_t* batch, int len){
+    int pos = 0;
+    while (pos < len){
+        int n = write(master, batch + pos, len - pos);
+        if (n > 0){
+            pos += n;
+        }else if (n < 0 && errno != EINTR && errno != EAGAIN){
+            perror("write");
+            exit(1);
+        }
+    }
+}
+
+static void result(const char* name, double sec, unsigned long reads, long frames){
+    printf("%-28s %8.2f reads/frame %10.0f bytes/s\n", name,
+           (double)reads / frames, frames * theFrameSize / sec);
+}
+
+int main(int argc, char** argv){
+    long cnt = 20000;
+    int opt;
+    unsigned long sum = 0;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1){
+        switch (opt){
+        case 'n':
+            cnt = atol(optarg);
+            break;
+        case 's':
+            theFrameSize = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n frames] [-s frame size]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (theFrameSize < 5 || theFrameSize > 255){
+        fprintf(stderr, "frame size is 5 to 255\n");
+        return 1;
+    }
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0){
+        perror("posix_openpt");
+        return 1;
+    }
+    SerialPort port;
+    if (port.begin(ptsname(master), B115200) < 0){
+        perror("SerialPort::begin");
+        return 1;
+    }
+    int batchLen = theFrameSize * FRAMES_PER_BATCH;
+    uint8_t* batch = (uint8_t*)malloc(batchLen);
+    for (int i = 0; i < FRAMES_PER_BATCH; i++){
+        makeFrame(batch + i * theFrameSize);
+    }
+    cnt -= cnt % FRAMES_PER_BATCH;
+    printf("%ld frames of %d bytes\n", cnt, theFrameSize);
+
+    /*---- one read() per byte ----*/
+    int fd = port.getFd();
+    unsigned long reads = getReadCount();
+    double start = getTime();
+    for (long i = 0; i < cnt; i += FRAMES_PER_BATCH){
+        sendBatch(master, batch, batchLen);
+        for (int got = 0; got < batchLen; ){
+            uint8_t b;
+            if (read(fd, &b, 1) == 1){
+                sum += b;
+                got++;
+            }else{
+                waitIn(fd);
+            }
+        }
+    }
+    result("read() per byte", getTime() - start, getReadCount() - reads, cnt);
+
+    /*---- SerialPort ----*/
+    reads = getReadCount();
+    start = getTime();
+    for (long i = 0; i < cnt; i += FRAMES_PER_BATCH){
+        sendBatch(master, batch, batchLen);
+        for (int got = 0; got < batchLen; ){
+            uint8_t* buf;
+            int len = port.peek(&buf);
+            if (len > 0){
+                sum += buf[0];
+                port.skip(len);
+                got += len;
+            }else{
+                port.waitRecv(1000);
+            }
+        }
+    }
+    result("SerialPort::peek()", getTime() - start, getReadCount() - reads, cnt);
+
+    free(batch);
+    close(master);
+    return (sum == 0xffffffff ? 2 : 0);     // keeps the loops
+}
@@ -0,0 +1,166 @@
+/*
+ * ShmBench.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Round trip latency of ShmStack. A child process on the Gateway side
+ *  sends every message back. Messages are sent back to back, where the
+ *  reader is still polling, and with a gap, where it sleeps on the futex.
+ *
+ *  $ ShmBench [-n messages] [-g gap in usec]
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MQTTS.h"
+#include "../mqttslib/ShmStack.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace tomyClient;
+
+#define SHM_NAME  "/mqtts-shmbench"
+
+static ShmStack theGateway;
+static ShmStack theClient;
+static int theRecvCnt;
+
+static void echoHandler(ZBResponse* resp, int* returnCode, void* arg){
+    theGateway.send(resp->getPayload(), resp->getPayloadLength(), 0, UcastReq);
+}
+
+static void recvHandler(ZBResponse* resp, int* returnCode, void* arg){
+    theRecvCnt++;
+}
+
+static void runEcho(){
+    theGateway.setRxHandler(echoHandler, NULL);
+    for (;;){
+        if (theGateway.waitPacket(1000)){
+            theGateway.readPacket();
+        }
+    }
+}
+
+/*
+ *  Mean, median, 99th percentile and maximum in micro seconds.
+ */
+static void result(const char* name, double* lat, long cnt){
+    double sum = 0;
+    for (long i = 0; i < cnt; i++){
+        sum += lat[i];
+    }
+    std::sort(lat, lat + cnt);
+    printf("%-28s %8.2f mean %8.2f p50 %8.2f p99 %9.2f max usec\n", name,
+           sum / cnt * 1e6, lat[cnt / 2] * 1e6, lat[cnt * 99 / 100] * 1e6, lat[cnt - 1] * 1e6);
+}
+
+static void measure(const char* name, uint8_t* msg, uint8_t len, double* lat, long cnt, long gap){
+    for (long i = 0; i < cnt; i++){
+        if (gap){
+            usleep(gap);
+        }
+        theRecvCnt = 0;
+        double start = getTime();
+        theClient.send(msg, len, 0, UcastReq);
+        while (theRecvCnt == 0){
+            if (theClient.waitPacket(1000)){
+                theClient.readPacket();
+            }
+        }
+        lat[i] = getTime() - start;
+    }
+    result(name, lat, cnt);
+}
+
+int main(int argc, char** argv){
+    long cnt = 100000;
+    long gap = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:g:")) != -1){
+        switch (opt){
+        case 'n':
+            cnt = atol(optarg);
+            break;
+        case 'g':
+            gap = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n messages] [-g gap in usec]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (cnt < 1){
+        return 1;
+    }
+
+    shm_unlink(SHM_NAME);
+    if (theClient.begin(SHM_NAME, ShmClient) < 0 || theGateway.begin(SHM_NAME, ShmGateway) < 0){
+        perror("ShmStack::begin");
+        return 1;
+    }
+    pid_t pid = fork();
+    if (pid < 0){
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0){
+        runEcho();
+    }
+    theClient.setRxHandler(recvHandler, NULL);
+
+    uint8_t msg[MQTTS_MAX_PACKET_LENGTH];
+    uint8_t data[32];
+    memset(data, 0x5a, sizeof(data));
+    MqttsEncoder enc(msg, sizeof(msg));
+    uint8_t len = enc.publish(MQTTS_FLAG_QOS_0, 0x1234, 0, data, sizeof(data));
+    double* lat = (double*)malloc(sizeof(double) * cnt);
+
+    printf("%ld round trips of %d bytes\n", cnt, len);
+    measure("back to back", msg, len, lat, cnt, 0);
+    long slow = (gap ? (cnt < 2000 ? cnt : 2000) : cnt);
+    char name[40];
+    snprintf(name, sizeof(name), "%ld usec gap", gap);
+    measure(name, msg, len, lat, slow, gap);
+
+    free(lat);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    theClient.close();
+    theGateway.close();
+    shm_unlink(SHM_NAME);
+    return 0;
+}
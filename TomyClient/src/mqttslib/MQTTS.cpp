@@ -222,18 +222,20 @@ void MQString::freeStr(){
  ======================================*/
 MqttsMessage::MqttsMessage(){
     _msgBuff = NULL;
+    _isView = false;
+    _isSlot = false;
     _length = 0;
     _status = 0;
     _type = 0;
 }
 MqttsMessage::~MqttsMessage(){
-    if (_msgBuff != NULL){
-        delete(_msgBuff);
-    }
+    freeBody();
 }
 
 void MqttsMessage::reset(){
     _msgBuff = NULL;
+    _isView = false;
+    _isSlot = false;
     _length = 0;
     _status = 0;
     _type = 0;
@@ -264,13 +266,17 @@ bool MqttsMessage::setBody(uint8_t* body){
     }
 }
 
+/*
+ *  The body has the room for the header and the trailer of the network,
+ *  so the message is sent without a copy.
+ */
 bool MqttsMessage::allocateBody(){
     if ( _length ) {
-        if (_msgBuff){
-              free(_msgBuff);
-        }
-        _msgBuff = (uint8_t*)calloc(_length, sizeof(uint8_t));
+        freeBody();
+        _isView = false;
+        _msgBuff = (uint8_t*)calloc(NW_MAX_HEADROOM + _length + NW_MAX_TAILROOM, sizeof(uint8_t));
         if ( _msgBuff){
+            _msgBuff += NW_MAX_HEADROOM;
             _msgBuff[0] = _length;
             _msgBuff[1] = _type;
             return true;
@@ -281,6 +287,26 @@ bool MqttsMessage::allocateBody(){
         return false;
     }
 }
+void MqttsMessage::freeBody(){
+    if (_msgBuff && !_isView && !_isSlot){
+        free(_msgBuff - NW_MAX_HEADROOM);
+    }
+    _msgBuff = NULL;
+    _isSlot = false;
+}
+
+/*
+ *  Frame over the body and its room. A view of a received frame has no room.
+ */
+bool MqttsMessage::getFrame(FrameBuf* frame){
+    if (_msgBuff == NULL || _isView){
+        return false;
+    }
+    frame->init(_msgBuff - NW_MAX_HEADROOM, NW_MAX_HEADROOM + _length + NW_MAX_TAILROOM, NW_MAX_HEADROOM);
+    frame->put(_length);
+    return true;
+}
+
 void MqttsMessage::setDup(){
 
 }
@@ -321,12 +347,45 @@ void MqttsMessage::setMsgBuff(uint8_t* msgBuff){
     _msgBuff = msgBuff;
 }
 
+/*
+ *  Refer to a received frame in place. The frame belongs to the
+ *  receive buffer pool, so it is neither copied nor freed.
+ */
+void MqttsMessage::setMsgView(uint8_t* frame){
+    freeBody();
+    _msgBuff = frame;
+    _isView = true;
+    _length = frame[0];
+    _type = frame[1];
+}
+
+/*
+ *  Copy of the frame in a slot of the caller, which has the room of the
+ *  network around MQTTS_MAX_PACKET_LENGTH. The slot is not freed.
+ */
+void MqttsMessage::setMsgSlot(uint8_t* slot, uint8_t* frame){
+    freeBody();
+    _msgBuff = slot + NW_MAX_HEADROOM;
+    _isView = false;
+    _isSlot = true;
+    _length = frame[0];
+    _type = frame[1];
+    _status = 0;
+    memcpy(_msgBuff, frame, _length);
+}
+
+/*
+ *  Take over the body of src. The own body is freed first.
+ */
 bool MqttsMessage::copy(MqttsMessage* src){
+    freeBody();
+    _msgBuff = src->_msgBuff;
+    _isView = src->_isView;
+    _isSlot = src->_isSlot;
+    src->setMsgBuff(NULL);
     setLength(src->getLength());
     setType(src->getType());
     setStatus(src->getStatus());
-    _msgBuff = src->_msgBuff;
-    src->setMsgBuff(NULL);
     if (_msgBuff == NULL){
         return false;
     }
@@ -385,7 +444,7 @@ const char* MqttsMessage::getMsgTypeName(){
         Class MqttsAdvrtise
  ======================================*/
 MqttsAdvertise::MqttsAdvertise():MqttsMessage(){
-    setLength(5);
+    setLength(MqttsAdvertiseLayout::Length);
     setType(MQTTS_TYPE_ADVERTISE);
     allocateBody();
 }
@@ -395,28 +454,26 @@ MqttsAdvertise::~MqttsAdvertise(){
 }
 
 void MqttsAdvertise::setGwId(uint8_t id){
-    getBody()[0] = id;
+    MqttsAdvertiseLayout::GwId::set(getBody(), id);
 }
 
 void MqttsAdvertise::MqttsAdvertise::setDuration(uint16_t duration){
-    uint8_t* pos = getBody() + 1;
-    setUint16(pos, duration);
+    MqttsAdvertiseLayout::Duration::set(getBody(), duration);
 }
 
 uint8_t MqttsAdvertise::getGwId(){
-    return getBody()[0];
+    return MqttsAdvertiseLayout::GwId::get(getBody());
 }
 
 uint16_t MqttsAdvertise::getDuration(){
-  uint8_t* pos = getBody() + 1;
-    return getUint16(pos);
+    return MqttsAdvertiseLayout::Duration::get(getBody());
 }
 
 /*=====================================
         Class MqttsSearchgw
  ======================================*/
 MqttsSearchGw::MqttsSearchGw():MqttsMessage(){
-    setLength(3);
+    setLength(MqttsSearchGwLayout::Length);
     setType(MQTTS_TYPE_SEARCHGW);
     allocateBody();
 }
@@ -426,18 +483,18 @@ MqttsSearchGw::~MqttsSearchGw(){
 }
 
 void MqttsSearchGw::setRadius(uint8_t radius){
-  getBody()[0] = radius;
+  MqttsSearchGwLayout::Radius::set(getBody(), radius);
 }
 
 uint8_t MqttsSearchGw::getRadius(){
-  return getBody()[0];
+  return MqttsSearchGwLayout::Radius::get(getBody());
 }
 
 /*=====================================
         Class MqttsGwinfo
  ======================================*/
 MqttsGwInfo::MqttsGwInfo(){
-  setLength(3);
+  setLength(MqttsGwInfoLayout::Length);
   setType(MQTTS_TYPE_GWINFO);
   allocateBody();
 }
@@ -447,22 +504,22 @@ MqttsGwInfo::~MqttsGwInfo(){
 }
 
 uint8_t MqttsGwInfo::getGwId(){
-    return getBody()[0];
+    return MqttsGwInfoLayout::GwId::get(getBody());
 }
 
 void MqttsGwInfo::setGwId(uint8_t id){
-    getBody()[0] = id;
+    MqttsGwInfoLayout::GwId::set(getBody(), id);
 }
 
 /*=====================================
          Class MqttsConnect
   ======================================*/
 MqttsConnect::MqttsConnect(MQString* id){
-    setLength(id->getDataLength() + 6);
+    setLength(MqttsConnectLayout::Length + id->getDataLength());
     allocateBody();
     setType(MQTTS_TYPE_CONNECT);
-    getBody()[1] = MQTTS_PROTOCOL_ID;
-    id->writeBuf(getBody() + 4);
+    MqttsConnectLayout::ProtocolId::set(getBody(), MQTTS_PROTOCOL_ID);
+    id->writeBuf(getBody() + MqttsConnectLayout::Tail);
 }
 
 MqttsConnect::~MqttsConnect(){
@@ -470,43 +527,41 @@ MqttsConnect::~MqttsConnect(){
 }
 
 void MqttsConnect::setFlags(uint8_t flg){
-    getBody()[0] = flg & 0x0c;
+    MqttsConnectLayout::Flags::set(getBody(), flg & MqttsConnectLayout::FlagsMask);
 }
 
 uint8_t MqttsConnect::getFlags(){
-    return getBody()[0];
+    return MqttsConnectLayout::Flags::get(getBody());
 }
 
 void MqttsConnect::setDuration(uint16_t msec){
-    setUint16((uint8_t*)getBody() + 2, msec);
+    MqttsConnectLayout::Duration::set(getBody(), msec);
 }
 
 uint16_t MqttsConnect::getDuration(){
-    return getUint16((uint8_t*)getBody() + 2);
+    return MqttsConnectLayout::Duration::get(getBody());
 }
 
 void MqttsConnect::setClientId(MQString* id){
-    id->writeBuf(getBody() + 4);
-    setLength(id->getDataLength() + 6);
+    id->writeBuf(getBody() + MqttsConnectLayout::Tail);
+    setLength(MqttsConnectLayout::Length + id->getDataLength());
 }
 
 uint8_t* MqttsConnect::getClientId(){
-    return getBody() + 6;
+    return getBody() + MqttsConnectLayout::Tail + 2;
 }
 
 void MqttsConnect::setFrame(uint8_t* data, uint8_t len){
     setLength(len + MQTTS_HEADER_SIZE);
     allocateBody();
     memcpy(getBody(), data, len);
-    getBody()[2] = getUint16(data + 4);
-    getBody()[0] = *(data + 2);
 }
 
 /*=====================================
         Class MqttsConnack
  ======================================*/
 MqttsConnack::MqttsConnack(){
-    setLength(3);
+    setLength(MqttsConnackLayout::Length);
     setType(MQTTS_TYPE_CONNACK);
     allocateBody();
 }
@@ -516,18 +571,18 @@ MqttsConnack::~MqttsConnack(){
 }
 
 void MqttsConnack::setReturnCode(uint8_t rc){
-    getBody()[0] = rc;
+    MqttsConnackLayout::ReturnCode::set(getBody(), rc);
 }
 
 uint8_t MqttsConnack::getReturnCode(){
-    return getBody()[0];
+    return MqttsConnackLayout::ReturnCode::get(getBody());
 }
 
 /*=====================================
        Class MqttsWillTopicReq
 ======================================*/
 MqttsWillTopicReq::MqttsWillTopicReq(){
-    setLength(2);
+    setLength(MqttsWillTopicReqLayout::Length);
     setType(MQTTS_TYPE_WILLTOPICREQ);
     allocateBody();
 }
@@ -540,7 +595,7 @@ MqttsWillTopicReq::~MqttsWillTopicReq(){
          Class MqttsWillTopic
   ======================================*/
 MqttsWillTopic::MqttsWillTopic(){
-    setLength(3);
+    setLength(MqttsWillTopicLayout::Length);
     setType(MQTTS_TYPE_WILLTOPIC);
     allocateBody();
     _flags = 0;
@@ -551,18 +606,18 @@ MqttsWillTopic::~MqttsWillTopic(){
 }
 
 void MqttsWillTopic::setFlags(uint8_t flags){
-    flags &= 0x70;
+    flags &= MqttsWillTopicLayout::FlagsMask;
     if (_msgBuff){
-            getBody()[0] = flags;
+            MqttsWillTopicLayout::Flags::set(getBody(), flags);
     }
     _flags = flags;
 }
 
 void MqttsWillTopic::setWillTopic(MQString* topic){
-    setLength(topic->getDataLength() + 3);
+    setLength(MqttsWillTopicLayout::Length + topic->getDataLength());
     allocateBody();
-    topic->writeBuf(getBody() + 1);
-    _msgBuff[2] = _flags;
+    topic->writeBuf(getBody() + MqttsWillTopicLayout::Tail);
+    MqttsWillTopicLayout::Flags::set(getBody(), _flags);
     _ustring.copy(topic);
 }
 
@@ -575,7 +630,7 @@ MQString* MqttsWillTopic::getWillTopic(){
 }
 
 bool MqttsWillTopic::isWillRequired(){
-    return getBody()[0] && MQTTS_FLAG_WILL;
+    return MqttsWillTopicLayout::Flags::get(getBody()) && MQTTS_FLAG_WILL;
 }
 
 uint8_t MqttsWillTopic::getQos(){
@@ -586,7 +641,7 @@ uint8_t MqttsWillTopic::getQos(){
          Class MqttsWillMsgReq
   ======================================*/
 MqttsWillMsgReq::MqttsWillMsgReq(){
-    setLength(2);
+    setLength(MqttsWillMsgReqLayout::Length);
     setType(MQTTS_TYPE_WILLMSGREQ);
     allocateBody();
 
@@ -600,7 +655,7 @@ MqttsWillMsgReq::~MqttsWillMsgReq(){
          Class MqttsWillMsg
   ======================================*/
 MqttsWillMsg::MqttsWillMsg(){
-    setLength(2);
+    setLength(MqttsWillMsgLayout::Length);
     setType(MQTTS_TYPE_WILLMSG);
     allocateBody();
 }
@@ -610,9 +665,9 @@ MqttsWillMsg::~MqttsWillMsg(){
 }
 
 void MqttsWillMsg::setWillMsg(MQString* msg){
-    setLength(2 + msg->getDataLength());
+    setLength(MqttsWillMsgLayout::Length + msg->getDataLength());
     allocateBody();
-    msg->writeBuf(getBody());
+    msg->writeBuf(getBody() + MqttsWillMsgLayout::Tail);
 }
 
 char* MqttsWillMsg::getWillMsg(){
@@ -627,7 +682,7 @@ char* MqttsWillMsg::getWillMsg(){
          Class MqttsRegister
   ======================================*/
 MqttsRegister::MqttsRegister(){
-    setLength(6);
+    setLength(MqttsRegisterLayout::Length);
     setType(MQTTS_TYPE_REGISTER);
     allocateBody();
     _topicId = 0;
@@ -640,7 +695,7 @@ MqttsRegister::~MqttsRegister(){
 
 void MqttsRegister::setTopicId(uint16_t topicId){
   if (_msgBuff){
-            setUint16(getBody(), topicId);
+            MqttsRegisterLayout::TopicId::set(getBody(), topicId);
     }
     _topicId = topicId;
 }
@@ -649,7 +704,7 @@ uint16_t MqttsRegister::getTopicId(){
 }
 void MqttsRegister::setMsgId(uint16_t msgId){
     if (_msgBuff){
-            setUint16(getBody() + 2, msgId);
+            MqttsRegisterLayout::MsgId::set(getBody(), msgId);
     }
     _msgId = msgId;
 }
@@ -658,9 +713,9 @@ uint16_t MqttsRegister::getMsgId(){
 
 }
 void MqttsRegister::setTopicName(MQString* topicName){
-    setLength(6 + topicName->getDataLength());
+    setLength(MqttsRegisterLayout::Length + topicName->getDataLength());
     allocateBody();
-    topicName->writeBuf(getBody() + 4);
+    topicName->writeBuf(getBody() + MqttsRegisterLayout::Tail);
     setTopicId(_topicId);
     setMsgId(_msgId);
 }
@@ -669,9 +724,9 @@ void MqttsRegister::setFrame(uint8_t* data, uint8_t len){
     setLength(len + MQTTS_HEADER_SIZE);
     allocateBody();
     memcpy(getBody(), data, len);
-    _topicId = getUint16(data);
-    _msgId = getUint16(data + 2);
-    _ustring.readBuf(getBody() + 4);
+    _topicId = MqttsRegisterLayout::TopicId::get(data);
+    _msgId = MqttsRegisterLayout::MsgId::get(data);
+    _ustring.readBuf(getBody() + MqttsRegisterLayout::Tail);
 }
 
 void MqttsRegister::setFrame(ZBResponse* resp){
@@ -686,7 +741,7 @@ MQString* MqttsRegister::getTopicName(){
          Class MqttsRegAck
   ======================================*/
 MqttsRegAck::MqttsRegAck(){
-    setLength(7);
+    setLength(MqttsRegAckLayout::Length);
     setType(MQTTS_TYPE_REGACK);
     allocateBody();
 }
@@ -694,29 +749,29 @@ MqttsRegAck::~MqttsRegAck(){
 
 }
 void MqttsRegAck::setTopicId(uint16_t topicId){
-    setUint16((uint8_t*)getBody(), topicId);
+    MqttsRegAckLayout::TopicId::set(getBody(), topicId);
 }
 uint16_t MqttsRegAck::getTopicId(){
-    return getUint16((unsigned char*)getBody());
+    return MqttsRegAckLayout::TopicId::get(getBody());
 }
 void MqttsRegAck::setMsgId(uint16_t msgId){
-    setUint16(getBody()+ 2,msgId);
+    MqttsRegAckLayout::MsgId::set(getBody(), msgId);
 }
 uint16_t MqttsRegAck::getMsgId(){
-    return getUint16((unsigned char*)getBody()+ 2);
+    return MqttsRegAckLayout::MsgId::get(getBody());
 }
 void MqttsRegAck::setReturnCode(uint8_t rc){
-    getBody()[4] = rc;
+    MqttsRegAckLayout::ReturnCode::set(getBody(), rc);
 }
 uint8_t MqttsRegAck::getReturnCode(){
-    return (uint8_t)getBody()[4];
+    return MqttsRegAckLayout::ReturnCode::get(getBody());
 }
 
 /*=====================================
          Class MqttsPublish
   ======================================*/
 MqttsPublish::MqttsPublish(){
-    setLength(7);
+    setLength(MqttsPublishLayout::Length);
     setType(MQTTS_TYPE_PUBLISH);
     allocateBody();
     _topicId = 0;
@@ -724,18 +779,28 @@ MqttsPublish::MqttsPublish(){
     _flags = 0;
 }
 
+/*
+ *  Read-only view of a received PUBLISH, no allocation.
+ */
+MqttsPublish::MqttsPublish(ZBResponse* resp){
+    setMsgView(resp->getPayload());
+    _flags = MqttsPublishLayout::Flags::get(getBody());
+    _topicId = MqttsPublishLayout::TopicId::get(getBody());
+    _msgId = MqttsPublishLayout::MsgId::get(getBody());
+}
+
 MqttsPublish::~MqttsPublish(){
 
 }
 
 void MqttsPublish::setFlags(uint8_t flags){
-    _flags = flags & 0xf3;
-    getBody()[0] = _flags ;
+    _flags = flags & MqttsPublishLayout::FlagsMask;
+    MqttsPublishLayout::Flags::set(getBody(), _flags);
 }
 
 void MqttsPublish::setDup(){
 	_flags |= 0x80;
-	getBody()[0] = _flags ;
+	MqttsPublishLayout::Flags::set(getBody(), _flags);
 }
 
 uint8_t MqttsPublish::getFlags(){
@@ -743,7 +808,7 @@ uint8_t MqttsPublish::getFlags(){
 }
 
 uint8_t MqttsPublish::getTopicType(){
-    return _flags & MQTTS_TOPIC_TYPE;
+    return MqttsPublishLayout::TopicType::get(&_flags);
 }
 
 bool MqttsPublish::isRetain(){
@@ -751,11 +816,11 @@ bool MqttsPublish::isRetain(){
 }
 
 uint8_t MqttsPublish::getQos(){
-    return _flags & (MQTTS_FLAG_QOS_1 | MQTTS_FLAG_QOS_2);
+    return MqttsPublishLayout::Qos::get(&_flags);
 }
 
 void MqttsPublish::setTopicId(uint16_t id){
-    setUint16((uint8_t*)(getBody() + 1), id);
+    MqttsPublishLayout::TopicId::set(getBody(), id);
     _topicId = id;
 }
 
@@ -763,7 +828,7 @@ uint16_t MqttsPublish::getTopicId(){
     return _topicId;
 }
 void MqttsPublish::setMsgId(uint16_t msgId){
-    setUint16((uint8_t*)(getBody() + 3), msgId);
+    MqttsPublishLayout::MsgId::set(getBody(), msgId);
     _msgId = msgId;
 }
 
@@ -773,34 +838,34 @@ uint16_t MqttsPublish::getMsgId(){
 
 
 void MqttsPublish::setData(uint8_t* data, uint8_t len){
-    setLength(7 + len);
+    setLength(MqttsPublishLayout::Length + len);
     allocateBody();
-    memcpy(getBody() + 5, data, len);
+    memcpy(getBody() + MqttsPublishLayout::Tail, data, len);
     setTopicId(_topicId);
     setMsgId(_msgId);
     setFlags(_flags);
 }
 
 void MqttsPublish::setData(MQString* str){
-	setLength(9 + str->getCharLength());
+	setLength(MqttsPublishLayout::Length + str->getDataLength());
 	allocateBody();
 	setTopicId(_topicId);
 	setMsgId(_msgId);
 	setFlags(_flags);
-	str->writeBuf(getBody() + 5);
+	str->writeBuf(getBody() + MqttsPublishLayout::Tail);
 }
 
 uint8_t*  MqttsPublish::getData(){
-    return (uint8_t*)(getBody() + 5);
+    return (uint8_t*)(getBody() + MqttsPublishLayout::Tail);
 }
 
 void MqttsPublish::setFrame(uint8_t* data, uint8_t len){
     setLength(len + MQTTS_HEADER_SIZE);
     allocateBody();
     memcpy(getBody(), data, len);
-    _topicId = getUint16(data + 1);
-    _msgId = getUint16(data + 3);
-    _flags = *data;
+    _topicId = MqttsPublishLayout::TopicId::get(data);
+    _msgId = MqttsPublishLayout::MsgId::get(data);
+    _flags = MqttsPublishLayout::Flags::get(data);
 }
 
 
@@ -812,7 +877,7 @@ void MqttsPublish::setFrame(ZBResponse* resp){
          Class MqttsPubAck
  ======================================*/
 MqttsPubAck::MqttsPubAck(){
-    setLength(7);
+    setLength(MqttsPubAckLayout::Length);
     setType(MQTTS_TYPE_PUBACK);
     allocateBody();
 }
@@ -820,29 +885,29 @@ MqttsPubAck::~MqttsPubAck(){
 
 }
 void MqttsPubAck::setTopicId(uint16_t topicId){
-    setUint16((uint8_t*)getBody(), topicId);
+    MqttsPubAckLayout::TopicId::set(getBody(), topicId);
 }
 uint16_t MqttsPubAck::getTopicId(){
-    return getUint16((unsigned char*)getBody());
+    return MqttsPubAckLayout::TopicId::get(getBody());
 }
 void MqttsPubAck::setMsgId(uint16_t msgId){
-    setUint16(getBody()+ 2,msgId);
+    MqttsPubAckLayout::MsgId::set(getBody(), msgId);
 }
 uint16_t MqttsPubAck::getMsgId(){
-    return getUint16((unsigned char*)getBody()+ 2);
+    return MqttsPubAckLayout::MsgId::get(getBody());
 }
 void MqttsPubAck::setReturnCode(uint8_t rc){
-    getBody()[4] = rc;
+    MqttsPubAckLayout::ReturnCode::set(getBody(), rc);
 }
 uint8_t MqttsPubAck::getReturnCode(){
-    return (uint8_t)getBody()[4];
+    return MqttsPubAckLayout::ReturnCode::get(getBody());
 }
 
  /*=====================================
          Class MqttsSubscribe
   ======================================*/
 MqttsSubscribe::MqttsSubscribe(){
-    setLength(5);
+    setLength(MqttsSubscribeLayout::Length + 2);
     setType(MQTTS_TYPE_SUBSCRIBE);
     allocateBody();
     _topicId = 0;
@@ -855,15 +920,15 @@ MqttsSubscribe::~MqttsSubscribe(){
 }
 
 void MqttsSubscribe::setFlags(uint8_t flags){
-    _flags = flags & 0xe3;
+    _flags = flags & MqttsSubscribeLayout::FlagsMask;
     if (_msgBuff){
-              getBody()[0] = _flags;
+              MqttsSubscribeLayout::Flags::set(getBody(), _flags);
       }
 }
 
 void MqttsSubscribe::setDup(){
     _flags |= 0x80;
-    getBody()[0] = _flags;
+    MqttsSubscribeLayout::Flags::set(getBody(), _flags);
 }
 
 uint8_t MqttsSubscribe::getFlags(){
@@ -875,40 +940,40 @@ uint8_t MqttsSubscribe::getQos(){
 }
 
 void MqttsSubscribe::setTopicId(uint16_t predefinedId){
-    setLength(7);
+    setLength(MQTTS_LEN_SUBSCRIBE_ID);
     allocateBody();
     setMsgId(_msgId);
-    setUint16((uint8_t*)(getBody() + 3), predefinedId);
+    MqttsSubscribeLayout::TopicId::set(getBody(), predefinedId);
     setFlags(_flags | MQTTS_TOPIC_TYPE_PREDEFINED);
     _topicId = predefinedId;
 }
 
 uint16_t MqttsSubscribe::getTopicId(){
     if (_msgBuff){
-        _topicId = getUint16(getBody() +3);
+        _topicId = MqttsSubscribeLayout::TopicId::get(getBody());
     }
     return _topicId;
 }
 void MqttsSubscribe::setMsgId(uint16_t msgId){
     _msgId = msgId;
     if (_msgBuff){
-       setUint16((uint8_t*)(getBody() + 1), msgId);
+       MqttsSubscribeLayout::MsgId::set(getBody(), msgId);
     }
 }
 
 uint16_t MqttsSubscribe::getMsgId(){
     if (_msgBuff){
-        _msgId = getUint16(getBody() + 1);
+        _msgId = MqttsSubscribeLayout::MsgId::get(getBody());
     }
     return _msgId;
 }
 
 void MqttsSubscribe::setTopicName(MQString* data){
-    setLength(5 + data->getDataLength());
+    setLength(MqttsSubscribeLayout::Length + data->getDataLength());
     allocateBody();
-    data->writeBuf(getBody() + 3);
+    data->writeBuf(getBody() + MqttsSubscribeLayout::Tail);
     setMsgId(_msgId);
-    setFlags((_flags & 0xe0) | MQTTS_TOPIC_TYPE_SHORT);
+    setFlags((_flags & 0xe0) | MQTTS_TOPIC_TYPE_NORMAL);
     _ustring.copy(data);
 }
 
@@ -921,13 +986,13 @@ void MqttsSubscribe::setFrame(uint8_t* data, uint8_t len){
     setLength(len + MQTTS_HEADER_SIZE);
     allocateBody();
     memcpy(getBody(), data, len);
-    _msgId = getUint16(data + 1);
-    _flags = *data;
-    if ((_flags & MQTTS_TOPIC_TYPE) == MQTTS_TOPIC_TYPE_NORMAL){
+    _msgId = MqttsSubscribeLayout::MsgId::get(data);
+    _flags = MqttsSubscribeLayout::Flags::get(data);
+    if (MqttsSubscribeLayout::TopicType::get(data) == MQTTS_TOPIC_TYPE_NORMAL){
         _topicId = 0;
-        _ustring.readBuf(data + 3);
+        _ustring.readBuf(data + MqttsSubscribeLayout::Tail);
     }else{
-        _topicId = getUint16(data + 3);
+        _topicId = MqttsSubscribeLayout::TopicId::get(data);
     }
 
 }
@@ -940,7 +1005,7 @@ void MqttsSubscribe::setFrame(ZBResponse* resp){
          Class MqttsSubAck
   ======================================*/
 MqttsSubAck::MqttsSubAck(){
-    setLength(8);
+    setLength(MqttsSubAckLayout::Length);
     setType(MQTTS_TYPE_SUBACK);
     allocateBody();
 }
@@ -950,36 +1015,36 @@ MqttsSubAck::~MqttsSubAck(){
 }
 
 void MqttsSubAck::setFlags(uint8_t flags){
-    getBody()[0] = flags & 0x60;
+    MqttsSubAckLayout::Flags::set(getBody(), flags & MqttsSubAckLayout::FlagsMask);
 }
 
 uint8_t MqttsSubAck::getFlags(){
-    return getBody()[0];
+    return MqttsSubAckLayout::Flags::get(getBody());
 }
 
 uint8_t MqttsSubAck::getQos(){
-    return getBody()[0] & (MQTTS_FLAG_QOS_1 | MQTTS_FLAG_QOS_2);
+    return MqttsSubAckLayout::Qos::get(getBody());
 }
 
 void MqttsSubAck::setTopicId(uint16_t id){
-    setUint16((uint8_t*)(getBody() + 1), id);
+    MqttsSubAckLayout::TopicId::set(getBody(), id);
 }
 
 uint16_t MqttsSubAck::getTopicId(){
-    return getUint16(getBody() + 1);
+    return MqttsSubAckLayout::TopicId::get(getBody());
 }
 void MqttsSubAck::setMsgId(uint16_t msgId){
-   setUint16((uint8_t*)(getBody() + 3), msgId);
+   MqttsSubAckLayout::MsgId::set(getBody(), msgId);
 }
 
 uint16_t MqttsSubAck::getMsgId(){
-    return getUint16(getBody() + 3);
+    return MqttsSubAckLayout::MsgId::get(getBody());
 }
 void MqttsSubAck::setReturnCode(uint8_t rc){
-    getBody()[6] = rc;
+    MqttsSubAckLayout::ReturnCode::set(getBody(), rc);
 }
 uint8_t  MqttsSubAck::getReturnCode(){
-    return getBody()[5];
+    return MqttsSubAckLayout::ReturnCode::get(getBody());
 }
 
 
@@ -994,16 +1059,16 @@ MqttsUnsubscribe::~MqttsUnsubscribe(){
 }
 void MqttsUnsubscribe::setFlags(uint8_t flags){
   if (_msgBuff){
-              getBody()[0] = flags & 0x03;
+              MqttsUnsubscribeLayout::Flags::set(getBody(), flags & MqttsUnsubscribeLayout::FlagsMask);
     }
 }
 
 void MqttsUnsubscribe::setTopicName(MQString* data){
-    setLength(5 + data->getDataLength());
+    setLength(MqttsUnsubscribeLayout::Length + data->getDataLength());
     allocateBody();
-    data->writeBuf(getBody() + 3);
+    data->writeBuf(getBody() + MqttsUnsubscribeLayout::Tail);
     setMsgId(_msgId);
-    setFlags((_flags & 0xe0) | MQTTS_TOPIC_TYPE_SHORT);
+    setFlags((_flags & 0xe0) | MQTTS_TOPIC_TYPE_NORMAL);
     _ustring.copy(data);
 }
 
@@ -1011,7 +1076,7 @@ void MqttsUnsubscribe::setTopicName(MQString* data){
          Class MqttsUnSubAck
   ======================================*/
 MqttsUnSubAck::MqttsUnSubAck(){
-    setLength(4);
+    setLength(MqttsUnSubAckLayout::Length);
     setType(MQTTS_TYPE_UNSUBACK);
     allocateBody();
 }
@@ -1021,21 +1086,21 @@ MqttsUnSubAck::~MqttsUnSubAck(){
 }
 
 void MqttsUnSubAck::setMsgId(uint16_t msgId){
-    setUint16((uint8_t*)getBody(), msgId);
+    MqttsUnSubAckLayout::MsgId::set(getBody(), msgId);
 }
 
 uint16_t MqttsUnSubAck::getMsgId(){
-    return getUint16(getBody());
+    return MqttsUnSubAckLayout::MsgId::get(getBody());
 }
 
 /*=====================================
         Class MqttsPingReq
  ======================================*/
 MqttsPingReq::MqttsPingReq(MQString* id){
-  setLength(id->getDataLength() + 2);
+  setLength(MqttsPingReqLayout::Length + id->getDataLength());
   setType(MQTTS_TYPE_PINGREQ);
   allocateBody();
-  id->writeBuf(getBody());
+  id->writeBuf(getBody() + MqttsPingReqLayout::Tail);
 
 }
 MqttsPingReq::~MqttsPingReq(){
@@ -1050,7 +1115,7 @@ char* MqttsPingReq::getClientId(){
         Class MqttsPingResp
  ======================================*/
 MqttsPingResp::MqttsPingResp(){
-    setLength(2);
+    setLength(MqttsPingRespLayout::Length);
     setType(MQTTS_TYPE_PINGRESP);
     allocateBody();
 }
@@ -1062,7 +1127,7 @@ MqttsPingResp::~MqttsPingResp(){
          Class MqttsDisconnect
   ======================================*/
 MqttsDisconnect::MqttsDisconnect(){
-    setLength(4);
+    setLength(MQTTS_LEN_DISCONNECT);
     setType(MQTTS_TYPE_DISCONNECT);
     allocateBody();
 
@@ -1071,10 +1136,233 @@ MqttsDisconnect::~MqttsDisconnect(){
 
 }
 void MqttsDisconnect::setDuration(uint16_t duration){
-    setUint16((uint8_t*)getBody(), duration);
+    MqttsDisconnectLayout::Duration::set(getBody(), duration);
 }
 uint16_t MqttsDisconnect::getDuration(){
-    return getUint16((uint8_t*)getBody());
+    return MqttsDisconnectLayout::Duration::get(getBody());
+}
+
+
+/*=====================================
+        Class MqttsFrameView
+ ======================================*/
+MQTTS_STATIC_ASSERT(sizeof(MqttsPubAckView) == sizeof(uint8_t*), mqtts_view_is_a_pointer);
+
+MqttsFrameView::MqttsFrameView(){
+    _frame = NULL;
+}
+
+/*
+ *  Any message. Length is the one of the message, which the received
+ *  bytes must hold.
+ */
+bool MqttsFrameView::set(ZBResponse* resp){
+    uint8_t* frame = resp->getPayload();
+    _frame = NULL;
+    if (resp->getPayloadLength() < MQTTS_HEADER_SIZE || frame[0] < MQTTS_HEADER_SIZE ||
+        frame[0] > resp->getPayloadLength()){
+        return false;
+    }
+    _frame = frame;
+    return true;
+}
+
+bool MqttsFrameView::set(ZBResponse* resp, uint8_t type, uint8_t minLength){
+    if (!set(resp) || _frame[1] != type || _frame[0] < minLength){
+        _frame = NULL;
+        return false;
+    }
+    return true;
+}
+
+/*------ REGISTER ------*/
+bool MqttsRegisterView::set(ZBResponse* resp){
+    if (!MqttsFrameView::set(resp, MqttsRegisterLayout::Type, MQTTS_LEN_REGISTER)){   // TopicName length included
+        return false;
+    }
+    if (getUint16(getBody() + MqttsRegisterLayout::Tail) > getLength() - MQTTS_LEN_REGISTER){   // TopicName runs over
+        _frame = NULL;
+        return false;
+    }
+    return true;
+}
+
+void MqttsRegisterView::getTopicName(MQString* topicName){
+    topicName->readBuf(getBody() + MqttsRegisterLayout::Tail);
+}
+
+
+/*=====================================
+        Class MqttsEncoder
+ ======================================*/
+MQTTS_STATIC_ASSERT(MQTTS_LEN_PUBACK <= MQTTS_MAX_PACKET_LENGTH, mqtts_fixed_length_fits);
+
+MqttsEncoder::MqttsEncoder(uint8_t* buf, uint8_t size){
+    _buf = buf;
+    _size = size;
+    _length = 0;
+}
+
+/*
+ *  Returns the body, or NULL if the message doesn't fit.
+ */
+uint8_t* MqttsEncoder::setHeader(uint8_t type, uint16_t length){
+    if (length > _size || length > 0xff){
+        _length = 0;
+        return NULL;
+    }
+    _buf[0] = _length = length;
+    _buf[1] = type;
+    return _buf + MQTTS_HEADER_SIZE;
+}
+
+uint8_t MqttsEncoder::searchGw(uint8_t radius){
+    uint8_t* body = setHeader(MqttsSearchGwLayout::Type, MQTTS_LEN_SEARCHGW);
+    if (body){
+        MqttsSearchGwLayout::Radius::set(body, radius);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::connect(uint8_t flags, uint16_t duration, MQString* clientId){
+    uint8_t* body = setHeader(MqttsConnectLayout::Type, MqttsConnectLayout::Length + clientId->getDataLength());
+    if (body){
+        MqttsConnectLayout::Flags::set(body, flags & MqttsConnectLayout::FlagsMask);
+        MqttsConnectLayout::ProtocolId::set(body, MQTTS_PROTOCOL_ID);
+        MqttsConnectLayout::Duration::set(body, duration);
+        clientId->writeBuf(body + MqttsConnectLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::willTopic(uint8_t flags, MQString* topic){
+    uint8_t* body = setHeader(MqttsWillTopicLayout::Type, MqttsWillTopicLayout::Length + topic->getDataLength());
+    if (body){
+        MqttsWillTopicLayout::Flags::set(body, flags & MqttsWillTopicLayout::FlagsMask);
+        topic->writeBuf(body + MqttsWillTopicLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::willMsg(MQString* msg){
+    uint8_t* body = setHeader(MqttsWillMsgLayout::Type, MqttsWillMsgLayout::Length + msg->getDataLength());
+    if (body){
+        msg->writeBuf(body + MqttsWillMsgLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::registerTopic(uint16_t topicId, uint16_t msgId, MQString* topicName){
+    uint8_t* body = setHeader(MqttsRegisterLayout::Type, MqttsRegisterLayout::Length + topicName->getDataLength());
+    if (body){
+        MqttsRegisterLayout::TopicId::set(body, topicId);
+        MqttsRegisterLayout::MsgId::set(body, msgId);
+        topicName->writeBuf(body + MqttsRegisterLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::regAck(uint16_t topicId, uint16_t msgId, uint8_t rc){
+    uint8_t* body = setHeader(MqttsRegAckLayout::Type, MQTTS_LEN_REGACK);
+    if (body){
+        MqttsRegAckLayout::TopicId::set(body, topicId);
+        MqttsRegAckLayout::MsgId::set(body, msgId);
+        MqttsRegAckLayout::ReturnCode::set(body, rc);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::publish(uint8_t flags, uint16_t topicId, uint16_t msgId, const uint8_t* data, uint8_t len){
+    uint8_t* body = setHeader(MqttsPublishLayout::Type, MqttsPublishLayout::Length + len);
+    if (body){
+        MqttsPublishLayout::Flags::set(body, flags & MqttsPublishLayout::FlagsMask);
+        MqttsPublishLayout::TopicId::set(body, topicId);
+        MqttsPublishLayout::MsgId::set(body, msgId);
+        memcpy(body + MqttsPublishLayout::Tail, data, len);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::publish(uint8_t flags, uint16_t topicId, uint16_t msgId, MQString* data){
+    uint8_t* body = setHeader(MqttsPublishLayout::Type, MqttsPublishLayout::Length + data->getDataLength());
+    if (body){
+        MqttsPublishLayout::Flags::set(body, flags & MqttsPublishLayout::FlagsMask);
+        MqttsPublishLayout::TopicId::set(body, topicId);
+        MqttsPublishLayout::MsgId::set(body, msgId);
+        data->writeBuf(body + MqttsPublishLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::pubAck(uint16_t topicId, uint16_t msgId, uint8_t rc){
+    uint8_t* body = setHeader(MqttsPubAckLayout::Type, MQTTS_LEN_PUBACK);
+    if (body){
+        MqttsPubAckLayout::TopicId::set(body, topicId);
+        MqttsPubAckLayout::MsgId::set(body, msgId);
+        MqttsPubAckLayout::ReturnCode::set(body, rc);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::subscribe(uint8_t flags, uint16_t msgId, MQString* topicName){
+    uint8_t* body = setHeader(MqttsSubscribeLayout::Type, MqttsSubscribeLayout::Length + topicName->getDataLength());
+    if (body){
+        MqttsSubscribeLayout::Flags::set(body, flags & MqttsSubscribeLayout::FlagsMask);
+        MqttsSubscribeLayout::MsgId::set(body, msgId);
+        topicName->writeBuf(body + MqttsSubscribeLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::subscribe(uint8_t flags, uint16_t msgId, uint16_t topicId){
+    uint8_t* body = setHeader(MqttsSubscribeLayout::Type, MQTTS_LEN_SUBSCRIBE_ID);
+    if (body){
+        MqttsSubscribeLayout::Flags::set(body, flags & MqttsSubscribeLayout::FlagsMask);
+        MqttsSubscribeLayout::MsgId::set(body, msgId);
+        MqttsSubscribeLayout::TopicId::set(body, topicId);
+    }
+    return _length;
+}
+
+/*
+ *  UNSUBSCRIBE shares the layout of SUBSCRIBE.
+ */
+uint8_t MqttsEncoder::unsubscribe(uint8_t flags, uint16_t msgId, MQString* topicName){
+    if (subscribe(flags & MqttsUnsubscribeLayout::FlagsMask, msgId, topicName)){
+        _buf[1] = MqttsUnsubscribeLayout::Type;
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::unsubscribe(uint8_t flags, uint16_t msgId, uint16_t topicId){
+    if (subscribe(flags & MqttsUnsubscribeLayout::FlagsMask, msgId, topicId)){
+        _buf[1] = MqttsUnsubscribeLayout::Type;
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::pingReq(MQString* clientId){
+    uint8_t* body = setHeader(MqttsPingReqLayout::Type, MqttsPingReqLayout::Length + clientId->getDataLength());
+    if (body){
+        clientId->writeBuf(body + MqttsPingReqLayout::Tail);
+    }
+    return _length;
+}
+
+uint8_t MqttsEncoder::disconnect(uint16_t duration){
+    uint8_t* body = setHeader(MqttsDisconnectLayout::Type, MQTTS_LEN_DISCONNECT);
+    if (body){
+        MqttsDisconnectLayout::Duration::set(body, duration);
+    }
+    return _length;
+}
+
+uint8_t* MqttsEncoder::getBuff(){
+    return _buf;
+}
+
+uint8_t MqttsEncoder::getLength(){
+    return _length;
 }
 
 
@@ -1085,6 +1373,7 @@ Topic::Topic(){
     _topicStr = NULL;
     _callback = NULL;
     _topicId = 0;
+    _topicType = MQTTS_TOPIC_TYPE_NORMAL;
     _status = 0;
 }
 
@@ -1102,6 +1391,10 @@ uint16_t Topic::getTopicId(){
     return _topicId;
 }
 
+uint8_t Topic::getTopicType(){
+    return _topicType;
+}
+
 MQString* Topic::getTopicName(){
     return _topicStr;
 }
@@ -1118,6 +1411,10 @@ void Topic::setTopicId(uint16_t id){
     _topicId = id;
 }
 
+void Topic::setTopicType(uint8_t type){
+    _topicType = type & MQTTS_TOPIC_TYPE;
+}
+
 void Topic::setStatus(uint8_t stat){
     _topicId = stat;
 }
@@ -1140,6 +1437,7 @@ int Topic::execCallback(MqttsPublish* msg){
 
 void Topic::copy(Topic* src){
     setTopicId(src->getTopicId());
+    setTopicType(src->getTopicType());
     setStatus(src->getStatus());
     setCallback(src->getCallback());
     setCallback(_callback);
@@ -1147,7 +1445,9 @@ void Topic::copy(Topic* src){
 }
 
 uint8_t Topic::isWildCard(){
-    if (getTopicName()->getChar(getTopicName()->getCharLength() - 1) == MQTTS_TOPIC_SINGLE_WILDCARD){
+    if (getTopicName() == NULL){
+        return 0;
+    }else if (getTopicName()->getChar(getTopicName()->getCharLength() - 1) == MQTTS_TOPIC_SINGLE_WILDCARD){
         return MQTTS_TOPIC_SINGLE_WILDCARD;
     }else if (getTopicName()->getChar(getTopicName()->getCharLength() - 1) == MQTTS_TOPIC_MULTI_WILDCARD){
         return MQTTS_TOPIC_MULTI_WILDCARD;
@@ -1209,16 +1509,19 @@ uint16_t Topics::getTopicId(MQString* topic){
 
 Topic* Topics::getTopic(MQString* topic) {
     for (int i = 0; i < _elmCnt; i++) {
-        if ( topic->comp(_topics[i].getTopicName()) == 0) {
+        if (_topics[i].getTopicName() && topic->comp(_topics[i].getTopicName()) == 0) {
             return &_topics[i];
         }
     }
     return NULL;
 }
 
-Topic* Topics::getTopic(uint16_t id) {
+/*
+ *  The same TopicId may be NORMAL, PREDEFINED and SHORT, they are told apart by the type.
+ */
+Topic* Topics::getTopic(uint16_t id, uint8_t topicType) {
     for (int i = 0; i < _elmCnt; i++) {
-        if ( _topics[i].getTopicId() == id) {
+        if ( _topics[i].getTopicId() == id && _topics[i].getTopicType() == topicType) {
             return &_topics[i];
         }
     }
@@ -1244,8 +1547,8 @@ bool Topics::setCallback(MQString* topic, TopicCallback callback){
         return false;
     }
 }
-bool Topics::setCallback(uint16_t topicId, TopicCallback callback){
-    Topic* p = getTopic(topicId);
+bool Topics::setCallback(uint16_t topicId, uint8_t topicType, TopicCallback callback){
+    Topic* p = getTopic(topicId, topicType);
     if ( p != NULL) {
         p->setCallback(callback);
         return true;
@@ -1253,8 +1556,8 @@ bool Topics::setCallback(uint16_t topicId, TopicCallback callback){
         return false;
     }
 }
-int Topics::execCallback(uint16_t topicId, MqttsPublish* msg){
-    Topic* p = getTopic(topicId);
+int Topics::execCallback(MqttsPublish* msg){
+    Topic* p = getTopic(msg->getTopicId(), msg->getTopicType());
     if ( p != NULL) {
         return p->execCallback(msg);
     }
@@ -1263,38 +1566,65 @@ int Topics::execCallback(uint16_t topicId, MqttsPublish* msg){
 
 void Topics::addTopic(MQString* topic){
     if (getTopic(topic) == NULL){
-        if ( _elmCnt < _sizeMax){
-            _topics[_elmCnt].setTopicName(topic);
-            _elmCnt++;
-        }else{
-            Topic* saveTopics = _topics;
-            Topic* newTopics = (Topic*)calloc(_sizeMax += MQTTS_MAX_TOPICS, sizeof(Topic));
-            if (newTopics != NULL){
-                _topics = newTopics;
-                for(int i = 0; i < _elmCnt; i++){
-                    _topics[i].copy(&saveTopics[i]);
-                    saveTopics[i].setTopicName((MQString*)NULL);
-                }
-
-                _topics[_elmCnt].setTopicName(topic);
-                _elmCnt++;
-                if (saveTopics){
-                    delete saveTopics;
-                }
-            }
+        Topic* p = newTopic();
+        if (p != NULL){
+            p->setTopicName(topic);
+        }
+    }
+}
+
+/*
+ *  PREDEFINED or SHORT TopicId, which has no name.
+ */
+void Topics::addTopic(uint16_t topicId, uint8_t topicType){
+    if (getTopic(topicId, topicType) == NULL){
+        Topic* p = newTopic();
+        if (p != NULL){
+            p->setTopicId(topicId);
+            p->setTopicType(topicType);
         }
     }
 }
 
+Topic* Topics::newTopic(){
+    if ( _elmCnt < _sizeMax){
+        return &_topics[_elmCnt++];
+    }
+    Topic* saveTopics = _topics;
+    Topic* newTopics = (Topic*)calloc(_sizeMax + MQTTS_MAX_TOPICS, sizeof(Topic));
+    if (newTopics == NULL){
+        return NULL;
+    }
+    _sizeMax += MQTTS_MAX_TOPICS;
+    _topics = newTopics;
+    for(int i = 0; i < _elmCnt; i++){
+        _topics[i].copy(&saveTopics[i]);
+        saveTopics[i].setTopicName((MQString*)NULL);
+    }
+    if (saveTopics){
+        free(saveTopics);
+    }
+    return &_topics[_elmCnt++];
+}
+
 Topic* Topics::match(MQString* topic){
+    Topic* tp = getTopic(topic);
+    Topic  tmp;
+    Topic* wc = NULL;
+    if (tp == NULL){
+        tmp.setTopicName(topic);   // topic registered by the Gateway is not in the list yet
+        tp = &tmp;
+    }
     for ( int i = 0; i< _elmCnt; i++){
         if (_topics[i].isWildCard()){
-            if (getTopic(topic)->isMatch(&_topics[i])){
-               return &_topics[i];
+            if (tp->isMatch(&_topics[i])){
+               wc = &_topics[i];
+               break;
             }
         }
     }
-    return NULL;
+    tmp.setTopicName(NULL);        // not owned
+    return wc;
 }
 
 void Topics::setSize(uint8_t size){
@@ -1312,10 +1642,7 @@ PublishHandller::~PublishHandller(){
 
 }
 int PublishHandller::exec(MqttsPublish* msg, Topics* topics){
-    if (topics->getTopic(msg->getTopicId())){
-        return topics->getTopic(msg->getTopicId())->execCallback(msg);
-    }
-    return 0;
+    return topics->execCallback(msg);
 }
 
 
@@ -105,11 +105,14 @@
 #define MQTTS_TOPIC_TYPE_SHORT      0x02
 #define MQTTS_TOPIC_TYPE            0x03
 
+#define MQTTS_SHORT_TOPIC_ID(c0, c1)  ((uint16_t)(((uint8_t)(c0) << 8) | (uint8_t)(c1)))   // TopicId of a short TopicName
+
 #define MQTTS_FLAG_DUP     0x80
 #define MQTTS_FLAG_QOS_0   0x0
 #define MQTTS_FLAG_QOS_1   0x20
 #define MQTTS_FLAG_QOS_2   0x40
-#define MQTTS_FLAG_QOS_N1  0xc0
+#define MQTTS_FLAG_QOS_N1  0x60
+#define MQTTS_FLAG_QOS_MASK 0x60
 #define MQTTS_FLAG_RETAIN  0x10
 #define MQTTS_FLAG_WILL    0x08
 #define MQTTS_FLAG_CLEAN   0x04
@@ -117,6 +120,157 @@
 #define MQTTS_PROTOCOL_ID  0x01
 #define MQTTS_HEADER_SIZE  2
 
+#define MQTTS_STATIC_ASSERT(cond, name)  typedef char name[(cond) ? 1 : -1]
+
+/*=====================================
+        Layout of the messages
+ ======================================*/
+/*
+ *  A field is at a constant offset of the body, which follows Length and
+ *  MsgType, and its accessors are inline, so they compile to a load or a
+ *  store. A layout lists the fields of a message type. Tail is the offset
+ *  of the variable part (a string or the data), and Length is the length
+ *  of the message without it.
+ */
+template<uint8_t Offset>
+struct MqttsByteField {
+    static uint8_t get(const uint8_t* body){ return body[Offset]; }
+    static void set(uint8_t* body, uint8_t val){ body[Offset] = val; }
+};
+
+template<uint8_t Offset>
+struct MqttsWordField {     // big endian
+    static uint16_t get(const uint8_t* body){ return (uint16_t)((body[Offset] << 8) | body[Offset + 1]); }
+    static void set(uint8_t* body, uint16_t val){ body[Offset] = val >> 8; body[Offset + 1] = val & 0xff; }
+};
+
+template<uint8_t Offset, uint8_t Mask>
+struct MqttsBitField {      // bits of Flags
+    static uint8_t get(const uint8_t* body){ return body[Offset] & Mask; }
+    static void set(uint8_t* body, uint8_t val){ body[Offset] = (body[Offset] & ~Mask) | (val & Mask); }
+};
+
+#define MQTTS_LAYOUT(type, tail)  enum { Type = type, Tail = tail, Length = MQTTS_HEADER_SIZE + tail }
+
+struct MqttsAdvertiseLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_ADVERTISE, 3);
+    typedef MqttsByteField<0> GwId;
+    typedef MqttsWordField<1> Duration;
+};
+struct MqttsSearchGwLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_SEARCHGW, 1);
+    typedef MqttsByteField<0> Radius;
+};
+struct MqttsGwInfoLayout {              // GwAdd follows, if sent by a Client
+    MQTTS_LAYOUT(MQTTS_TYPE_GWINFO, 1);
+    typedef MqttsByteField<0> GwId;
+};
+struct MqttsConnectLayout {             // ClientId follows
+    MQTTS_LAYOUT(MQTTS_TYPE_CONNECT, 4);
+    enum { FlagsMask = MQTTS_FLAG_WILL | MQTTS_FLAG_CLEAN };
+    typedef MqttsByteField<0> Flags;
+    typedef MqttsByteField<1> ProtocolId;
+    typedef MqttsWordField<2> Duration;
+};
+struct MqttsConnackLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_CONNACK, 1);
+    typedef MqttsByteField<0> ReturnCode;
+};
+struct MqttsWillTopicReqLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_WILLTOPICREQ, 0);
+};
+struct MqttsWillTopicLayout {           // WillTopic follows
+    MQTTS_LAYOUT(MQTTS_TYPE_WILLTOPIC, 1);
+    enum { FlagsMask = 0x70 };
+    typedef MqttsByteField<0> Flags;
+};
+struct MqttsWillMsgReqLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_WILLMSGREQ, 0);
+};
+struct MqttsWillMsgLayout {             // WillMsg follows
+    MQTTS_LAYOUT(MQTTS_TYPE_WILLMSG, 0);
+};
+struct MqttsRegisterLayout {            // TopicName follows
+    MQTTS_LAYOUT(MQTTS_TYPE_REGISTER, 4);
+    typedef MqttsWordField<0> TopicId;
+    typedef MqttsWordField<2> MsgId;
+};
+struct MqttsRegAckLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_REGACK, 5);
+    typedef MqttsWordField<0> TopicId;
+    typedef MqttsWordField<2> MsgId;
+    typedef MqttsByteField<4> ReturnCode;
+};
+struct MqttsPublishLayout {             // Data follows
+    MQTTS_LAYOUT(MQTTS_TYPE_PUBLISH, 5);
+    enum { FlagsMask = 0xf3 };
+    typedef MqttsByteField<0> Flags;
+    typedef MqttsBitField<0, 0x80> Dup;
+    typedef MqttsBitField<0, MQTTS_FLAG_QOS_MASK> Qos;
+    typedef MqttsBitField<0, MQTTS_FLAG_RETAIN> Retain;
+    typedef MqttsBitField<0, MQTTS_TOPIC_TYPE> TopicType;
+    typedef MqttsWordField<1> TopicId;
+    typedef MqttsWordField<3> MsgId;
+};
+struct MqttsPubAckLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_PUBACK, 5);
+    typedef MqttsWordField<0> TopicId;
+    typedef MqttsWordField<2> MsgId;
+    typedef MqttsByteField<4> ReturnCode;
+};
+struct MqttsSubscribeLayout {           // TopicName or TopicId follows
+    MQTTS_LAYOUT(MQTTS_TYPE_SUBSCRIBE, 3);
+    enum { FlagsMask = 0xe3 };
+    typedef MqttsByteField<0> Flags;
+    typedef MqttsBitField<0, 0x80> Dup;
+    typedef MqttsBitField<0, MQTTS_TOPIC_TYPE> TopicType;
+    typedef MqttsWordField<1> MsgId;
+    typedef MqttsWordField<3> TopicId;
+};
+struct MqttsSubAckLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_SUBACK, 6);
+    enum { FlagsMask = 0x60 };
+    typedef MqttsByteField<0> Flags;
+    typedef MqttsBitField<0, MQTTS_FLAG_QOS_MASK> Qos;
+    typedef MqttsWordField<1> TopicId;
+    typedef MqttsWordField<3> MsgId;
+    typedef MqttsByteField<5> ReturnCode;
+};
+struct MqttsUnsubscribeLayout {         // TopicName or TopicId follows
+    MQTTS_LAYOUT(MQTTS_TYPE_UNSUBSCRIBE, 3);
+    enum { FlagsMask = MQTTS_TOPIC_TYPE };
+    typedef MqttsByteField<0> Flags;
+    typedef MqttsWordField<1> MsgId;
+    typedef MqttsWordField<3> TopicId;
+};
+struct MqttsUnSubAckLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_UNSUBACK, 2);
+    typedef MqttsWordField<0> MsgId;
+};
+struct MqttsPingReqLayout {             // ClientId follows
+    MQTTS_LAYOUT(MQTTS_TYPE_PINGREQ, 0);
+};
+struct MqttsPingRespLayout {
+    MQTTS_LAYOUT(MQTTS_TYPE_PINGRESP, 0);
+};
+struct MqttsDisconnectLayout {          // Duration is optional
+    MQTTS_LAYOUT(MQTTS_TYPE_DISCONNECT, 0);
+    typedef MqttsWordField<0> Duration;
+};
+
+#define MQTTS_LEN_SEARCHGW     MqttsSearchGwLayout::Length     // messages of fixed length
+#define MQTTS_LEN_REGACK       MqttsRegAckLayout::Length
+#define MQTTS_LEN_PUBACK       MqttsPubAckLayout::Length
+#define MQTTS_LEN_SUBSCRIBE_ID (MqttsSubscribeLayout::Length + 2)
+#define MQTTS_LEN_DISCONNECT   (MqttsDisconnectLayout::Length + 2)
+#define MQTTS_LEN_ADVERTISE    MqttsAdvertiseLayout::Length
+#define MQTTS_LEN_GWINFO       MqttsGwInfoLayout::Length       // minimum, a Client adds the address
+#define MQTTS_LEN_CONNACK      MqttsConnackLayout::Length
+#define MQTTS_LEN_SUBACK       MqttsSubAckLayout::Length
+#define MQTTS_LEN_UNSUBACK     MqttsUnSubAckLayout::Length
+#define MQTTS_LEN_REGISTER     (MqttsRegisterLayout::Length + 2) // minimum, TopicName of length 0
+#define MQTTS_LEN_PUBLISH      MqttsPublishLayout::Length      // minimum, no data
+
 #define MQTTS_RC_ACCEPTED                  0x00
 #define MQTTS_RC_REJECTED_CONGESTION       0x01
 #define MQTTS_RC_REJECTED_INVALID_TOPIC_ID 0x02
@@ -127,6 +281,7 @@
 #define MQTTS_MSG_WAIT_ACK    3
 #define MQTTS_MSG_COMPLETE    4
 #define MQTTS_MSG_REJECTED    5
+#define MQTTS_MSG_XMIT_FAILED 6
 
 
 #define MQTTS_GW_INIT         0
@@ -149,6 +304,10 @@
 #define MQTTS_ERR_ACK_TIMEOUT       -10
 #define MQTTS_ERR_PINGRESP_TIMEOUT  -11
 #define MQTTS_ERR_INVALID_TOPICID   -12
+#define MQTTS_ERR_PAYLOAD_TOO_LONG  -13
+#define MQTTS_ERR_IN_PROGRESS       -14
+#define MQTTS_ERR_POOL_EXHAUSTED    -15
+#define MQTTS_ERR_NOT_SENT          -16     // QoS -1 PUBLISH refused or held back by the network
 
 #define MQTTS_TOPIC_MULTI_WILDCARD   '#'
 #define MQTTS_TOPIC_SINGLE_WILDCARD  '+'
@@ -217,9 +376,15 @@ public:
     bool  copy(MqttsMessage* src);
     void  reset();
     void  setMsgBuff(uint8_t* buff);
+    void  setMsgView(uint8_t* frame);
+    void  setMsgSlot(uint8_t* slot, uint8_t* frame);
+    bool  getFrame(FrameBuf* frame);
     const char* getMsgTypeName();
 protected:
+    void  freeBody();
     uint8_t* _msgBuff;
+    bool     _isView;  // _msgBuff refers to a received frame
+    bool     _isSlot;  // _msgBuff is in a slot of the SendQue
 private:
     uint8_t  _status; // 1:request 2:sending 3:resending 4:waitingAck  5:complite
     uint8_t  _length;
@@ -401,6 +566,7 @@ private:
 class MqttsPublish : public MqttsMessage  {
 public:
     MqttsPublish();
+    MqttsPublish(ZBResponse* resp);
     ~MqttsPublish();
     void setFlags(uint8_t flags);
     uint8_t getFlags();
@@ -553,6 +719,133 @@ private:
 
  };
 
+/*=====================================
+        Class MqttsFrameView
+ ======================================*/
+/*
+ *  Read-only view of a received message. The fields are read from the frame
+ *  in place, nothing is allocated or copied, and a view is copied as a pointer.
+ *  set() checks the type and the length against the received bytes, and
+ *  the getters are valid only after it returned true.
+ */
+class MqttsFrameView {
+public:
+    MqttsFrameView();
+    bool     set(ZBResponse* resp);
+    uint8_t  getLength(){ return _frame[0]; }
+    uint8_t  getType(){ return _frame[1]; }
+    uint8_t* getBody(){ return _frame + MQTTS_HEADER_SIZE; }
+protected:
+    bool     set(ZBResponse* resp, uint8_t type, uint8_t minLength);
+    uint8_t* _frame;
+};
+
+/*
+ *  View of the message type of Layout, checked against Layout::Length.
+ */
+template<class Layout>
+class MqttsLayoutView : public MqttsFrameView {
+public:
+    bool set(ZBResponse* resp){ return MqttsFrameView::set(resp, Layout::Type, Layout::Length); }
+};
+
+class MqttsAdvertiseView : public MqttsLayoutView<MqttsAdvertiseLayout> {
+public:
+    uint8_t  getGwId(){ return MqttsAdvertiseLayout::GwId::get(getBody()); }
+    uint16_t getDuration(){ return MqttsAdvertiseLayout::Duration::get(getBody()); }
+};
+
+class MqttsGwInfoView : public MqttsLayoutView<MqttsGwInfoLayout> {
+public:
+    uint8_t  getGwId(){ return MqttsGwInfoLayout::GwId::get(getBody()); }
+};
+
+class MqttsConnackView : public MqttsLayoutView<MqttsConnackLayout> {
+public:
+    uint8_t  getReturnCode(){ return MqttsConnackLayout::ReturnCode::get(getBody()); }
+};
+
+class MqttsRegisterView : public MqttsLayoutView<MqttsRegisterLayout> {
+public:
+    bool     set(ZBResponse* resp);                  // and TopicName
+    uint16_t getTopicId(){ return MqttsRegisterLayout::TopicId::get(getBody()); }
+    uint16_t getMsgId(){ return MqttsRegisterLayout::MsgId::get(getBody()); }
+    void     getTopicName(MQString* topicName);      // refers to the frame
+};
+
+class MqttsRegAckView : public MqttsLayoutView<MqttsRegAckLayout> {
+public:
+    uint16_t getTopicId(){ return MqttsRegAckLayout::TopicId::get(getBody()); }
+    uint16_t getMsgId(){ return MqttsRegAckLayout::MsgId::get(getBody()); }
+    uint8_t  getReturnCode(){ return MqttsRegAckLayout::ReturnCode::get(getBody()); }
+};
+
+class MqttsPublishView : public MqttsLayoutView<MqttsPublishLayout> {
+public:
+    uint8_t  getFlags(){ return MqttsPublishLayout::Flags::get(getBody()); }
+    uint8_t  getQos(){ return MqttsPublishLayout::Qos::get(getBody()); }
+    uint16_t getTopicId(){ return MqttsPublishLayout::TopicId::get(getBody()); }
+    uint16_t getMsgId(){ return MqttsPublishLayout::MsgId::get(getBody()); }
+    uint8_t* getData(){ return getBody() + MqttsPublishLayout::Tail; }
+    uint8_t  getDataLength(){ return getLength() - MqttsPublishLayout::Length; }
+};
+
+class MqttsPubAckView : public MqttsLayoutView<MqttsPubAckLayout> {
+public:
+    uint16_t getTopicId(){ return MqttsPubAckLayout::TopicId::get(getBody()); }
+    uint16_t getMsgId(){ return MqttsPubAckLayout::MsgId::get(getBody()); }
+    uint8_t  getReturnCode(){ return MqttsPubAckLayout::ReturnCode::get(getBody()); }
+};
+
+class MqttsSubAckView : public MqttsLayoutView<MqttsSubAckLayout> {
+public:
+    uint8_t  getFlags(){ return MqttsSubAckLayout::Flags::get(getBody()); }
+    uint16_t getTopicId(){ return MqttsSubAckLayout::TopicId::get(getBody()); }
+    uint16_t getMsgId(){ return MqttsSubAckLayout::MsgId::get(getBody()); }
+    uint8_t  getReturnCode(){ return MqttsSubAckLayout::ReturnCode::get(getBody()); }
+};
+
+class MqttsUnSubAckView : public MqttsLayoutView<MqttsUnSubAckLayout> {
+public:
+    uint16_t getMsgId(){ return MqttsUnSubAckLayout::MsgId::get(getBody()); }
+};
+
+/*=====================================
+        Class MqttsEncoder
+ ======================================*/
+/*
+ *  Writes a message into the buffer of the caller, without the heap.
+ *  The frame is the same as the one of the message class.
+ *  Each method returns the length, or 0 if the buffer is too small.
+ *  Flags include the topic type.
+ */
+class MqttsEncoder {
+public:
+    MqttsEncoder(uint8_t* buf, uint8_t size);
+    uint8_t searchGw(uint8_t radius);
+    uint8_t connect(uint8_t flags, uint16_t duration, MQString* clientId);
+    uint8_t willTopic(uint8_t flags, MQString* topic);
+    uint8_t willMsg(MQString* msg);
+    uint8_t registerTopic(uint16_t topicId, uint16_t msgId, MQString* topicName);
+    uint8_t regAck(uint16_t topicId, uint16_t msgId, uint8_t rc);
+    uint8_t publish(uint8_t flags, uint16_t topicId, uint16_t msgId, const uint8_t* data, uint8_t len);
+    uint8_t publish(uint8_t flags, uint16_t topicId, uint16_t msgId, MQString* data);
+    uint8_t pubAck(uint16_t topicId, uint16_t msgId, uint8_t rc);
+    uint8_t subscribe(uint8_t flags, uint16_t msgId, MQString* topicName);
+    uint8_t subscribe(uint8_t flags, uint16_t msgId, uint16_t topicId);
+    uint8_t unsubscribe(uint8_t flags, uint16_t msgId, MQString* topicName);
+    uint8_t unsubscribe(uint8_t flags, uint16_t msgId, uint16_t topicId);
+    uint8_t pingReq(MQString* clientId);
+    uint8_t disconnect(uint16_t duration);
+    uint8_t* getBuff();
+    uint8_t  getLength();
+private:
+    uint8_t* setHeader(uint8_t type, uint16_t length);
+    uint8_t* _buf;
+    uint8_t  _size;
+    uint8_t  _length;
+};
+
 /*=====================================
         Class Topic
  ======================================*/
@@ -569,6 +862,7 @@ public:
     uint8_t   getTopicType();
     TopicCallback getCallback();
     void     setTopicId(uint16_t id);
+    void     setTopicType(uint8_t type);
     void     setTopicName(MQString* topic);
     void     setStatus(uint8_t stat);
     int      execCallback(MqttsPublish* msg);
@@ -578,8 +872,9 @@ public:
     bool     isMatch(Topic* wildCard);
 private:
     uint16_t  _topicId;
+    uint8_t   _topicType;      // TopicId is NORMAL, PREDEFINED or SHORT
     uint8_t   _status;
-    MQString*  _topicStr;
+    MQString*  _topicStr;      // NULL for a PREDEFINED or SHORT TopicId subscribed by the Id
     TopicCallback  _callback;
 };
 
@@ -593,16 +888,18 @@ public:
       bool     allocate(uint8_t topicsSize);
       uint16_t  getTopicId(MQString* topic);
       Topic*    getTopic(MQString* topic);
-      Topic*    getTopic(uint16_t topicId);
+      Topic*    getTopic(uint16_t topicId, uint8_t topicType);
       bool     setTopicId(MQString* topic, uint16_t id);
       bool     setCallback(MQString* topic, TopicCallback callback);
-      bool     setCallback(uint16_t topicId, TopicCallback callback);
-      int     execCallback(uint16_t  topicId, MqttsPublish* msg);
+      bool     setCallback(uint16_t topicId, uint8_t topicType, TopicCallback callback);
+      int     execCallback(MqttsPublish* msg);
       void     addTopic(MQString* topic);
+      void     addTopic(uint16_t topicId, uint8_t topicType);
       Topic*    match(MQString* topic);
       void     setSize(uint8_t size);
 
 private:
+    Topic*    newTopic();
 
     uint8_t   _sizeMax;
     uint8_t   _elmCnt;
@@ -8,7 +8,8 @@
 #define LINUX
 //#define MBED
 
-//#define XBEE_FLOWCTL_CRTSCTS
+//#define XBEE_FLOWCTRL_CRTSCTS
+//#define XBEE_LOW_LATENCY
 
 /*=================================
  *      Debug Condition
@@ -69,36 +69,53 @@
 using namespace std;
 using namespace tomyClient;
 
-static MqttsClient*  theMqtts;
-
 /*=================================================================
 
         Class MqttsClient
 
  ================================================================*/
-void ResponseHandler(ZBResponse* resp, int* returnCode){
-        theMqtts->recieveMessageHandler(resp, returnCode);
+/*
+ *  The network calls back the client which set the handler,
+ *  so that several clients can run in a process.
+ */
+static void ResponseHandler(ZBResponse* resp, int* returnCode, void* client){
+        ((MqttsClient*)client)->recieveMessageHandler(resp, returnCode);
+}
+
+static void XmitStatusHandler(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount, void* client){
+        ((MqttsClient*)client)->xmitStatusHandler(frameId, deliveryStatus, retryCount);
 }
 
 MqttsClient::MqttsClient(){
     _sp = new SerialPort();
     _zbee = new ZBeeStack();
     _zbee->setSerialPort(_sp);
-    _zbee->setRxHandler(ResponseHandler);
+    _zbee->setRxHandler(ResponseHandler, this);
+    _zbee->setXmitStatusHandler(XmitStatusHandler, this);
+    _network = _zbee;
     _sendQ = new SendQue();
     _qos = 0;
+    _qosN1 = false;
     _duration = 0;
     _clientId = new MQString();
     _clientFlg = 0;
     _nRetry = 5;
     _nRetryCnt = 0;
+    _xmitFailCnt = 0;
+    _roundDelayed = false;
     _tRetry = 0;
     _willTopic = _willMessage = NULL;
     _clientStatus.setKeepAlive(MQTTS_DEFAULT_KEEPALIVE);
     _msgId = 0;
     _topics.allocate(MQTTS_MAX_TOPICS);
     _sendFlg = false;
-    theMqtts = this;
+    _txFrameId = 0;
+    _nonBlocking = false;
+    _rand = 0;
+#ifdef LINUX
+    _wheel = NULL;
+    _wheelTimer = NULL;
+#endif
 }
 
 MqttsClient::~MqttsClient(){
@@ -110,12 +127,14 @@ MqttsClient::~MqttsClient(){
 #ifdef ARDUINO
 void MqttsClient::begin(long baudrate){
         _sp->begin(baudrate);
+        initRadio();
 }
 #endif /* ARDUINO */
 
 #ifdef MBED
 void MqttsClient::begin(long baudrate){
             _sp->begin(baudrate);
+            initRadio();
     }
 #endif /* MBED */
 
@@ -125,9 +144,24 @@ void MqttsClient::begin(long baudrate){
       printf(" Serialport open Error %s", device);
         exit(-1);
       }
+      initRadio();
+  }
+
+  /*
+   *  Use another network instead of XBee, ex) UdpStack. It is not deleted by the client.
+   */
+  void MqttsClient::begin(Network* network){
+      _network = network;
+      _network->setRxHandler(ResponseHandler, this);
   }
 #endif  /* LINUX */
 
+void MqttsClient::initRadio(){
+    if (!_zbee->initRadio()){
+        D_MQTTW("XBee not responding to AT commands\r\n");
+    }
+}
+
 
 
 
@@ -136,6 +170,7 @@ bool MqttsClient::init(const char* clientNameId){
     MQString* pre1 = new MQString(MQTTS_TOPIC_PREDEFINED_TIME);
     _topics.addTopic(pre1);
     _topics.setTopicId(pre1,MQTTS_TOPICID_PREDEFINED_TIME);
+    _topics.getTopic(pre1)->setTopicType(MQTTS_TOPIC_TYPE_PREDEFINED);
     return _zbee->init(clientNameId);
 }
 
@@ -157,7 +192,15 @@ void MqttsClient::setWillMessage(MQString* msg){
     _clientFlg |= MQTTS_FLAG_WILL;
 }
 
-void MqttsClient::setQos(uint8_t level){
+/*
+ *  QoS -1 publishes with a predefined TopicId or a short TopicName to the
+ *  Gateway address, with no SEARCHGW, CONNECT or REGISTER before it.
+ */
+void MqttsClient::setQos(int8_t level){
+    _qosN1 = (level < 0);
+    if (_qosN1){
+        return;
+    }
     if (level == 0){
             _clientFlg |= MQTTS_FLAG_QOS_0;
     }else if (level == 1){
@@ -202,6 +245,75 @@ MQString* MqttsClient::getClientId(){
     return _clientId;
 }
 
+Network* MqttsClient::getNetwork(){
+    return _network;
+}
+
+/*
+ *  Non-blocking client doesn't wait for the response in exec().
+ *  exec() returns MQTTS_ERR_IN_PROGRESS while the request is on the way,
+ *  call it again when the network is readable or getNextTimeout() expires.
+ */
+void MqttsClient::setNonBlocking(bool on){
+    _nonBlocking = on;
+}
+
+/*
+ *  Millseconds until exec() has something to do without receiving a message.
+ */
+uint32_t MqttsClient::getNextTimeout(){
+    if (getMsgRequestCount()){
+        if (getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK){
+            return _respTimer.getRemain();
+        }else if (_network->getTxQueCount() > 0){
+            return XTIMER_INFINITE;    // until the network is writable
+        }
+        return (isDelayed() ? _delayTimer.getRemain() : 0);
+    }
+    if (!_clientStatus.isConnected()){
+        return 0;      // search the Gateway or connect
+    }
+    return _clientStatus.getKeepAliveRemain();
+}
+
+#ifdef LINUX
+/*
+ *  The timer is started for getNextTimeout() whenever exec() returns,
+ *  so the owner of the wheel needs no scan of its clients.
+ */
+void MqttsClient::setTimer(TimerWheel* wheel, TimerEntry* timer){
+    if (_wheel && _wheelTimer){
+        _wheel->stop(_wheelTimer);
+    }
+    _wheel = wheel;
+    _wheelTimer = timer;
+}
+
+void MqttsClient::updateTimer(){
+    if (_wheel == NULL || _wheelTimer == NULL){
+        return;
+    }
+    uint32_t tm = getNextTimeout();
+    if (tm == XTIMER_INFINITE){
+        _wheel->stop(_wheelTimer);
+    }else{
+        _wheel->start(_wheelTimer, tm);
+    }
+}
+#endif /* LINUX */
+
+
+/*
+ *  The message is framed by the network in its own buffer.
+ *  Returns the frame ID, or PACKET_ERROR_NOT_SENT if the network did not take it.
+ */
+int MqttsClient::sendMsg(MqttsMessage* msg, SendReqType type){
+    FrameBuf frame;
+    if (msg->getFrame(&frame)){
+        return _network->sendFrame(&frame, 0, type);
+    }
+    return _network->send(msg->getMsgBuff(), msg->getLength(), 0, type);
+}
 
 uint16_t MqttsClient::getNextMsgId(){
     _msgId++;
@@ -226,12 +338,22 @@ uint8_t MqttsClient::getMsgRequestCount(){
   return _sendQ->getCount();
 }
 
+/*
+ *  Requests refused with MQTTS_ERR_POOL_EXHAUSTED.
+ */
+uint16_t MqttsClient::getPoolExhaustedCount(){
+  return _sendQ->getExhaustedCount();
+}
+
 void MqttsClient::setMsgRequestStatus(uint8_t stat){
     _sendQ->setStatus(0,stat);
 }
 
 void MqttsClient::clearMsgRequest(){
     _sendQ->deleteRequest(0);
+    _nRetryCnt = 0;
+    _xmitFailCnt = 0;
+    _roundDelayed = false;
 }
 
 void MqttsClient::createTopic(MQString* topic, TopicCallback callback){
@@ -239,23 +361,90 @@ void MqttsClient::createTopic(MQString* topic, TopicCallback callback){
     _topics.setCallback(topic, callback);
 }
 
-void MqttsClient::delayTime(uint16_t maxTime){
+/*
+ *  xorshift32 of this client, seeded once from the clock, the address
+ *  of the radio and the client ID, so clients started together draw
+ *  different delays.
+ */
+uint32_t MqttsClient::getRandom(){
+    if (_rand == 0){
 #ifdef ARDUINO
-    srand((uint32_t)millis( ));
-    uint32_t tm = rand() % (maxTime * 1000);
+        _rand = (uint32_t)millis();
 #else
-    srand((uint32_t)time( NULL ));
-    uint32_t tm = (rand() % (maxTime * 1000));
+        _rand = (uint32_t)time(NULL);
 #endif
+        _rand ^= _zbee->getMyAddress64().getLsb();
+        for (uint8_t i = 0; i < _clientId->getCharLength(); i++){
+            _rand = (_rand ^ (uint8_t)_clientId->getChar(i)) * 16777619UL;   // FNV-1a
+        }
+        if (_rand == 0){
+            _rand = 0x2545f491;
+        }
+    }
+    _rand ^= _rand << 13;
+    _rand ^= _rand >> 17;
+    _rand ^= _rand << 5;
+    return _rand;
+}
+
+void MqttsClient::delayTime(uint16_t maxTime){
+    uint32_t tm = getRandom() % ((uint32_t)maxTime * 1000);
+    if (_nonBlocking){
+        _delayTimer.start(tm);    // the request is held until the time is up
+        return;
+    }
     XTimer delayTimer;
     delayTimer.start(tm);
     while(!delayTimer.isTimeUp()){
-        _zbee->readPacket();
+        _network->waitPacket(delayTimer.getRemain());
+        _network->readPacket();
     }
 }
 
-void MqttsClient::copyMsg(MqttsMessage* msg, ZBResponse* recvMsg){
-    memcpy(msg->getMsgBuff(), recvMsg->getPayload(), recvMsg->getPayload(0));
+/*
+ *  Request held by delayTime() or a congestion of the Gateway.
+ */
+bool MqttsClient::isDelayed(){
+    uint32_t tm = _delayTimer.getRemain();
+    if (tm == XTIMER_INFINITE){
+        return false;
+    }else if (tm > 0){
+        return true;
+    }
+    _delayTimer.stop();
+    return false;
+}
+
+/*
+ *  A new message is not pulled from SendQue while the network holds
+ *  bytes of the previous one (XBee backpressured by CTS).
+ *  Blocking client waits for them to be written.
+ */
+bool MqttsClient::isTxReady(){
+    if (_network->getTxQueCount() == 0){
+        return true;
+    }else if (_nonBlocking){
+        return false;
+    }
+    XTimer tm;
+    tm.start(MQTTS_TIME_RETRY * 1000);
+    while (_network->getTxQueCount() > 0 && !tm.isTimeUp()){
+        _network->waitPacket(tm.getRemain());    // writes the held bytes
+        _network->readPacket();
+    }
+    return true;
+}
+
+/*
+ *  Wait for the response, or return false for a non-blocking client
+ *  if nothing has been received.
+ */
+bool MqttsClient::waitResponse(uint32_t msec){
+    if (_nonBlocking){
+        return _network->waitPacket(0);
+    }
+    _network->waitPacket(msec);
+    return true;
 }
 
 
@@ -275,17 +464,16 @@ int MqttsClient::registerTopic(MQString* topic){
 
 /*--------- PUBLISH ------*/
 int MqttsClient::publish(MQString* topic, const char* data, int dataLength){
-    uint16_t topicId = _topics.getTopicId(topic);
-    if (topicId){
-        MqttsPublish mqttsMsg = MqttsPublish();
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_SHORT);
-        mqttsMsg.setTopicId(topicId);
-        mqttsMsg.setData((uint8_t*)data, (uint8_t)dataLength);
-        if (_qos){
-            mqttsMsg.setMsgId(getNextMsgId());
+    Topic* tp = _topics.getTopic(topic);
+    if (_qosN1 && (tp == NULL || tp->getTopicType() == MQTTS_TOPIC_TYPE_NORMAL)){
+        if (topic->getCharLength() != 2){
+            return MQTTS_ERR_NO_TOPICID;     // QoS -1 has no REGISTER
         }
-        requestSendMsg((MqttsMessage*)&mqttsMsg);
-        return exec();
+        return publishId(MQTTS_TOPIC_TYPE_SHORT, MQTTS_SHORT_TOPIC_ID(topic->getChar(0), topic->getChar(1)),
+                         data, dataLength);
+    }
+    if (tp && tp->getTopicId()){
+        return publishId(tp->getTopicType(), tp->getTopicId(), data, dataLength);
     }else{
     	D_MQTTW("PUBLISH unkown TopicId\r\n");
     	return MQTTS_ERR_NO_TOPICID;
@@ -294,20 +482,23 @@ int MqttsClient::publish(MQString* topic, const char* data, int dataLength){
 
 /*--------- PUBLISH ------*/
 int MqttsClient::publish(MQString* topic, MQString* data){
-    uint16_t topicId = _topics.getTopicId(topic);
-    if (topicId){
-        MqttsPublish mqttsMsg = MqttsPublish();
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_SHORT);
-        mqttsMsg.setTopicId(topicId);
-        mqttsMsg.setData(data);
-        if (_qos){
-            mqttsMsg.setMsgId(getNextMsgId());
+    Topic* tp = _topics.getTopic(topic);
+    uint8_t topicType = (tp ? tp->getTopicType() : MQTTS_TOPIC_TYPE_NORMAL);
+    uint16_t topicId = (tp ? tp->getTopicId() : 0);
+    if (_qosN1 && topicType == MQTTS_TOPIC_TYPE_NORMAL){
+        if (topic->getCharLength() != 2){
+            return MQTTS_ERR_NO_TOPICID;
         }
-        requestSendMsg((MqttsMessage*)&mqttsMsg);
-
-        int rc = exec();
+        topicType = MQTTS_TOPIC_TYPE_SHORT;
+        topicId = MQTTS_SHORT_TOPIC_ID(topic->getChar(0), topic->getChar(1));
+    }
+    if (topicId){
+        uint8_t buf[SENDQ_SLOT_SIZE];
+        MqttsEncoder enc(buf + NW_MAX_HEADROOM, MQTTS_MAX_PACKET_LENGTH);
+        int rc = sendPublish(buf, enc.publish(getPublishFlags(topicType), topicId,
+                                              (_qos && !_qosN1 ? getNextMsgId() : 0), data));
 
-		if( rc == MQTTS_ERR_INVALID_TOPICID){
+		if( rc == MQTTS_ERR_INVALID_TOPICID && topicType == MQTTS_TOPIC_TYPE_NORMAL){
 			registerTopic(topic);
 			rc = exec();
 		}
@@ -321,30 +512,76 @@ int MqttsClient::publish(MQString* topic, MQString* data){
 
 /*--------- PUBLISH ------*/
 int MqttsClient::publish(uint16_t predefinedId, const char* data, int dataLength){
-    MqttsPublish mqttsMsg = MqttsPublish();
-    mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_PREDEFINED);
-    mqttsMsg.setTopicId(predefinedId);
-    mqttsMsg.setData((uint8_t*)data, (uint8_t)dataLength);
-    if (_qos){
-        mqttsMsg.setMsgId(getNextMsgId());
+    return publishId(MQTTS_TOPIC_TYPE_PREDEFINED, predefinedId, data, dataLength);
+}
+
+/*--------- PUBLISH ------*/
+/*
+ *  Two characters of a short TopicName are the TopicId, which is never registered.
+ */
+int MqttsClient::publishShort(const char* shortTopic, const char* data, int dataLength){
+    if (strlen(shortTopic) != 2){
+        return MQTTS_ERR_NO_TOPICID;
+    }
+    return publishId(MQTTS_TOPIC_TYPE_SHORT, MQTTS_SHORT_TOPIC_ID(shortTopic[0], shortTopic[1]), data, dataLength);
+}
+
+int MqttsClient::publishId(uint8_t topicType, uint16_t topicId, const char* data, int dataLength){
+    uint8_t buf[SENDQ_SLOT_SIZE];
+    MqttsEncoder enc(buf + NW_MAX_HEADROOM, MQTTS_MAX_PACKET_LENGTH);
+    if (dataLength > MQTTS_MAX_PACKET_LENGTH){
+        return MQTTS_ERR_PAYLOAD_TOO_LONG;
+    }
+    return sendPublish(buf, enc.publish(getPublishFlags(topicType), topicId, (_qos && !_qosN1 ? getNextMsgId() : 0),
+                                        (const uint8_t*)data, (uint8_t)dataLength));
+}
+
+uint8_t MqttsClient::getPublishFlags(uint8_t topicType){
+    if (_qosN1){
+        return MQTTS_FLAG_QOS_N1 | (_clientFlg & MQTTS_FLAG_RETAIN) | topicType;
+    }
+    return _clientFlg | topicType;
+}
+
+/*
+ *  The PUBLISH is encoded behind NW_MAX_HEADROOM bytes of buf. QoS -1 is sent
+ *  once from there, with no MsgId, no SendQue slot and no retry, so it returns
+ *  MQTTS_ERR_NOT_SENT if the network is backpressured or refuses the frame.
+ */
+int MqttsClient::sendPublish(uint8_t* buf, uint8_t len){
+    if (len == 0){
+        return MQTTS_ERR_PAYLOAD_TOO_LONG;
+    }
+    if (_qosN1){
+        FrameBuf frame;
+        frame.init(buf, NW_MAX_HEADROOM + len + NW_MAX_TAILROOM, NW_MAX_HEADROOM);
+        frame.put(len);
+        if (!isTxReady() || _network->getTxQueCount() > 0){
+            return MQTTS_ERR_NOT_SENT;
+        }
+        if (_network->sendFrame(&frame, 0, UcastReq) < 0){
+            return MQTTS_ERR_NOT_SENT;
+        }
+        return MQTTS_ERR_NO_ERROR;
+    }
+    int rc = requestSendMsg(buf + NW_MAX_HEADROOM);
+    if (rc != MQTTS_ERR_NO_ERROR){
+        return rc;
     }
-    requestSendMsg((MqttsMessage*)&mqttsMsg);
     return exec();
 }
 
 /*--------- SUBSCRIBE ------*/
 int MqttsClient::subscribe(MQString* topic, TopicCallback callback){
-    MqttsSubscribe mqttsMsg = MqttsSubscribe();
-    uint16_t topicId = _topics.getTopicId(topic);
-    if (topicId){
-        mqttsMsg.setTopicId(topicId);
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_NORMAL);
-    }else{
-        mqttsMsg.setTopicName(topic);
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_SHORT);
-        _topics.addTopic(topic);
-        _topics.setCallback(topic, callback);
+    Topic* tp = _topics.getTopic(topic);
+    if (tp && tp->getTopicType() != MQTTS_TOPIC_TYPE_NORMAL){
+        return subscribeId(tp->getTopicType(), tp->getTopicId(), callback);
     }
+    MqttsSubscribe mqttsMsg = MqttsSubscribe();
+    mqttsMsg.setTopicName(topic);                // a NORMAL TopicId is not subscribed
+    mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_NORMAL);
+    _topics.addTopic(topic);
+    _topics.setCallback(topic, callback);
     mqttsMsg.setMsgId(getNextMsgId());
     requestSendMsg((MqttsMessage*)&mqttsMsg);
     return exec();
@@ -352,26 +589,37 @@ int MqttsClient::subscribe(MQString* topic, TopicCallback callback){
 
 /*--------- SUBSCRIBE ------*/
 int MqttsClient::subscribe(uint16_t predefinedId, TopicCallback callback){
+    return subscribeId(MQTTS_TOPIC_TYPE_PREDEFINED, predefinedId, callback);
+}
+
+/*--------- SUBSCRIBE ------*/
+int MqttsClient::subscribeShort(const char* shortTopic, TopicCallback callback){
+    if (strlen(shortTopic) != 2){
+        return MQTTS_ERR_NO_TOPICID;
+    }
+    return subscribeId(MQTTS_TOPIC_TYPE_SHORT, MQTTS_SHORT_TOPIC_ID(shortTopic[0], shortTopic[1]), callback);
+}
+
+int MqttsClient::subscribeId(uint8_t topicType, uint16_t topicId, TopicCallback callback){
     MqttsSubscribe mqttsMsg = MqttsSubscribe();
-    mqttsMsg.setTopicId(predefinedId);
-    mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_PREDEFINED);
+    mqttsMsg.setTopicId(topicId);
+    mqttsMsg.setFlags(_clientFlg | topicType);
     mqttsMsg.setMsgId(getNextMsgId());
-    _topics.setCallback(predefinedId, callback);
+    _topics.addTopic(topicId, topicType);
+    _topics.setCallback(topicId, topicType, callback);
     requestSendMsg((MqttsMessage*)&mqttsMsg);
     return exec();
 }
 
 /*--------- UNSUBSCRIBE ------*/
 int MqttsClient::unsubscribe(MQString* topic){
-    MqttsUnsubscribe mqttsMsg = MqttsUnsubscribe();
-    uint16_t topicId = _topics.getTopicId(topic);
-    if (topicId){
-        mqttsMsg.setTopicId(topicId);
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_NORMAL);
-    }else{
-        mqttsMsg.setTopicName(topic);
-        mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_SHORT);
+    Topic* tp = _topics.getTopic(topic);
+    if (tp && tp->getTopicType() != MQTTS_TOPIC_TYPE_NORMAL){
+        return unsubscribeId(tp->getTopicType(), tp->getTopicId());
     }
+    MqttsUnsubscribe mqttsMsg = MqttsUnsubscribe();
+    mqttsMsg.setTopicName(topic);
+    mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_NORMAL);
     mqttsMsg.setMsgId(getNextMsgId());
     requestSendMsg((MqttsMessage*)&mqttsMsg);
     return exec();
@@ -379,10 +627,22 @@ int MqttsClient::unsubscribe(MQString* topic){
 
 /*--------- UNSUBSCRIBE ------*/
 int MqttsClient::unsubscribe(uint16_t predefinedId){
+    return unsubscribeId(MQTTS_TOPIC_TYPE_PREDEFINED, predefinedId);
+}
+
+/*--------- UNSUBSCRIBE ------*/
+int MqttsClient::unsubscribeShort(const char* shortTopic){
+    if (strlen(shortTopic) != 2){
+        return MQTTS_ERR_NO_TOPICID;
+    }
+    return unsubscribeId(MQTTS_TOPIC_TYPE_SHORT, MQTTS_SHORT_TOPIC_ID(shortTopic[0], shortTopic[1]));
+}
+
+int MqttsClient::unsubscribeId(uint8_t topicType, uint16_t topicId){
     MqttsUnsubscribe mqttsMsg = MqttsUnsubscribe();
-    mqttsMsg.setTopicId(predefinedId);
+    mqttsMsg.setTopicId(topicId);
     mqttsMsg.setMsgId(getNextMsgId());
-    mqttsMsg.setFlags(_clientFlg | MQTTS_TOPIC_TYPE_PREDEFINED);
+    mqttsMsg.setFlags(_clientFlg | topicType);
     requestSendMsg((MqttsMessage*)&mqttsMsg);
     return exec();
 }
@@ -431,11 +691,10 @@ int MqttsClient::willMsg(){
 
 /*--------- PUBACK ------*/
 int MqttsClient::pubAck(uint16_t topicId, uint16_t msgId, uint8_t rc){
-    MqttsPubAck mqttsMsg = MqttsPubAck();
-    mqttsMsg.setTopicId(topicId);
-    mqttsMsg.setMsgId(msgId);
-    mqttsMsg.setReturnCode(rc);
-    return requestPrioritySendMsg((MqttsMessage*)&mqttsMsg);
+    uint8_t frame[MQTTS_LEN_PUBACK];
+    MqttsEncoder enc(frame, sizeof(frame));
+    enc.pubAck(topicId, msgId, rc);
+    return requestPrioritySendMsg(frame);
 }
 
 /*--------- REGACK ------*/
@@ -453,28 +712,57 @@ int  MqttsClient::pingReq(MQString* clientId){
     return requestSendMsg((MqttsMessage*)&mqttsMsg);
 }
 
+/* ===================================================
+          Transmit Status of the XBee
+ =====================================================*/
+void MqttsClient::xmitStatusHandler(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount){
+    D_MQTTW(" Transmit Status = 0x");
+    D_MQTT(deliveryStatus, HEX);
+    D_MQTTF("%x", deliveryStatus);
+    D_MQTTW(" Retry = ");
+    D_MQTTLN(retryCount, DEC);
+    D_MQTTF("%d\r\n", retryCount);
+
+    /*---- MAC level failure of the message waiting for the ACK ----*/
+    if (frameId == _txFrameId && deliveryStatus != ZB_XMIT_STATUS_SUCCESS &&
+        getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK){
+        setMsgRequestStatus(MQTTS_MSG_XMIT_FAILED);
+    }
+}
+
 /* ===================================================
           Procedures for  Received Messages
  =====================================================*/
+/*
+ *  Messages are read in the receive buffer through the views. A message
+ *  shorter than its type is dropped.
+ */
 void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
-    if ( _clientStatus.isSearching() && (recvMsg->getPayload(1) != MQTTS_TYPE_GWINFO)){
+    MqttsFrameView frame;
+    if (!frame.set(recvMsg)){
+        D_MQTTW(" Invalid length\r\n");
+        *returnCode = MQTTS_ERR_NO_ERROR;
+
+    }else if ( _clientStatus.isSearching() && (recvMsg->getPayload(1) != MQTTS_TYPE_GWINFO)){
         *returnCode = MQTTS_ERR_NO_ERROR;
 
 /*---------  REGISTER  ----------*/
 	}else if (recvMsg->getPayload(1) == MQTTS_TYPE_REGISTER){
 
-		if(_clientStatus.isAvailableToSend()){
+		MqttsRegisterView mqMsg;
+		if(!mqMsg.set(recvMsg)){
+			D_MQTTW(" REGISTER invalid length\r\n");
+		}else if(_clientStatus.isAvailableToSend()){
 			D_MQTTW(" REGISTER received\r\n");
-			MqttsRegister mqMsg = MqttsRegister();
-
-			mqMsg.setFrame(recvMsg);
-			uint16_t topicId = _topics.getTopicId(mqMsg.getTopicName());
+			MQString topicName;
+			mqMsg.getTopicName(&topicName);
+			uint16_t topicId = _topics.getTopicId(&topicName);
 			if (topicId == 0){
-				if (_topics.match(mqMsg.getTopicName())){
-					MQString* mqStr = mqMsg.getTopicName()->create();
+				if (_topics.match(&topicName)){
+					MQString* mqStr = topicName.create();
 					_topics.addTopic(mqStr);
 					_topics.setTopicId(mqStr,mqMsg.getTopicId());
-					_topics.setCallback(mqMsg.getTopicId(),_topics.match(mqStr)->getCallback());
+					_topics.setCallback(mqMsg.getTopicId(), MQTTS_TOPIC_TYPE_NORMAL, _topics.match(mqStr)->getCallback());
 				}
 			}
 
@@ -489,12 +777,14 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
 /*---------  PUBLISH  --------*/
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_PUBLISH){
 
-    	if(_clientStatus.isAvailableToSend()){
+    	MqttsPublishView pubView;
+    	if(!pubView.set(recvMsg)){
+    		D_MQTTW("PUBLISH invalid length\r\n");
+    	}else if(_clientStatus.isAvailableToSend()){
     		D_MQTTW("PUBLISH received\r\n");
-			MqttsPublish mqMsg = MqttsPublish();
-			mqMsg.setFrame(recvMsg);
+			MqttsPublish mqMsg(recvMsg);     // view of the received frame
 			_pubHdl.exec(&mqMsg,&_topics);   // Execute Callback routine
-			if (mqMsg.getQos() && MQTTS_FLAG_QOS_1){
+			if ((mqMsg.getFlags() & MQTTS_FLAG_QOS_MASK) == MQTTS_FLAG_QOS_1){
 				pubAck(mqMsg.getTopicId(), mqMsg.getMsgId(), MQTTS_RC_ACCEPTED);
 			}
     	}else{
@@ -507,14 +797,16 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_PUBACK &&
     		(getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK &&
     		 getMsgRequestType() == MQTTS_TYPE_PUBLISH)){
-        MqttsPubAck mqMsg = MqttsPubAck();
-        copyMsg(&mqMsg, recvMsg);
+        MqttsPubAckView mqMsg;
+        if (!mqMsg.set(recvMsg)){
+            return;
+        }
 
         D_MQTTW("\nPUBACK received ReturnCode=");
         D_MQTTLN(mqMsg.getReturnCode(),DEC);
         D_MQTTF("%d\r\n", mqMsg.getReturnCode());
 
-        if (mqMsg.getMsgId() == getUint16(_sendQ->getMessage(0)->getBody() + 3)){
+        if (mqMsg.getMsgId() == MqttsPublishLayout::MsgId::get(_sendQ->getMessage(0)->getBody())){
             if (mqMsg.getReturnCode() == MQTTS_RC_ACCEPTED){
                 setMsgRequestStatus(MQTTS_MSG_COMPLETE);
 
@@ -542,27 +834,36 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_ADVERTISE){
         D_MQTTW(" ********** ADVERTISE received\r\n");
 
-        MqttsAdvertise mqMsg = MqttsAdvertise();
-        copyMsg(&mqMsg, recvMsg);
-        _clientStatus.recvADVERTISE(&mqMsg);
+        MqttsAdvertiseView mqMsg;
+        if (mqMsg.set(recvMsg)){
+            _clientStatus.recvADVERTISE(&mqMsg);
+            _network->addGwAddress();            // a standby Gateway is trusted without searching
+        }
 
 /*---------  GWINFO  ----------*/
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_GWINFO){
         D_MQTTW(" GWINFO received\r\n");
-        MqttsGwInfo mqMsg = MqttsGwInfo();
-        copyMsg(&mqMsg, recvMsg);
+        MqttsGwInfoView mqMsg;
+        if (!mqMsg.set(recvMsg)){
+            return;
+        }
+        if (mqMsg.getLength() == MQTTS_LEN_GWINFO){       // sent by a Gateway, not by a Client
+            _network->addGwAddress();
+        }
         if (getMsgRequestType() == MQTTS_TYPE_SEARCHGW){
             setMsgRequestStatus(MQTTS_MSG_COMPLETE);
             _clientStatus.recvGWINFO();
-            _zbee->setGwAddress(_zbee->getRxRemoteAddress64(), _zbee->getRxRemoteAddress16());
+            _network->setGwAddress();
         }
 
 /*---------  CONNACK  ----------*/
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_CONNACK){
         D_MQTTW(" CONNACK received");
         if ((getMsgRequestType() == MQTTS_TYPE_CONNECT || getMsgRequestType() == MQTTS_TYPE_WILLMSG)){
-            MqttsConnack mqMsg = MqttsConnack();
-            copyMsg(&mqMsg, recvMsg);
+            MqttsConnackView mqMsg;
+            if (!mqMsg.set(recvMsg)){
+                return;
+            }
 
             D_MQTT(" RC = 0x");
             D_MQTT(mqMsg.getReturnCode(),HEX);
@@ -591,41 +892,41 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
 
         if (getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK &&
             getMsgRequestType() == MQTTS_TYPE_REGISTER){
-            MqttsRegAck mqMsg = MqttsRegAck();
-            copyMsg(&mqMsg, recvMsg);
-            if (mqMsg.getMsgId() == getUint16(_sendQ->getMessage(0)->getBody() + 2)){
-                if (mqMsg.getMsgId() == getUint16(_sendQ->getMessage(0)->getBody() + 2)){
-                    if (getUint16((uint8_t*)_sendQ->getMessage(0)->getBody()+4)){
-                        if (mqMsg.getReturnCode() == MQTTS_RC_ACCEPTED){
-                            setMsgRequestStatus(MQTTS_MSG_COMPLETE);
-                            MQString topic;
-                            topic.readBuf(_sendQ->getMessage(0)->getBody() + 4);
-                            _topics.setTopicId(&topic, mqMsg.getTopicId());
-                        }else if (mqMsg.getReturnCode() == MQTTS_RC_REJECTED_CONGESTION){
-                          setMsgRequestStatus(MQTTS_MSG_RESEND_REQ);
-                        }else{
-                            *returnCode = MQTTS_ERR_REJECTED;
-                        }
-                    }
+            MqttsRegAckView mqMsg;
+            uint8_t* body = _sendQ->getMessage(0)->getBody();
+            if (mqMsg.set(recvMsg) && mqMsg.getMsgId() == MqttsRegisterLayout::MsgId::get(body) &&
+                getUint16(body + MqttsRegisterLayout::Tail)){
+                if (mqMsg.getReturnCode() == MQTTS_RC_ACCEPTED){
+                    setMsgRequestStatus(MQTTS_MSG_COMPLETE);
+                    MQString topic;
+                    topic.readBuf(body + MqttsRegisterLayout::Tail);
+                    _topics.setTopicId(&topic, mqMsg.getTopicId());
+                }else if (mqMsg.getReturnCode() == MQTTS_RC_REJECTED_CONGESTION){
+                    setMsgRequestStatus(MQTTS_MSG_RESEND_REQ);
+                }else{
+                    *returnCode = MQTTS_ERR_REJECTED;
                 }
             }
         }
 
 /*---------  SUBACK  ----------*/
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_SUBACK && getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK){
-        MqttsSubAck mqMsg = MqttsSubAck();
-        copyMsg(&mqMsg, recvMsg);
+        MqttsSubAckView mqMsg;
+        if (!mqMsg.set(recvMsg)){
+            return;
+        }
 
         D_MQTT("\nSUBACK ReturnCode=");
         D_MQTTLN(mqMsg.getReturnCode(),HEX);
         D_MQTTF("\nSUBACK ReturnCode=%d\r\n", mqMsg.getReturnCode());
 
-        if (mqMsg.getMsgId() == getUint16(_sendQ->getMessage(0)->getBody() + 1)){
+        if (mqMsg.getMsgId() == MqttsSubscribeLayout::MsgId::get(_sendQ->getMessage(0)->getBody())){
             if (mqMsg.getReturnCode() == MQTTS_RC_ACCEPTED){
                 setMsgRequestStatus(MQTTS_MSG_COMPLETE);
-                if (_sendQ->getMessage(0)->getBodyLength() > 5){ // TopicName is not Id
+                uint8_t* body = _sendQ->getMessage(0)->getBody();
+                if (MqttsSubscribeLayout::TopicType::get(body) == MQTTS_TOPIC_TYPE_NORMAL){ // subscribed by TopicName
                     MQString topic;
-                    topic.readBuf(_sendQ->getMessage(0)->getBody() + 3);
+                    topic.readBuf(body + MqttsSubscribeLayout::Tail);
                     _topics.setTopicId(&topic, mqMsg.getTopicId());
 
                 }
@@ -639,9 +940,8 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
 /*---------  UNSUBACK  ----------*/
     }else if (recvMsg->getPayload(1) == MQTTS_TYPE_UNSUBACK && getMsgRequestStatus() == MQTTS_MSG_WAIT_ACK){
         D_MQTTW(" UNSUBACK received\r\n");
-        MqttsUnSubAck mqMsg = MqttsUnSubAck();
-        copyMsg(&mqMsg, recvMsg);
-        if (mqMsg.getMsgId() == getUint16(_sendQ->getMessage(0)->getBody() + 1)){
+        MqttsUnSubAckView mqMsg;
+        if (mqMsg.set(recvMsg) && mqMsg.getMsgId() == MqttsUnsubscribeLayout::MsgId::get(_sendQ->getMessage(0)->getBody())){
               setMsgRequestStatus(MQTTS_MSG_COMPLETE);
         }
 
@@ -675,11 +975,35 @@ void MqttsClient::recieveMessageHandler(ZBResponse* recvMsg, int* returnCode){
 }
 
 
+/*========================================================
+    Receive Messages until the time expires
+==========================================================*/
+void MqttsClient::recvMsg(uint16_t msec){
+    XTimer tm;
+    tm.start(msec);
+    while(!tm.isTimeUp()){
+        exec();
+        uint32_t remain = tm.getRemain();
+        uint32_t keepAlive = _clientStatus.getKeepAliveRemain();
+        _network->waitPacket(remain < keepAlive ? remain : keepAlive);
+    }
+}
+
 /*========================================================
     Send a MQTT-S Message (add the send request)
 ==========================================================*/
 int MqttsClient::requestSendMsg(MqttsMessage* mqttsMsgPtr){
-    int index = _sendQ->addRequest((MqttsMessage*)mqttsMsgPtr);
+    return requestSendMsg(mqttsMsgPtr->getMsgBuff());
+}
+
+int MqttsClient::requestSendMsg(uint8_t* frame){
+    if (frame[0] > _network->getMaxPayload() || frame[0] > MQTTS_MAX_PACKET_LENGTH){
+        return MQTTS_ERR_PAYLOAD_TOO_LONG;     // over the max payload of the radio or a slot
+    }
+    int index = _sendQ->addRequest(frame);
+    if (index < 0){
+        return index;
+    }
 	_sendQ->setStatus(index, MQTTS_MSG_REQUEST);
     return MQTTS_ERR_NO_ERROR;
 }
@@ -688,7 +1012,14 @@ int MqttsClient::requestSendMsg(MqttsMessage* mqttsMsgPtr){
   Send a MQTT-S Message (add to the top of the send request)
 ==========================================================*/
 int MqttsClient::requestPrioritySendMsg(MqttsMessage* mqttsMsgPtr){
-    _sendQ->addPriorityRequest((MqttsMessage*)mqttsMsgPtr);
+    return requestPrioritySendMsg(mqttsMsgPtr->getMsgBuff());
+}
+
+int MqttsClient::requestPrioritySendMsg(uint8_t* frame){
+    int rc = _sendQ->addPriorityRequest(frame);
+    if (rc < 0){
+        return rc;
+    }
     _sendQ->setStatus(0, MQTTS_MSG_REQUEST);
     return MQTTS_ERR_NO_ERROR;
 }
@@ -713,12 +1044,18 @@ int MqttsClient::exec(){
 		if ((rc == MQTTS_ERR_NO_ERROR) && getMsgRequestCount() == 0 ){
 			break;
 		}
+		if(rc == MQTTS_ERR_IN_PROGRESS){
+			break;
+		}
 		if(rc == MQTTS_ERR_NO_TOPICID){
 			break;
 		}
 		if(rc == MQTTS_ERR_INVALID_TOPICID){
 			break;
 		}
+		if(rc == MQTTS_ERR_GATEWAY_LOST){
+			break;
+		}
 		if (rc == MQTTS_ERR_RETRY_OVER && getMsgRequestType() == MQTTS_TYPE_PUBLISH ){
 			_clientStatus.recvDISCONNECT();
 			break;
@@ -746,6 +1083,9 @@ int MqttsClient::exec(){
 		}
 	}
     _sendFlg = false;
+#ifdef LINUX
+    updateTimer();
+#endif
     return rc;
 }
 
@@ -762,7 +1102,6 @@ int MqttsClient::sendRecvMsg(){
 		if (getMsgRequestType() != MQTTS_TYPE_SEARCHGW){
 			searchGw(ZB_BROADCAST_RADIUS_MAX_HOPS);
 		}
-		delayTime(MQTTS_TIME_SEARCHGW);
 
 		_clientStatus.sendSEARCHGW();
 		rc = broadcast(MQTTS_TIME_SEARCHGW);
@@ -777,9 +1116,13 @@ int MqttsClient::sendRecvMsg(){
 			connect();
 		}
 		rc = unicast(MQTTS_TIME_RETRY);
+		if (rc == MQTTS_ERR_IN_PROGRESS){
+			return rc;
+		}
 	}
 
-	if (getMsgRequestStatus() == MQTTS_MSG_REQUEST || getMsgRequestStatus() == MQTTS_MSG_RESEND_REQ){
+	if (getMsgRequestStatus() == MQTTS_MSG_REQUEST || getMsgRequestStatus() == MQTTS_MSG_RESEND_REQ ||
+		(_nonBlocking && getMsgRequestCount() > 0)){
         /*======  Send Message =======*/
         if (_clientStatus.isAvailableToSend()){
 			rc = unicast(MQTTS_TIME_RETRY);
@@ -797,7 +1140,10 @@ int MqttsClient::sendRecvMsg(){
             rc = unicast(MQTTS_TIME_RETRY);
         }
     }
-	_zbee->readPacket();  //  Receive MQTT-S Message
+	if (rc == MQTTS_ERR_IN_PROGRESS){
+		return rc;
+	}
+	_network->readPacket();  //  Receive MQTT-S Message
 	return rc;
 }
 
@@ -805,56 +1151,86 @@ int MqttsClient::sendRecvMsg(){
  *   Broad cast the MQTT-S Message
  -------------------------------------*/
 int MqttsClient::broadcast(uint16_t packetReadTimeout){
-    int retry = 0;
-    while(retry < _nRetry){
-        _zbee->send(_sendQ->getMessage(0)->getMsgBuff(), _sendQ->getMessage(0)->getLength(), 0, BcastReq);
-        _respTimer.start(packetReadTimeout * 1000);
-
-        if (_qos == 0 && getMsgRequestType() != MQTTS_TYPE_SEARCHGW){
-		   clearMsgRequest();
-		   return MQTTS_ERR_NO_ERROR;
+    while(_nRetryCnt < _nRetry){
+        if (getMsgRequestStatus() == MQTTS_MSG_REQUEST){
+            if (!_roundDelayed && getMsgRequestType() == MQTTS_TYPE_SEARCHGW){
+                _roundDelayed = true;
+                delayTime(MQTTS_TIME_SEARCHGW);    // each search round, the clients lose the Gateway together
+            }
+            if (isDelayed() || !isTxReady()){
+                return MQTTS_ERR_IN_PROGRESS;
+            }
+            if (sendMsg(_sendQ->getMessage(0), BcastReq) < 0){
+                _nRetryCnt++;             // sent again when the network is ready
+                continue;
+            }
+            _respTimer.start(packetReadTimeout * 1000);
+
+            if (_qos == 0 && getMsgRequestType() != MQTTS_TYPE_SEARCHGW){
+               clearMsgRequest();
+               return MQTTS_ERR_NO_ERROR;
+            }
+            setMsgRequestStatus(MQTTS_MSG_WAIT_ACK);
         }
-        setMsgRequestStatus(MQTTS_MSG_WAIT_ACK);
 
         while(!_respTimer.isTimeUp()){
            if (getMsgRequestStatus() == MQTTS_MSG_COMPLETE){
         	   clearMsgRequest();
                return MQTTS_ERR_NO_ERROR;
            }
-           _zbee->readPacket();
+           if (!waitResponse(_respTimer.getRemain())){
+               return MQTTS_ERR_IN_PROGRESS;
+           }
+           _network->readPacket();
         }
 
         setMsgRequestStatus(MQTTS_MSG_REQUEST);
-        retry++;
+        _nRetryCnt++;
     }
-   return MQTTS_ERR_RETRY_OVER;
+    _nRetryCnt = 0;
+    _roundDelayed = false;
+    return MQTTS_ERR_RETRY_OVER;
 }
 
 /*------------------------------------
  *   Unicast the MQTT-S Message
  -------------------------------------*/
 int MqttsClient::unicast(uint16_t packetReadTimeout){
-    int retry = 0;
-    while(retry < _nRetry){
+    while(_nRetryCnt < _nRetry){
     	/*------ Send Top message in SendQue -----*/
-    	if (getMsgRequestStatus() != MQTTS_MSG_REQUEST){
+    	if (getMsgRequestStatus() == MQTTS_MSG_REQUEST){
+            if (isDelayed() || !isTxReady()){
+                return MQTTS_ERR_IN_PROGRESS;
+            }
+            int frameId = sendMsg(_sendQ->getMessage(0), UcastReq);
+            _respTimer.start(packetReadTimeout * 1000);
+            if (frameId < 0){
+                /*---- Not taken by the network, sent again when it is ready ----*/
+                setMsgRequestStatus(MQTTS_MSG_XMIT_FAILED);
+            }else{
+                D_MQTTW(" Send via XBee  Msg = ");
+                D_MQTTLN(_sendQ->getMessage(0)->getMsgTypeName());
+                D_MQTTF("%s\r\n", _sendQ->getMessage(0)->getMsgTypeName());
+
+                _txFrameId = frameId;
+                _sendQ->getMessage(0)->setDup();
+                _clientStatus.setLastSendTime();
+                setMsgRequestStatus(MQTTS_MSG_WAIT_ACK);
+            }
+
+    	}else if (!_nonBlocking){
     		return MQTTS_ERR_NO_ERROR;
     	}
 
-        _zbee->send(_sendQ->getMessage(0)->getMsgBuff(), _sendQ->getMessage(0)->getLength(), 0, UcastReq);
-
-        D_MQTTW(" Send via XBee  Msg = ");
-        D_MQTTLN(_sendQ->getMessage(0)->getMsgTypeName());
-        D_MQTTF("%s\r\n", _sendQ->getMessage(0)->getMsgTypeName());
-
-        _sendQ->getMessage(0)->setDup();
-        _respTimer.start(packetReadTimeout * 1000);
-        _clientStatus.setLastSendTime();
-        setMsgRequestStatus(MQTTS_MSG_WAIT_ACK);
-
         while(!_respTimer.isTimeUp()){
-            if ((_qos == 0 && getMsgRequestType() != MQTTS_TYPE_PINGREQ )  ||
+            if (getMsgRequestStatus() == MQTTS_MSG_XMIT_FAILED){
+                /* ----- Not delivered, re send without waiting the timer ---*/
+                _xmitFailCnt++;
+                break;
+
+            }else if ((_qos == 0 && getMsgRequestType() != MQTTS_TYPE_PINGREQ )  ||
                               getMsgRequestType() == MQTTS_TYPE_PUBACK     ||
+                              getMsgRequestType() == MQTTS_TYPE_REGACK     ||
                               getMsgRequestStatus() == MQTTS_MSG_COMPLETE ){
             	clearMsgRequest();
                 return MQTTS_ERR_NO_ERROR;
@@ -868,6 +1244,12 @@ int MqttsClient::unicast(uint16_t packetReadTimeout){
             	clearMsgRequest();
                 return MQTTS_ERR_REJECTED;
 
+            }else if (getMsgRequestStatus() == MQTTS_MSG_RESEND_REQ && _nonBlocking){
+                /* ------  Re send after the delay without blocking -------*/
+                _delayTimer.start(MQTTS_TIME_WAIT * 1000);
+                setMsgRequestStatus(MQTTS_MSG_REQUEST);
+                return MQTTS_ERR_IN_PROGRESS;
+
             }else if (getMsgRequestStatus() == MQTTS_MSG_RESEND_REQ){
 
             	/* ------  Re send Time delay -------*/
@@ -882,11 +1264,19 @@ int MqttsClient::unicast(uint16_t packetReadTimeout){
                 #endif
 
                 /* ----- Re send  Top message in SendQue ---*/
-				_zbee->send(_sendQ->getMessage(0)->getMsgBuff(), _sendQ->getMessage(0)->getLength(), 0, UcastReq);
+				int frameId = sendMsg(_sendQ->getMessage(0), UcastReq);
+				if (frameId < 0){
+					setMsgRequestStatus(MQTTS_MSG_XMIT_FAILED);
+					continue;
+				}
+				_txFrameId = frameId;
 				setMsgRequestStatus(MQTTS_MSG_WAIT_ACK);
             }
             /*----- Read response  ----*/
-            if(_zbee->readPacket() == MQTTS_ERR_INVALID_TOPICID){
+            if (!waitResponse(_respTimer.getRemain())){
+                return MQTTS_ERR_IN_PROGRESS;
+            }
+            if(_network->readPacket() == MQTTS_ERR_INVALID_TOPICID){
             	clearMsgRequest();
             	return MQTTS_ERR_INVALID_TOPICID;
             }
@@ -898,8 +1288,16 @@ int MqttsClient::unicast(uint16_t packetReadTimeout){
             }
         }
         setMsgRequestStatus(MQTTS_MSG_REQUEST);
-        retry++;
+        _nRetryCnt++;
     }
+    _nRetryCnt = 0;
+    if (_xmitFailCnt == _nRetry){
+        /*---- Gateway is unreachable ----*/
+        _xmitFailCnt = 0;
+        _clientStatus.lostGW();
+        return MQTTS_ERR_GATEWAY_LOST;
+    }
+    _xmitFailCnt = 0;
     return MQTTS_ERR_RETRY_OVER;
 }
 
@@ -909,41 +1307,71 @@ int MqttsClient::unicast(uint16_t packetReadTimeout){
 SendQue::SendQue(){
     _queCnt = 0;
     _queSize = SENDQ_SIZE;
+    _exhaustedCnt = 0;
+    for (_freeCnt = 0; _freeCnt < SENDQ_SIZE; _freeCnt++){
+        _free[_freeCnt] = &_slot[SENDQ_SIZE - 1 - _freeCnt];
+        _msg[_freeCnt] = NULL;
+    }
 }
 SendQue::~SendQue(){
-    for( int i = 0; i < _queCnt; i++){
-        delete _msg[i];
+
+}
+
+/*
+ *  Free slot with a copy of the frame, NULL if the pool is exhausted.
+ */
+MqttsMessage* SendQue::getSlot(uint8_t* frame){
+    if (_freeCnt == 0){
+        _exhaustedCnt++;
+        return NULL;
     }
+    MqttsMessage* slot = _free[--_freeCnt];
+    slot->setMsgSlot(_slotBuff[slot - _slot], frame);
+    return slot;
 }
 
 int SendQue::addRequest(MqttsMessage* msg){
+    return addRequest(msg->getMsgBuff());
+}
+
+int SendQue::addRequest(uint8_t* frame){
     if ( _queCnt < _queSize){
 		D_MQTTW("\nAdd SendQue size = ");
 		D_MQTT(_queCnt + 1, DEC);
 		D_MQTT(" Msg = 0x");
-		D_MQTTLN(msg->getType(), HEX);
-		D_MQTTF("%d  Msg = 0x%x\r\n", _queCnt + 1, msg->getType());
+		D_MQTTLN(frame[1], HEX);
+		D_MQTTF("%d  Msg = 0x%x\r\n", _queCnt + 1, frame[1]);
 
-        _msg[_queCnt] =new MqttsMessage();
-        _msg[_queCnt++]->copy(msg);
+        MqttsMessage* slot = getSlot(frame);
+        if (slot == NULL){
+            return MQTTS_ERR_POOL_EXHAUSTED;
+        }
+        _msg[_queCnt++] = slot;
         return _queCnt - 1;
     }
     return MQTTS_ERR_CANNOT_ADD_REQUEST; // Over Que size
 }
 
 int SendQue::addPriorityRequest(MqttsMessage* msg){
+    return addPriorityRequest(msg->getMsgBuff());
+}
+
+int SendQue::addPriorityRequest(uint8_t* frame){
     if ( _queCnt < _queSize){
 		D_MQTTW("\nAdd SendQue Top Size = ");
 		D_MQTT(_queCnt + 1, DEC);
 		D_MQTT("  Msg = 0x");
-		D_MQTTLN(msg->getType(), HEX);
-		D_MQTTF("%d  Msg = 0x%x", _queCnt + 1, msg->getType());
+		D_MQTTLN(frame[1], HEX);
+		D_MQTTF("%d  Msg = 0x%x", _queCnt + 1, frame[1]);
 
+        MqttsMessage* slot = getSlot(frame);
+        if (slot == NULL){
+            return MQTTS_ERR_POOL_EXHAUSTED;
+        }
         for(int i = _queCnt; i > 0; i--){
             _msg[i] = _msg[i - 1];
         }
-        _msg[0] = new MqttsMessage();
-        _msg[0]->copy(msg);
+        _msg[0] = slot;
         _queCnt++;
 
         for(int i = 1; i < _queCnt; i++){
@@ -961,7 +1389,7 @@ int SendQue::deleteRequest(uint8_t index){
 
 	if ( index < _queCnt){
 
-        delete _msg[index];
+        _free[_freeCnt++] = _msg[index];
         _queCnt--;
 
     	D_MQTTW("\nDelete SendQue  Size = ");
@@ -976,9 +1404,7 @@ int SendQue::deleteRequest(uint8_t index){
         }
 
         D_MQTTW("\r\n");
-        for(int i = _queCnt; i < _queSize; i++){
-            _msg[i] = NULL;
-        }
+        _msg[_queCnt] = NULL;
 
         return 0;
     }
@@ -1001,6 +1427,10 @@ void SendQue::setQueSize(uint8_t sz){
   _queSize = sz;
 }
 
+uint16_t SendQue::getExhaustedCount(){
+    return _exhaustedCnt;
+}
+
 MqttsMessage* SendQue::getMessage(uint8_t index){
   if ( index < _queCnt){
       return _msg[index];
@@ -1080,6 +1510,13 @@ bool ClientStatus::isPINGREQRequired(){
 	return (_keepAliveTimer.isTimeUp(_keepAliveDuration) && (_clStat != CL_DISCONNECTED));
 }
 
+uint32_t ClientStatus::getKeepAliveRemain(){
+	if (_clStat == CL_DISCONNECTED){
+		return XTIMER_INFINITE;
+	}
+	return _keepAliveTimer.getRemain(_keepAliveDuration);
+}
+
 bool ClientStatus::isGatewayAlive(){
 	if(_advertiseTimer.isTimeUp(_advertiseDuration)){
 		_gwStat = GW_LOST;
@@ -1107,7 +1544,7 @@ void ClientStatus::recvGWINFO(){
 	}
 }
 
-void ClientStatus::recvADVERTISE(MqttsAdvertise* adv){
+void ClientStatus::recvADVERTISE(MqttsAdvertiseView* adv){
 	if ( adv->getGwId() == _gwId || _gwId == 0){
 		_advertiseTimer.start();
 		_advertiseDuration = (adv->getDuration() > 60 ?
@@ -1133,6 +1570,11 @@ void ClientStatus::recvPINGRESP(){
     _keepAliveTimer.start();
 }
 
+void ClientStatus::lostGW(){
+	_gwStat = GW_LOST;
+	_clStat = CL_DISCONNECTED;
+}
+
 
 
 
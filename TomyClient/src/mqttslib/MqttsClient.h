@@ -54,6 +54,9 @@
                 #endif
                 #include <iostream>
                 #include "MQTTS.h"
+                #ifdef LINUX
+                    #include "TimerWheel.h"
+                #endif
         #endif
 #endif
 
@@ -67,7 +70,14 @@
 #define CL_ASLEEP        2
 #define CL_AWAKE         3
 
-#define SENDQ_SIZE    6
+#ifndef SENDQ_SIZE
+  #ifdef ARDUINO
+    #define SENDQ_SIZE    4      // slots take SENDQ_SLOT_SIZE bytes of RAM each
+  #else
+    #define SENDQ_SIZE    6
+  #endif
+#endif
+#define SENDQ_SLOT_SIZE  (NW_MAX_HEADROOM + MQTTS_MAX_PACKET_LENGTH + NW_MAX_TAILROOM)
 
 using namespace tomyClient;
 
@@ -87,13 +97,15 @@ public:
 	bool isGatewayAlive();
 
 	uint16_t getKeepAlive();
+	uint32_t getKeepAliveRemain();
 	void setKeepAlive(uint16_t sec);
 	void sendSEARCHGW();
 	void recvGWINFO();
-	void recvADVERTISE(MqttsAdvertise* adv);
+	void recvADVERTISE(MqttsAdvertiseView* adv);
 	void recvCONNACK();
 	void recvDISCONNECT();
 	void recvPINGRESP();
+	void lostGW();
 	void setLastSendTime();
 	void init();
 
@@ -111,12 +123,18 @@ private:
 /*=====================================
         Class SendQue  (FIFO)
  ======================================*/
+/*
+ *  Messages are copied into a fixed pool of slots, so the queue neither
+ *  allocates nor frees, and moves only the pointers to the slots.
+ */
 class SendQue {
 public:
     SendQue();
     ~SendQue();
     int addRequest(MqttsMessage* msg);
+    int addRequest(uint8_t* frame);
     int addPriorityRequest(MqttsMessage* msg);
+    int addPriorityRequest(uint8_t* frame);
     void setStatus(uint8_t index, uint8_t status);
     MqttsMessage* getMessage(uint8_t index);
     int  getStatus(uint8_t index);
@@ -124,10 +142,17 @@ public:
     int deleteRequest(uint8_t index);
     void   deleteAllRequest();
     void setQueSize(uint8_t sz);
+    uint16_t getExhaustedCount();
 private:
+    MqttsMessage* getSlot(uint8_t* frame);
     uint8_t   _queSize;
     uint8_t   _queCnt;
-    MqttsMessage*  _msg[SENDQ_SIZE];
+    uint8_t   _freeCnt;
+    uint16_t  _exhaustedCnt;            // requests refused for no free slot
+    MqttsMessage*  _msg[SENDQ_SIZE];    // queued slots in order
+    MqttsMessage*  _free[SENDQ_SIZE];
+    MqttsMessage   _slot[SENDQ_SIZE];
+    uint8_t   _slotBuff[SENDQ_SIZE][SENDQ_SLOT_SIZE];
 };
 
 
@@ -146,6 +171,7 @@ public:
         void begin(long baudrate);
     #else
         void begin(char* device, unsigned int bauderate);  /* MBED & LINUX */
+        void begin(Network* network);
     #endif /* MBED */
   #endif /* ARDUINO */
 
@@ -154,7 +180,7 @@ public:
     void setKeepAlive(uint16_t sec);
     void setWillTopic(MQString* topic);
     void setWillMessage(MQString* msg);
-    void setQos(uint8_t level);
+    void setQos(int8_t level);         // -1: publishes need no connection
     void setRetain(bool retain);
     void setClean(bool clean);
     void setRetryMax(uint8_t cnt);
@@ -162,29 +188,42 @@ public:
     uint16_t getRxRemoteAddress16();
     XBeeAddress64& getRxRemoteAddress64();
     MQString* getClientId();
+    Network* getNetwork();
+    void setNonBlocking(bool on);
+    uint32_t getNextTimeout();
+#ifdef LINUX
+    void setTimer(TimerWheel* wheel, TimerEntry* timer);
+#endif
 
 
     int  publish(MQString* topic, const char* data, int dataLength);
     int  publish(MQString* topic, MQString* data);
     int  publish(uint16_t predifinedId,  const char* data, int dataLength);
+    int  publishShort(const char* shortTopic, const char* data, int dataLength);
     int  registerTopic(MQString* topic);
     int  subscribe(MQString* topic, TopicCallback callback);
     int  subscribe(uint16_t predefinedId, TopicCallback callback);
+    int  subscribeShort(const char* shortTopic, TopicCallback callback);
     int  unsubscribe(MQString* topic);
     int  unsubscribe(uint16_t predefinedId);
+    int  unsubscribeShort(const char* shortTopic);
     int  disconnect(uint16_t duration = 0);
 
     void recieveMessageHandler(ZBResponse* msg, int* returnCode);
+    void xmitStatusHandler(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount);
     void publishHdl(MqttsPublish* msg);
     void recvMsg(uint16_t msec);
     int  exec();
     uint8_t getMsgRequestCount();
+    uint16_t getPoolExhaustedCount();
 
 private:
     int  sendRecvMsg();
     void clearMsgRequest();
     int  requestSendMsg(MqttsMessage* msg);
+    int  requestSendMsg(uint8_t* frame);
     int  requestPrioritySendMsg(MqttsMessage* mqttsMsgPtr);
+    int  requestPrioritySendMsg(uint8_t* frame);
     int  broadcast(uint16_t packetReadTimeout);
     int  unicast(uint16_t packetReadTimeout);
 
@@ -195,35 +234,60 @@ private:
     int  willMsg();
     int  pubAck(uint16_t topicId, uint16_t msgId, uint8_t rc);
     int  regAck(uint16_t topicId, uint16_t msgId, uint8_t rc);
+    int  publishId(uint8_t topicType, uint16_t topicId, const char* data, int dataLength);
+    uint8_t getPublishFlags(uint8_t topicType);
+    int  sendPublish(uint8_t* buf, uint8_t len);
+    int  subscribeId(uint8_t topicType, uint16_t topicId, TopicCallback callback);
+    int  unsubscribeId(uint8_t topicType, uint16_t topicId);
 
     uint8_t getMsgRequestType();
     uint8_t getMsgRequestStatus();
     void   setMsgRequestStatus(uint8_t stat);
     void createTopic(MQString* topic, TopicCallback callback);
 
+    void initRadio();
     void delayTime(uint16_t baseTime);
-    void copyMsg(MqttsMessage* msg, ZBResponse* recvMsg);
+    uint32_t getRandom();
+    bool isDelayed();
+    bool isTxReady();
+    bool waitResponse(uint32_t msec);
+    int  sendMsg(MqttsMessage* msg, SendReqType type);
     uint16_t getNextMsgId();
+#ifdef LINUX
+    void updateTimer();
+#endif
 
     ZBeeStack*       _zbee;
+    Network*         _network;         // _zbee or the one given to begin()
     SerialPort*      _sp;
     Topics           _topics;
     SendQue*         _sendQ;
     XTimer           _respTimer;
+    XTimer           _delayTimer;      // holds the request of a non-blocking client
     PublishHandller  _pubHdl;
 
     uint8_t          _qos;
+    bool             _qosN1;           // QoS -1 set by setQos(-1)
     uint16_t         _duration;
     MQString*        _clientId;
     uint8_t          _clientFlg;
     uint8_t          _nRetry;
     uint8_t          _nRetryCnt;
+    uint8_t          _xmitFailCnt;
+    bool             _roundDelayed;    // SEARCHGW delayed in this round of retries
     uint16_t         _tRetry;
     MQString*         _willTopic;
     MQString*         _willMessage;
     uint16_t         _msgId;
     ClientStatus     _clientStatus;
     bool             _sendFlg;
+    uint8_t          _txFrameId;
+    bool             _nonBlocking;
+    uint32_t         _rand;            // state of getRandom(), 0 until seeded
+#ifdef LINUX
+    TimerWheel*      _wheel;           // deadline of getNextTimeout() is kept here
+    TimerEntry*      _wheelTimer;
+#endif
 };
 
 
@@ -251,10 +251,22 @@ int MqttsClientApplication::publish(uint16_t predefinedId, const char* data, int
     return _mqtts.publish(predefinedId, data, dataLength);
 }
 
+int MqttsClientApplication::publishShort(const char* shortTopic, const char* data, int dataLength){
+    return _mqtts.publishShort(shortTopic, data, dataLength);
+}
+
+int MqttsClientApplication::subscribeShort(const char* shortTopic, TopicCallback callback){
+    return _mqtts.subscribeShort(shortTopic, callback);
+}
+
 int MqttsClientApplication::unsubscribe(MQString* topic){
     return _mqtts.unsubscribe(topic);
 }
 
+int MqttsClientApplication::unsubscribeShort(const char* shortTopic){
+    return _mqtts.unsubscribeShort(shortTopic);
+}
+
 int MqttsClientApplication::disconnect(uint16_t duration){
     return _mqtts.disconnect(duration);
 }
@@ -262,7 +274,7 @@ int MqttsClientApplication::disconnect(uint16_t duration){
 void MqttsClientApplication::setKeepAlive(uint16_t msec){
     _mqtts.setKeepAlive(msec);
 }
-void MqttsClientApplication::setQos(uint8_t level){
+void MqttsClientApplication::setQos(int8_t level){
     _mqtts.setQos(level);
 }
 
@@ -104,7 +104,7 @@ public:
 	void begin(long baudrate);
 	void init(const char* clientNameId);
 	void setKeepAlive(uint16_t msec);
-	void setQos(uint8_t level);
+	void setQos(int8_t level);
 	void setWillTopic(MQString* willTopic);
 	void setWillMessage(MQString* willMsg);
 	void setRetain(bool retain);
@@ -121,9 +121,12 @@ public:
 	int registerTopic(MQString* topic);
 	int publish(MQString* topic, const char* data, int dataLength);
 	int publish(uint16_t predefinedId, const char* data, int dataLength);
+	int publishShort(const char* shortTopic, const char* data, int dataLength);
 	int subscribe(MQString* topic, TopicCallback callback);
 	int subscribe(uint16_t predefinedId, TopicCallback callback);
+	int subscribeShort(const char* shortTopic, TopicCallback callback);
 	int unsubscribe(MQString* topic);
+	int unsubscribeShort(const char* shortTopic);
 	int disconnect(uint16_t duration);
 
 	void startWdt();
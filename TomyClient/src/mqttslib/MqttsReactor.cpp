@@ -0,0 +1,264 @@
+/*
+ * MqttsReactor.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "MqttsReactor.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+/*=====================================
+        Class MqttsReactor
+ ======================================*/
+MqttsReactor::MqttsReactor(){
+    _epfd = epoll_create(MQTTS_REACTOR_MAX_EVENTS);
+    _clientCnt = 0;
+    _readyCnt = 0;
+    _polledCnt = 0;
+    _running = false;
+    for (int i = 0; i < MQTTS_REACTOR_MAX_CLIENTS; i++){
+        _client[i] = NULL;
+        _ready[i] = _writing[i] = false;
+        _timer[i].setCallback(timerHandler, this);
+    }
+}
+
+MqttsReactor::~MqttsReactor(){
+    for (int i = 0; i < MQTTS_REACTOR_MAX_CLIENTS; i++){
+        if (_client[i]){
+            remove(_client[i]);
+        }
+    }
+    if (_epfd >= 0){
+        ::close(_epfd);
+    }
+}
+
+/*
+ *  The client is set non-blocking. It has to be begun and initialized.
+ */
+int MqttsReactor::add(MqttsClient* client){
+    int slot = -1;
+
+    if (_epfd < 0){
+        return -1;
+    }
+    for (int i = 0; i < MQTTS_REACTOR_MAX_CLIENTS; i++){
+        if (_client[i] == client){
+            return -1;
+        }else if (_client[i] == NULL && slot < 0){
+            slot = i;
+        }
+    }
+    if (slot < 0){
+        return -1;
+    }
+
+    _client[slot] = client;
+    int cnt = watch(slot, EPOLL_CTL_ADD, EPOLLIN);
+    if (cnt < 0){
+        watch(slot, EPOLL_CTL_DEL, 0);
+        _client[slot] = NULL;
+        return -1;
+    }
+    if (cnt == 0){
+        _polledList[_polledCnt++] = slot;
+    }
+    client->setNonBlocking(true);
+    client->setTimer(&_timers, &_timer[slot]);
+    _writing[slot] = false;
+    _clientCnt++;
+    setReady(slot);             // start searching the Gateway
+    return slot;
+}
+
+/*
+ *  The client is blocking again.
+ */
+void MqttsReactor::remove(MqttsClient* client){
+    for (int i = 0; i < MQTTS_REACTOR_MAX_CLIENTS; i++){
+        if (_client[i] == client){
+            watch(i, EPOLL_CTL_DEL, 0);
+            for (int j = 0; j < _polledCnt; j++){
+                if (_polledList[j] == i){
+                    _polledList[j] = _polledList[--_polledCnt];
+                    break;
+                }
+            }
+            client->setTimer(NULL, NULL);
+            client->setNonBlocking(false);
+            _timers.stop(&_timer[i]);
+            _client[i] = NULL;
+            _ready[i] = false;
+            _clientCnt--;
+            return;
+        }
+    }
+}
+
+/*
+ *  Add, modify or delete the descriptors of the client in the slot.
+ *  Returns the number of them, or -1.
+ */
+int MqttsReactor::watch(int slot, int op, uint32_t events){
+    int fds[MQTTS_REACTOR_MAX_FDS];
+    struct epoll_event ev;
+    int rc = 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u32 = slot;
+    uint8_t cnt = _client[slot]->getNetwork()->getFds(fds, MQTTS_REACTOR_MAX_FDS);
+    for (uint8_t i = 0; i < cnt; i++){
+        if (epoll_ctl(_epfd, op, fds[i], &ev) < 0){
+            D_MQTTF("epoll_ctl error %d\r\n", errno);
+            rc = -1;
+        }
+    }
+    return (rc < 0 ? rc : cnt);
+}
+
+/*
+ *  Deadline of a client.
+ */
+void MqttsReactor::timerHandler(TimerEntry* timer){
+    MqttsReactor* reactor = (MqttsReactor*)timer->getArg();
+    reactor->setReady(timer - reactor->_timer);
+}
+
+void MqttsReactor::setReady(int slot){
+    if (!_ready[slot]){
+        _ready[slot] = true;
+        _readyList[_readyCnt++] = slot;
+    }
+}
+
+/*
+ *  Wait for the descriptors or the next deadline, and execute the clients
+ *  which have something to do. Only those clients are visited, so a pass
+ *  doesn't cost more with idle clients.
+ *  Returns the number of the clients executed.
+ */
+int MqttsReactor::exec(uint32_t timeoutMillsec){
+    struct epoll_event ev[MQTTS_REACTOR_MAX_EVENTS];
+    uint32_t timeout = _timers.getNextTimeout();
+    int cnt = 0;
+
+    if (timeoutMillsec < timeout){
+        timeout = timeoutMillsec;
+    }
+    if (_polledCnt > 0 && timeout > MQTTS_REACTOR_POLL_TIME){
+        timeout = MQTTS_REACTOR_POLL_TIME;
+    }
+    if (_readyCnt > 0){
+        timeout = 0;
+    }
+
+    int n = epoll_wait(_epfd, ev, MQTTS_REACTOR_MAX_EVENTS, (timeout > 0x7fffffff ? -1 : (int)timeout));
+    if (n < 0 && errno != EINTR){
+        D_MQTTF("epoll_wait error %d\r\n", errno);
+    }
+    for (int i = 0; i < n; i++){
+        int slot = ev[i].data.u32;
+        if (_client[slot] == NULL){
+            continue;
+        }
+        if (ev[i].events & EPOLLOUT){
+            _client[slot]->getNetwork()->sendTxQue();
+        }
+        setReady(slot);
+    }
+    _timers.expire();
+    for (int i = 0; i < _polledCnt; i++){
+        setReady(_polledList[i]);
+    }
+
+    uint16_t readyCnt = _readyCnt;
+    for (uint16_t i = 0; i < readyCnt; i++){
+        int slot = _readyList[i];
+        if (_client[slot] != NULL && _ready[slot]){
+            _ready[slot] = false;
+            execClient(slot);
+            cnt++;
+        }
+    }
+    /*---- clients made ready meanwhile are left for the next pass ----*/
+    for (uint16_t i = readyCnt; i < _readyCnt; i++){
+        _readyList[i - readyCnt] = _readyList[i];
+    }
+    _readyCnt -= readyCnt;
+    return cnt;
+}
+
+/*
+ *  Messages left in the buffer of the network don't wake epoll up,
+ *  so read them here. While the network holds output, EPOLLOUT wakes
+ *  the client instead of its timer.
+ */
+void MqttsReactor::execClient(int slot){
+    MqttsClient* client = _client[slot];
+    client->exec();
+    for (int i = 0; i < MQTTS_REACTOR_MAX_READS && client->getNetwork()->waitPacket(0); i++){
+        client->exec();
+    }
+    bool writing = (client->getNetwork()->getTxQueCount() > 0);
+    if (writing != _writing[slot]){
+        watch(slot, EPOLL_CTL_MOD, (writing ? EPOLLIN | EPOLLOUT : EPOLLIN));
+        _writing[slot] = writing;
+    }
+    if (writing){
+        _timers.stop(&_timer[slot]);
+    }
+}
+
+void MqttsReactor::run(){
+    _running = true;
+    while (_running){
+        exec(XTIMER_INFINITE);
+    }
+}
+
+void MqttsReactor::stop(){
+    _running = false;
+}
+
+uint16_t MqttsReactor::getClientCount(){
+    return _clientCnt;
+}
+
+TimerWheel* MqttsReactor::getTimerWheel(){
+    return &_timers;
+}
+
+#endif /* LINUX */
@@ -0,0 +1,91 @@
+/*
+ * MqttsReactor.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  Runs many non-blocking MqttsClients in one thread. The descriptors of
+ *  their networks are watched by epoll, and the deadlines of the clients
+ *  and of the application are kept in a TimerWheel, whose next expiry is
+ *  the timeout of epoll_wait(). A network holding output (XBee
+ *  backpressured by CTS) is also watched for EPOLLOUT. Linux only.
+ */
+
+#ifndef MQTTSREACTOR_H_
+#define MQTTSREACTOR_H_
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "MqttsClient.h"
+#include "TimerWheel.h"
+
+#ifndef MQTTS_REACTOR_MAX_CLIENTS
+  #define MQTTS_REACTOR_MAX_CLIENTS  1024
+#endif
+#define MQTTS_REACTOR_MAX_EVENTS    64
+#define MQTTS_REACTOR_MAX_FDS        4    // descriptors of a network
+#define MQTTS_REACTOR_MAX_READS     16    // messages read from a client in a pass
+#define MQTTS_REACTOR_POLL_TIME      1    // msec, for a network without descriptor
+
+/*=====================================
+        Class MqttsReactor
+ ======================================*/
+class MqttsReactor {
+public:
+    MqttsReactor();
+    ~MqttsReactor();
+
+    int  add(MqttsClient* client);
+    void remove(MqttsClient* client);
+    int  exec(uint32_t timeoutMillsec);   // one pass of the loop
+    void run();                           // run in the caller until stop()
+    void stop();
+    uint16_t getClientCount();
+    TimerWheel* getTimerWheel();          // timers of the application
+
+private:
+    static void timerHandler(TimerEntry* timer);
+    void setReady(int slot);
+    void execClient(int slot);
+    int  watch(int slot, int op, uint32_t events);
+
+    int           _epfd;
+    TimerWheel    _timers;
+    MqttsClient*  _client[MQTTS_REACTOR_MAX_CLIENTS];  // NULL if the slot is free
+    TimerEntry    _timer[MQTTS_REACTOR_MAX_CLIENTS];   // next deadline of the client
+    bool          _ready[MQTTS_REACTOR_MAX_CLIENTS];
+    bool          _writing[MQTTS_REACTOR_MAX_CLIENTS]; // EPOLLOUT is watched
+    uint16_t      _readyList[MQTTS_REACTOR_MAX_CLIENTS];
+    uint16_t      _readyCnt;
+    uint16_t      _polledList[MQTTS_REACTOR_MAX_CLIENTS]; // no descriptor to watch
+    uint16_t      _polledCnt;
+    uint16_t      _clientCnt;
+    volatile bool _running;
+};
+
+#endif /* LINUX */
+
+#endif /* MQTTSREACTOR_H_ */
@@ -0,0 +1,208 @@
+/*
+ * ShmStack.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "ShmStack.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+using namespace tomyClient;
+
+static int futex(volatile uint32_t* addr, int op, uint32_t val, const struct timespec* timeout){
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+/*===========================================
+               Class  ShmStack
+ ============================================*/
+ShmStack::ShmStack(){
+    _link = NULL;
+    _txRing = _rxRing = NULL;
+    _returnCode = PACKET_ERROR_NODATA;
+    _txDropCnt = 0;
+    _rxCallbackPtr = NULL;
+    _rxCallbackArg = NULL;
+}
+
+ShmStack::~ShmStack(){
+    close();
+}
+
+/*
+ *  name : shared memory object, ex) "/mqtts-node02". The Client and the Gateway
+ *         open the same name, whichever comes first creates it.
+ *  Returns 0, or -1.
+ */
+int ShmStack::begin(const char* name, ShmSide side){
+    close();
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    if (fd < 0){
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(ShmLink)) < 0){
+        ::close(fd);
+        return -1;
+    }
+    void* addr = mmap(NULL, sizeof(ShmLink), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED){
+        return -1;
+    }
+    _link = (ShmLink*)addr;          // new memory is zero, i.e. empty rings
+    if (_link->magic != 0 && _link->magic != SHM_MAGIC){
+        close();
+        return -1;
+    }
+    _link->magic = SHM_MAGIC;
+    _txRing = (side == ShmClient ? &_link->up : &_link->down);
+    _rxRing = (side == ShmClient ? &_link->down : &_link->up);
+    _rxRing->tail = _rxRing->head;   // discard messages of the last run
+    return 0;
+}
+
+void ShmStack::close(){
+    if (_link){
+        munmap(_link, sizeof(ShmLink));
+    }
+    _link = NULL;
+    _txRing = _rxRing = NULL;
+}
+
+/*
+ *  The link has only one peer.
+ */
+void ShmStack::setGwAddress(){
+
+}
+
+void ShmStack::setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg){
+    _rxCallbackPtr = callbackPtr;
+    _rxCallbackArg = arg;
+}
+
+uint8_t ShmStack::getMaxPayload(){
+    return SHM_SLOT_SIZE - 1;
+}
+
+/*
+ *  The futex can't be polled, a reactor checks the ring at every pass.
+ */
+uint8_t ShmStack::getFds(int* fds, uint8_t size){
+    return 0;
+}
+
+uint16_t ShmStack::getTxDropCount(){
+    return _txDropCnt;
+}
+
+/*
+ *  Unicast and broadcast both go to the peer. Returns 0, no delivery
+ *  status, or PACKET_ERROR_NOT_SENT when the ring is full.
+ */
+int ShmStack::send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type){
+    ShmRing* ring = _txRing;
+    uint32_t head = ring->head;
+    if (head - ring->tail == SHM_RING_SLOTS){
+        _txDropCnt++;
+        D_ZBSTACKW("SHM ring is full\r\n");
+        return PACKET_ERROR_NOT_SENT;
+    }
+    memcpy(ring->slot[head & (SHM_RING_SLOTS - 1)], xmitData, dataLen);
+    __sync_synchronize();            // the slot before the head
+    ring->head = head + 1;
+    __sync_fetch_and_add(&ring->seq, 1);
+    if (ring->waiting){
+        futex(&ring->seq, FUTEX_WAKE, 1, NULL);
+    }
+    return 0;
+}
+
+/*
+ *  Dispatch one message to the RX handler. It is read in place,
+ *  the slot is released after the handler returns.
+ */
+int ShmStack::readPacket(){
+    _returnCode = PACKET_ERROR_NODATA;
+    ShmRing* ring = _rxRing;
+    uint32_t tail = ring->tail;
+    if (tail == ring->head){
+        return _returnCode;
+    }
+    __sync_synchronize();            // the head before the slot
+    uint8_t* msg = ring->slot[tail & (SHM_RING_SLOTS - 1)];
+    if (msg[0] >= 2 && _rxCallbackPtr != NULL){
+        _rxResp.setApiId(ZB_API_RESPONSE);
+        _rxResp.setPayload(msg);
+        _rxResp.setPayloadLength(msg[0]);
+        _rxCallbackPtr(&_rxResp, &_returnCode, _rxCallbackArg);
+    }
+    __sync_synchronize();
+    ring->tail = tail + 1;
+    return _returnCode;
+}
+
+/*
+ *  Poll a while, then sleep on the futex until the writer bumps seq.
+ */
+bool ShmStack::waitPacket(uint32_t timeoutMillsec){
+    ShmRing* ring = _rxRing;
+    for (int i = 0; i < SHM_SPIN_COUNT; i++){
+        if (ring->tail != ring->head){
+            return true;
+        }
+    }
+    if (timeoutMillsec == 0){
+        return false;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = timeoutMillsec / 1000;
+    ts.tv_nsec = (timeoutMillsec % 1000) * 1000000;
+    uint32_t seq = ring->seq;
+    ring->waiting = 1;
+    __sync_synchronize();            // waiting before the check, against a lost wakeup
+    if (ring->tail == ring->head){
+        futex(&ring->seq, FUTEX_WAIT, seq, &ts);
+    }
+    ring->waiting = 0;
+    return ring->tail != ring->head;
+}
+
+#endif /* LINUX */
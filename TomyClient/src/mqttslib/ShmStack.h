@@ -0,0 +1,113 @@
+/*
+ * ShmStack.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  MQTT-S between processes on one host through a pair of rings in
+ *  shared memory (/dev/shm). Each ring has one writer and one reader,
+ *  and a reader sleeps on a futex. Linux only.
+ */
+
+#ifndef SHMSTACK_H_
+#define SHMSTACK_H_
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "ZBeeStack.h"
+
+#define SHM_RING_SLOTS     32    // power of 2
+#define SHM_SLOT_SIZE     256    // one MQTT-S message, Length is the first byte
+#define SHM_MAGIC  0x4d515353    // "MQSS"
+#ifndef SHM_SPIN_COUNT
+  #define SHM_SPIN_COUNT  2000    // polls before sleeping on the futex
+#endif
+
+namespace tomyClient {
+
+enum ShmSide{
+    ShmClient,
+    ShmGateway
+};
+
+/*============================================
+                ShmRing
+ ============================================*/
+struct ShmRing {
+    volatile uint32_t head;      // written by the writer only
+    uint8_t  pad0[60];
+    volatile uint32_t tail;      // written by the reader only
+    uint8_t  pad1[60];
+    volatile uint32_t seq;       // futex word, bumped on every write
+    volatile uint32_t waiting;   // reader is (about to be) asleep
+    uint8_t  pad2[56];
+    uint8_t  slot[SHM_RING_SLOTS][SHM_SLOT_SIZE];
+};
+
+struct ShmLink {
+    uint32_t magic;
+    uint8_t  pad[60];
+    ShmRing  up;                 // Client to Gateway
+    ShmRing  down;               // Gateway to Client
+};
+
+/*===========================================
+               Class  ShmStack
+ ============================================*/
+class ShmStack : public Network {
+public:
+    ShmStack();
+    ~ShmStack();
+
+    int  begin(const char* name, ShmSide side = ShmClient);
+    void close();
+    void setGwAddress();
+    void setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg);
+
+    int  send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type);
+    int  readPacket();
+    bool waitPacket(uint32_t timeoutMillsec);
+    uint8_t getMaxPayload();
+    uint8_t getFds(int* fds, uint8_t size);
+    uint16_t getTxDropCount();
+
+private:
+    ShmLink*   _link;
+    ShmRing*   _txRing;
+    ShmRing*   _rxRing;
+    ZBResponse _rxResp;
+    int        _returnCode;
+    uint16_t   _txDropCnt;
+
+    void (*_rxCallbackPtr)(ZBResponse* data, int* returnCode, void* arg);
+    void* _rxCallbackArg;
+};
+
+}
+
+#endif /* LINUX */
+
+#endif /* SHMSTACK_H_ */
@@ -0,0 +1,267 @@
+/*
+ * TimerWheel.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "TimerWheel.h"
+#include <stdio.h>
+
+using namespace tomyClient;
+
+/*============================================
+                TimerEntry
+ ============================================*/
+TimerEntry::TimerEntry(){
+    _next = _prev = NULL;
+    _expires = 0;
+    _period = 0;
+    _callbackPtr = NULL;
+    _arg = NULL;
+}
+
+void TimerEntry::setCallback(void (*callbackPtr)(TimerEntry* timer), void* arg){
+    _callbackPtr = callbackPtr;
+    _arg = arg;
+}
+
+void* TimerEntry::getArg(){
+    return _arg;
+}
+
+bool TimerEntry::isActive(){
+    return _next != NULL;
+}
+
+/*============================================
+                TimerWheel
+ ============================================*/
+TimerWheel::TimerWheel(){
+    for (int i = 0; i < TW_LEVELS; i++){
+        for (int j = 0; j < TW_SLOTS; j++){
+            _slot[i][j]._next = _slot[i][j]._prev = &_slot[i][j];
+        }
+        _bitmap[i] = 0;
+    }
+    _current = XTimer::now();
+    _count = 0;
+}
+
+TimerWheel::~TimerWheel(){
+    for (int i = 0; i < TW_LEVELS; i++){
+        for (int j = 0; j < TW_SLOTS; j++){
+            while (_slot[i][j]._next != &_slot[i][j]){
+                unlink(_slot[i][j]._next);
+            }
+        }
+    }
+}
+
+/*
+ *  (Re)start the timer, it expires after msec and then every period if not 0.
+ */
+void TimerWheel::start(TimerEntry* timer, uint32_t msec, uint32_t period){
+    if (timer->isActive()){
+        unlink(timer);
+    }
+    timer->_expires = XTimer::now() + msec;
+    timer->_period = period;
+    add(timer);
+}
+
+void TimerWheel::stop(TimerEntry* timer){
+    if (timer->isActive()){
+        unlink(timer);
+    }
+    timer->_period = 0;
+}
+
+uint32_t TimerWheel::getCount(){
+    return _count;
+}
+
+/*
+ *  Level is chosen by the distance from _current, the slot by the
+ *  bits of the expiry time of the level. Expired ones go to the current slot.
+ */
+void TimerWheel::add(TimerEntry* timer){
+    uint64_t expires = timer->_expires;
+    int level = 0;
+    int slot;
+
+    if (expires < _current){
+        expires = _current;
+    }else if (expires - _current > TW_MAX_DELTA){
+        expires = _current + TW_MAX_DELTA;     // cascaded again later
+    }
+    uint64_t delta = expires - _current;
+    while (level < TW_LEVELS - 1 && delta >= (1ULL << (TW_SLOT_BITS * (level + 1)))){
+        level++;
+    }
+    slot = (expires >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK;
+
+    TimerEntry* head = &_slot[level][slot];
+    timer->_next = head;
+    timer->_prev = head->_prev;
+    head->_prev->_next = timer;
+    head->_prev = timer;
+    _bitmap[level] |= (1ULL << slot);
+    _count++;
+}
+
+void TimerWheel::unlink(TimerEntry* timer){
+    TimerEntry* next = timer->_next;
+    timer->_prev->_next = next;
+    next->_prev = timer->_prev;
+    timer->_next = timer->_prev = NULL;
+    _count--;
+
+    /*---- clear the bit if the slot became empty ----*/
+    if (next == next->_next && next->_prev == next){
+        for (int i = 0; i < TW_LEVELS; i++){
+            if (next >= _slot[i] && next < _slot[i] + TW_SLOTS){
+                _bitmap[i] &= ~(1ULL << (next - _slot[i]));
+                break;
+            }
+        }
+    }
+}
+
+/*
+ *  Move the timers of the slot of the level down to the lower levels.
+ */
+void TimerWheel::cascade(int level){
+    int slot = (_current >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK;
+    TimerEntry* head = &_slot[level][slot];
+    while (head->_next != head){
+        TimerEntry* timer = head->_next;
+        unlink(timer);
+        add(timer);
+    }
+}
+
+int TimerWheel::runSlot(int slot){
+    TimerEntry* head = &_slot[0][slot];
+    int cnt = 0;
+    while (head->_next != head){
+        TimerEntry* timer = head->_next;
+        unlink(timer);
+        if (timer->_period){
+            timer->_expires += timer->_period;
+            add(timer);
+        }
+        if (timer->_callbackPtr){
+            timer->_callbackPtr(timer);      // may start or stop the timer
+        }
+        cnt++;
+    }
+    return cnt;
+}
+
+/*
+ *  Process the msecs up to now. Empty levels are skipped at once,
+ *  so a long sleep costs a few steps only.
+ */
+int TimerWheel::expire(){
+    uint64_t now = XTimer::now();
+    int cnt = 0;
+
+    while (_current <= now){
+        int slot = _current & TW_SLOT_MASK;
+        if (slot == 0){
+            for (int level = 1; level < TW_LEVELS; level++){
+                cascade(level);
+                if (((_current >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK) != 0){
+                    break;
+                }
+            }
+        }
+        if (_bitmap[0] & (1ULL << slot)){
+            cnt += runSlot(slot);
+        }
+
+        uint64_t step = 1;
+        for (int level = 0; level < TW_LEVELS - 1 && _bitmap[level] == 0; level++){
+            step <<= TW_SLOT_BITS;
+        }
+        uint64_t next = (_current | (step - 1)) + 1;
+        _current = (next > now + 1 ? now + 1 : next);
+    }
+    return cnt;
+}
+
+/*
+ *  Distance from the slot to the next one with the bit set.
+ */
+static int rotateCtz(uint64_t bitmap, int slot){
+    uint64_t rotated = (bitmap >> slot) | (slot ? bitmap << (TW_SLOTS - slot) : 0);
+    return __builtin_ctzll(rotated);
+}
+
+/*
+ *  The first slot with timers after the current one of each level gives
+ *  the deadline. On the upper levels it is the time of the cascade,
+ *  which is not later than the timers in the slot.
+ */
+uint32_t TimerWheel::getNextTimeout(){
+    if (_count == 0){
+        return XTIMER_INFINITE;
+    }
+    uint64_t deadline = 0xffffffffffffffffULL;
+    for (int level = 0; level < TW_LEVELS; level++){
+        if (_bitmap[level] == 0){
+            continue;
+        }
+        int shift = TW_SLOT_BITS * level;
+        int cur = (_current >> shift) & TW_SLOT_MASK;
+        uint64_t tm;
+        if (level == 0){
+            tm = _current + rotateCtz(_bitmap[0], cur);
+        }else{
+            int dist;
+            if ((_current & ((1ULL << shift) - 1)) == 0 && (_bitmap[level] & (1ULL << cur))){
+                dist = 0;                    // cascaded at _current
+            }else{
+                dist = rotateCtz(_bitmap[level], (cur + 1) & TW_SLOT_MASK) + 1;
+            }
+            tm = (((_current >> shift) + dist) << shift);
+        }
+        if (tm < deadline){
+            deadline = tm;
+        }
+    }
+    uint64_t now = XTimer::now();
+    if (deadline <= now){
+        return 0;
+    }
+    return (deadline - now > 0xfffffffe ? 0xfffffffe : (uint32_t)(deadline - now));
+}
+
+#endif /* LINUX */
@@ -0,0 +1,104 @@
+/*
+ * TimerWheel.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  Hierarchical timer wheel on CLOCK_MONOTONIC (msec). Starting and stopping
+ *  a timer is O(1), and the next deadline is found from the slot bit maps,
+ *  so the cost doesn't grow with the number of timers. Linux only.
+ */
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "ZBeeStack.h"
+
+#define TW_LEVELS        4
+#define TW_SLOT_BITS     6
+#define TW_SLOTS        (1 << TW_SLOT_BITS)     // 64 slots of a level
+#define TW_SLOT_MASK    (TW_SLOTS - 1)
+#define TW_MAX_DELTA    ((1ULL << (TW_SLOT_BITS * TW_LEVELS)) - 1)  // about 4.6 hours
+
+namespace tomyClient {
+
+class TimerWheel;
+
+/*============================================
+                TimerEntry
+ ============================================*/
+/*
+ *  A timer is owned by the user and linked into the wheel while it runs.
+ */
+class TimerEntry {
+public:
+    TimerEntry();
+    void setCallback(void (*callbackPtr)(TimerEntry* timer), void* arg);
+    void* getArg();
+    bool isActive();
+private:
+    friend class TimerWheel;
+    TimerEntry* _next;
+    TimerEntry* _prev;
+    uint64_t    _expires;         // msec of CLOCK_MONOTONIC
+    uint32_t    _period;          // 0 for one shot
+    void (*_callbackPtr)(TimerEntry* timer);
+    void*       _arg;
+};
+
+/*============================================
+                TimerWheel
+ ============================================*/
+class TimerWheel {
+public:
+    TimerWheel();
+    ~TimerWheel();
+
+    void start(TimerEntry* timer, uint32_t msec, uint32_t period = 0);
+    void stop(TimerEntry* timer);
+    int  expire();                    // run the callbacks of the expired timers
+    uint32_t getNextTimeout();        // msec, XTIMER_INFINITE if no timer runs
+    uint32_t getCount();
+
+private:
+    void add(TimerEntry* timer);
+    void unlink(TimerEntry* timer);
+    void cascade(int level);
+    int  runSlot(int slot);
+
+    TimerEntry _slot[TW_LEVELS][TW_SLOTS];   // list heads
+    uint64_t   _bitmap[TW_LEVELS];           // slots with timers
+    uint64_t   _current;                     // next msec to be processed
+    uint32_t   _count;
+};
+
+}
+
+#endif /* LINUX */
+
+#endif /* TIMERWHEEL_H_ */
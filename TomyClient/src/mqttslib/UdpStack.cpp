@@ -0,0 +1,230 @@
+/*
+ * UdpStack.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "UdpStack.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace tomyClient;
+
+/*===========================================
+               Class  UdpStack
+ ============================================*/
+UdpStack::UdpStack(){
+    _sockfd = _bcastfd = -1;
+    memset(&_gwAddr, 0, sizeof(_gwAddr));
+    memset(&_bcastAddr, 0, sizeof(_bcastAddr));
+    memset(&_rxAddr, 0, sizeof(_rxAddr));
+    _returnCode = PACKET_ERROR_NODATA;
+    _rxCallbackPtr = NULL;
+    _rxCallbackArg = NULL;
+}
+
+UdpStack::~UdpStack(){
+    close();
+}
+
+/*
+ *  port : local port for the Gateway, 0 for any.
+ *  bcastAddr, bcastPort : where SEARCHGW is sent and GWINFO, ADVERTISE are received.
+ *         A multicast address (224.0.0.0/4) is joined, otherwise it is a broadcast address.
+ *  Returns 0, or -1.
+ */
+int UdpStack::begin(uint16_t port, const char* bcastAddr, uint16_t bcastPort){
+    struct sockaddr_in addr;
+    int on = 1;
+
+    close();
+    _bcastAddr.sin_family = AF_INET;
+    _bcastAddr.sin_port = htons(bcastPort);
+    if (inet_aton(bcastAddr, &_bcastAddr.sin_addr) == 0){
+        return -1;
+    }
+    bool multicast = IN_MULTICAST(ntohl(_bcastAddr.sin_addr.s_addr));
+
+    _sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    _bcastfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_sockfd < 0 || _bcastfd < 0){
+        close();
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        close();
+        return -1;
+    }
+
+    if (multicast){
+        uint8_t loop = 1;        // Gateway may be on this host
+        uint8_t ttl = 1;
+        setsockopt(_sockfd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        setsockopt(_sockfd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }else{
+        setsockopt(_sockfd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    }
+
+    /*---- Several clients on a host share the port ----*/
+    setsockopt(_bcastfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    addr.sin_port = htons(bcastPort);
+    if (multicast){
+        addr.sin_addr = _bcastAddr.sin_addr;
+    }
+    if (bind(_bcastfd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        close();
+        return -1;
+    }
+    if (multicast){
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = _bcastAddr.sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(_bcastfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0){
+            close();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void UdpStack::close(){
+    if (_sockfd >= 0){
+        ::close(_sockfd);
+    }
+    if (_bcastfd >= 0){
+        ::close(_bcastfd);
+    }
+    _sockfd = _bcastfd = -1;
+}
+
+/*
+ *  Gateway known in advance. Otherwise it is the sender of GWINFO.
+ */
+int UdpStack::setGwAddress(const char* addr, uint16_t port){
+    _gwAddr.sin_family = AF_INET;
+    _gwAddr.sin_port = htons(port);
+    return inet_aton(addr, &_gwAddr.sin_addr) ? 0 : -1;
+}
+
+void UdpStack::setGwAddress(){
+    _gwAddr = _rxAddr;
+}
+
+void UdpStack::setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg){
+    _rxCallbackPtr = callbackPtr;
+    _rxCallbackArg = arg;
+}
+
+struct sockaddr_in& UdpStack::getRxRemoteAddress(){
+    return _rxAddr;
+}
+
+uint8_t UdpStack::getMaxPayload(){
+    return UDP_MAX_PAYLOAD;
+}
+
+uint8_t UdpStack::getFds(int* fds, uint8_t size){
+    uint8_t cnt = 0;
+    if (_sockfd >= 0 && cnt < size){
+        fds[cnt++] = _sockfd;
+    }
+    if (_bcastfd >= 0 && cnt < size){
+        fds[cnt++] = _bcastfd;
+    }
+    return cnt;
+}
+
+/*
+ *  No delivery status on UDP, so the frame ID is always 0.
+ */
+int UdpStack::send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type){
+    struct sockaddr_in* dest = (type == BcastReq ? &_bcastAddr : &_gwAddr);
+    if (dest->sin_family != AF_INET){
+        D_ZBSTACKW("UDP Gateway address is not set\r\n");
+        return PACKET_ERROR_NOT_SENT;
+    }
+    if (sendto(_sockfd, xmitData, dataLen, 0, (struct sockaddr*)dest, sizeof(struct sockaddr_in)) < 0){
+        D_ZBSTACKF("UDP sendto error %d\r\n", errno);
+        return PACKET_ERROR_NOT_SENT;
+    }
+    return 0;
+}
+
+/*
+ *  Dispatch one received message to the RX handler.
+ */
+int UdpStack::readPacket(){
+    _returnCode = PACKET_ERROR_NODATA;
+    if (recv(_sockfd) > 0 || recv(_bcastfd) > 0){
+        if (_rxCallbackPtr != NULL){
+            _rxCallbackPtr(&_rxResp, &_returnCode, _rxCallbackArg);
+        }
+    }
+    return _returnCode;
+}
+
+bool UdpStack::waitPacket(uint32_t timeoutMillsec){
+    struct pollfd fds[2];
+    fds[0].fd = _sockfd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _bcastfd;
+    fds[1].events = POLLIN;
+    return poll(fds, 2, timeoutMillsec) > 0;
+}
+
+/*
+ *  Read a datagram without blocking. A datagram whose length differs
+ *  from the Length field of the message is dropped.
+ */
+int UdpStack::recv(int sockfd){
+    socklen_t addrLen = sizeof(_rxAddr);
+    int len = recvfrom(sockfd, _rxBuf, UDP_MAX_PAYLOAD, MSG_DONTWAIT,
+                       (struct sockaddr*)&_rxAddr, &addrLen);
+    if (len < 2 || _rxBuf[0] != len){
+        return 0;
+    }
+    _rxResp.setApiId(ZB_API_RESPONSE);
+    _rxResp.setPayload(_rxBuf);
+    _rxResp.setPayloadLength(len);
+    _rxResp.setOption(sockfd == _bcastfd ? ZB_BROADCAST_PACKET : 0);
+    return len;
+}
+
+#endif /* LINUX */
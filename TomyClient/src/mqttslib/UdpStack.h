@@ -0,0 +1,89 @@
+/*
+ * UdpStack.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  MQTT-S over UDP. SEARCHGW is sent to a broadcast or multicast address,
+ *  where GWINFO and ADVERTISE are received. Linux only.
+ */
+
+#ifndef UDPSTACK_H_
+#define UDPSTACK_H_
+
+#include "MQTTS_Defines.h"
+
+#ifdef LINUX
+
+#include "ZBeeStack.h"
+#include <netinet/in.h>
+
+#define UDP_MAX_PAYLOAD   255    // Length of MQTT-S message is one byte
+
+namespace tomyClient {
+
+/*===========================================
+               Class  UdpStack
+ ============================================*/
+class UdpStack : public Network {
+public:
+    UdpStack();
+    ~UdpStack();
+
+    int  begin(uint16_t port, const char* bcastAddr, uint16_t bcastPort);
+    void close();
+    int  setGwAddress(const char* addr, uint16_t port);
+    void setGwAddress();
+    void setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg);
+
+    int  send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type);
+    int  readPacket();
+    bool waitPacket(uint32_t timeoutMillsec);
+    uint8_t getMaxPayload();
+    uint8_t getFds(int* fds, uint8_t size);
+
+    struct sockaddr_in& getRxRemoteAddress();
+
+private:
+    int  recv(int sockfd);
+
+    int  _sockfd;                    // unicast to/from the Gateway
+    int  _bcastfd;                   // GWINFO and ADVERTISE
+    struct sockaddr_in _gwAddr;
+    struct sockaddr_in _bcastAddr;
+    struct sockaddr_in _rxAddr;      // sender of the message being handled
+
+    ZBResponse _rxResp;
+    uint8_t    _rxBuf[UDP_MAX_PAYLOAD];
+    int        _returnCode;
+
+    void (*_rxCallbackPtr)(ZBResponse* data, int* returnCode, void* arg);
+    void* _rxCallbackArg;
+};
+
+}
+
+#endif /* LINUX */
+
+#endif /* UDPSTACK_H_ */
@@ -58,6 +58,7 @@
         #include "ZBeeStack.h"
         #include <stdio.h>
         #include <sys/time.h>
+        #include <time.h>
         #include <sys/types.h>
         #include <sys/stat.h>
         #include <unistd.h>
@@ -66,9 +67,38 @@
         #include <fcntl.h>
         #include <errno.h>
         #include <termios.h>
-
+        #include <sys/uio.h>
+        #include <sys/ioctl.h>
+        #include <poll.h>
+        #include <linux/serial.h>
+
+        #ifdef __SSE2__
+            #include <emmintrin.h>
+            #define ZB_SCAN_SSE2
+        #endif
 #endif /* LINUX */
 
+#if defined(LINUX) && defined(TCGETS2)
+    /*  <asm/termbits.h> conflicts with <termios.h>, kernel layout  */
+    #ifndef BOTHER
+        #define BOTHER  0010000
+    #endif
+    struct termios2 {
+        unsigned int  c_iflag;
+        unsigned int  c_oflag;
+        unsigned int  c_cflag;
+        unsigned int  c_lflag;
+        unsigned char c_line;
+        unsigned char c_cc[19];
+        unsigned int  c_ispeed;
+        unsigned int  c_ospeed;
+    };
+#endif
+
+#if !defined(ZB_SCAN_SSE2) && !defined(ARDUINO)
+    #define ZB_SCAN_WORD       // 8bit AVR gains nothing from word access
+#endif
+
 using namespace std;
 using namespace tomyClient;
 
@@ -86,6 +116,227 @@ void setUint16(uint8_t* pos, uint16_t val){
     *pos = val &0xff;
 }
 
+uint32_t getUint32(uint8_t* pos){
+    return ((uint32_t)pos[0] << 24) + ((uint32_t)pos[1] << 16) +
+           ((uint32_t)pos[2] <<  8) + pos[3];
+}
+
+/*=====================================
+      Escape & Checksum kernels
+ ======================================*/
+#ifdef ZB_SCAN_WORD
+typedef unsigned long zbword_t;
+#define ZB_WORD_ONES      (~(zbword_t)0 / 0xff)
+#define ZB_WORD_HIGHS     (ZB_WORD_ONES * 0x80)
+#define ZB_WORD_LANES     (~(zbword_t)0 / 0xffff * 0xff)
+#define ZB_WORD_HASZERO(v) (((v) - ZB_WORD_ONES) & ~(v) & ZB_WORD_HIGHS)
+
+static uint8_t foldLanes(zbword_t lanes){
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < sizeof(zbword_t); i += 2){
+        sum += (lanes >> (i * 8)) & 0xff;
+    }
+    return sum;
+}
+#endif
+
+#define ZB_SCAN_MIN  16    // clean run which keeps the wide probe worth it
+
+static bool isEscapeTarget(uint8_t b, bool tx){
+    return b == START_BYTE || b == ESCAPE || (tx && (b == XON || b == XOFF));
+}
+
+/*
+ *  Copy src to dst up to the first byte which must be escaped and
+ *  add the copied bytes to *checksum. XON/XOFF count only for tx.
+ *  Escape-free runs are handled 16 (SSE2) or sizeof(long) bytes at a time.
+ */
+static uint16_t copyCleanRun(uint8_t* dst, const uint8_t* src, uint16_t len, uint8_t* checksum, bool tx){
+    uint16_t i = 0;
+    uint8_t sum = *checksum;
+
+#if defined(ZB_SCAN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i start = _mm_set1_epi8((char)START_BYTE);
+    const __m128i esc = _mm_set1_epi8((char)ESCAPE);
+    const __m128i xonMask = _mm_set1_epi8((char)0xfd);   // XON 0x11 | XOFF 0x13
+    const __m128i xon = _mm_set1_epi8((char)XON);
+    __m128i acc = zero;
+    while (i + 16 <= len){
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, start), _mm_cmpeq_epi8(v, esc));
+        if (tx){
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_and_si128(v, xonMask), xon));
+        }
+        if (_mm_movemask_epi8(hit)){
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        i += 16;
+    }
+    sum += (uint8_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+
+#elif defined(ZB_SCAN_WORD)
+    zbword_t lanes = 0;
+    uint8_t cnt = 0;
+    while (i + sizeof(zbword_t) <= len){
+        zbword_t w;
+        memcpy(&w, src + i, sizeof(zbword_t));
+        zbword_t hit = ZB_WORD_HASZERO(w ^ (ZB_WORD_ONES * START_BYTE)) |
+                       ZB_WORD_HASZERO(w ^ (ZB_WORD_ONES * ESCAPE));
+        if (tx){
+            hit |= ZB_WORD_HASZERO((w & (ZB_WORD_ONES * 0xfd)) ^ (ZB_WORD_ONES * XON));
+        }
+        if (hit){
+            break;
+        }
+        memcpy(dst + i, &w, sizeof(zbword_t));
+        lanes += (w & ZB_WORD_LANES) + ((w >> 8) & ZB_WORD_LANES);
+        if (++cnt == 128){         // keep 16bit lanes from overflowing
+            sum += foldLanes(lanes);
+            lanes = 0;
+            cnt = 0;
+        }
+        i += sizeof(zbword_t);
+    }
+    sum += foldLanes(lanes);
+#endif
+
+    while (i < len && !isEscapeTarget(src[i], tx)){
+        dst[i] = src[i];
+        sum += src[i];
+        i++;
+    }
+    *checksum = sum;
+    return i;
+}
+
+/*
+ *  Escape src into dst (dst needs 2 * len bytes) and add the raw
+ *  bytes to *checksum. Returns the escaped length.
+ *  After a clean run shorter than ZB_SCAN_MIN the wide probe would
+ *  mostly fail, so the next ZB_SCAN_MIN bytes go through a byte loop,
+ *  and so on while they still hold an escaped byte.
+ */
+uint16_t tomyClient::zbEscape(uint8_t* dst, const uint8_t* src, uint16_t len, uint8_t* checksum){
+    uint16_t i = 0;
+    uint16_t pos = 0;
+    uint8_t sum = *checksum;
+    bool dense = false;
+    while (i < len){
+        if (dense){
+            uint16_t end = (len - i < ZB_SCAN_MIN ? len : i + ZB_SCAN_MIN);
+            dense = false;
+            for (; i < end; i++){
+                uint8_t b = src[i];
+                sum += b;
+                if (isEscapeTarget(b, true)){
+                    dst[pos++] = ESCAPE;
+                    dst[pos++] = b ^ 0x20;
+                    dense = true;
+                }else{
+                    dst[pos++] = b;
+                }
+            }
+            continue;
+        }
+        uint16_t run = copyCleanRun(dst + pos, src + i, len - i, &sum, true);
+        i += run;
+        pos += run;
+        if (i < len){
+            sum += src[i];
+            dst[pos++] = ESCAPE;
+            dst[pos++] = src[i++] ^ 0x20;
+        }
+        dense = (run < ZB_SCAN_MIN);
+    }
+    *checksum = sum;
+    return pos;
+}
+
+/*
+ *  Unescape src into dst and add the decoded bytes to *checksum.
+ *  Stops when dst is full, src is used up or a Start byte is found,
+ *  which is left unconsumed. *escape carries a trailing ESCAPE over
+ *  to the next call. Returns the decoded length.
+ *  Escape-dense input goes through a byte loop as in zbEscape.
+ */
+uint16_t tomyClient::zbUnescape(uint8_t* dst, uint16_t dstLen, const uint8_t* src, uint16_t srcLen,
+                                uint16_t* srcUsed, bool* escape, uint8_t* checksum){
+    uint16_t i = 0;
+    uint16_t pos = 0;
+    uint8_t sum = *checksum;
+    bool esc = *escape;
+    bool dense = false;
+    while (pos < dstLen && i < srcLen){
+        if (esc){
+            if (src[i] == START_BYTE){
+                break;
+            }
+            dst[pos] = src[i++] ^ 0x20;
+            sum += dst[pos++];
+            esc = false;
+            continue;
+        }
+        if (dense){
+            uint16_t end = srcLen - 1;              // an ESCAPE is followed by its byte
+            if (end - i > ZB_SCAN_MIN){
+                end = i + ZB_SCAN_MIN;
+            }
+            if (end - i > dstLen - pos){
+                end = i + dstLen - pos;
+            }
+            dense = false;
+            while (i < end){
+                uint8_t b = src[i];
+                if (b == ESCAPE){
+                    if (src[i + 1] == START_BYTE){
+                        break;
+                    }
+                    b = src[++i] ^ 0x20;
+                    dense = true;
+                }else if (b == START_BYTE){
+                    break;
+                }
+                i++;
+                sum += b;
+                dst[pos++] = b;
+            }
+            if (i < end){
+                if (src[i] == START_BYTE){
+                    break;
+                }
+                esc = true;       // ESCAPE before a Start byte
+                i++;
+            }
+            continue;
+        }
+        uint16_t run = copyCleanRun(dst + pos, src + i, (dstLen - pos < srcLen - i ? dstLen - pos : srcLen - i),
+                                    &sum, false);
+        i += run;
+        pos += run;
+        if (pos == dstLen || i == srcLen || src[i] == START_BYTE){
+            break;
+        }
+        esc = true;               // ESCAPE
+        i++;
+        dense = (run < ZB_SCAN_MIN);
+    }
+    *srcUsed = i;
+    *escape = esc;
+    *checksum = sum;
+    return pos;
+}
+
+uint8_t tomyClient::zbChecksum(const uint8_t* buf, uint16_t len){
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < len; i++){
+        sum += buf[i];
+    }
+    return sum;
+}
+
 long getLong(uint8_t* pos){
     long val = (uint32_t(*(pos + 3)) << 24) +
         (uint32_t(*(pos + 2)) << 16) +
@@ -136,6 +387,18 @@ bool XTimer::isTimeUp(uint32_t msec){
     }
 }
 
+uint32_t XTimer::getRemain(){
+    return getRemain(_millis);
+}
+
+uint32_t XTimer::getRemain(uint32_t msec){
+    if (_startTime == 0){
+        return XTIMER_INFINITE;
+    }
+    uint32_t elapse = millis() - _startTime;
+    return (elapse > msec ? 0 : msec - elapse + 1);
+}
+
 void XTimer::stop(){
     _startTime = 0;
     _millis = 0;
@@ -163,6 +426,15 @@ bool XTimer::isTimeUp(uint32_t msec){
     return _timer.read_ms() > msec;
 }
 
+uint32_t XTimer::getRemain(){
+    return getRemain(_millis);
+}
+
+uint32_t XTimer::getRemain(uint32_t msec){
+    uint32_t elapse = _timer.read_ms();
+    return (elapse > msec ? 0 : msec - elapse + 1);
+}
+
 void XTimer::stop(){
     _timer.stop();
     _millis = 0;
@@ -172,13 +444,20 @@ void XTimer::stop(){
 #ifdef LINUX
 /**
  *   for LINUX
+ *   CLOCK_MONOTONIC doesn't jump when the wall clock is set.
  */
 XTimer::XTimer(){
   stop();
 }
 
+uint64_t XTimer::now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 void XTimer::start(uint32_t msec){
-  gettimeofday(&_startTime, NULL);
+  _startTime = now();
   _millis = msec;
 }
 
@@ -187,20 +466,26 @@ bool XTimer::isTimeUp(){
 }
 
 bool XTimer::isTimeUp(uint32_t msec){
-    struct timeval curTime;
-    long secs, usecs;
-    if (_startTime.tv_sec == 0){
+    if (_startTime == 0){
         return false;
-    }else{
-        gettimeofday(&curTime, NULL);
-        secs  = (curTime.tv_sec  - _startTime.tv_sec) * 1000;
-        usecs = (curTime.tv_usec - _startTime.tv_usec) / 1000.0;
-        return ((secs + usecs) > (long)msec);
     }
+    return (now() - _startTime > msec);
+}
+
+uint32_t XTimer::getRemain(){
+  return getRemain(_millis);
+}
+
+uint32_t XTimer::getRemain(uint32_t msec){
+    if (_startTime == 0){
+        return XTIMER_INFINITE;
+    }
+    uint64_t elapse = now() - _startTime;
+    return (elapse > msec ? 0 : msec - elapse + 1);
 }
 
 void XTimer::stop(){
-  _startTime.tv_sec = 0;
+  _startTime = 0;
   _millis = 0;
 }
 
@@ -215,11 +500,23 @@ void XTimer::stop(){
  */
 SerialPort::SerialPort(){
   _serialDev = NULL;
+  _baudrate = 0;
 }
 
 void SerialPort::begin(long baudrate){
   Serial.begin(baudrate);
   _serialDev = (Stream*) &Serial;
+  _baudrate = baudrate;
+}
+
+void SerialPort::setBaudrate(long baudrate){
+  Serial.flush();
+  Serial.begin(baudrate);
+  _baudrate = baudrate;
+}
+
+long SerialPort::getBaudrate(){
+  return _baudrate;
 }
 
 bool SerialPort::checkRecvBuf(){
@@ -236,6 +533,10 @@ bool SerialPort::send(unsigned char b){
   }
 }
 
+bool SerialPort::send(const uint8_t* buf, uint8_t len){
+  return _serialDev->write(buf, len) == len;
+}
+
 bool SerialPort::recv(unsigned char* buf){
     if ( _serialDev->available() > 0 ){
         buf[0] = _serialDev->read();
@@ -262,6 +563,7 @@ void SerialPort::flush(void){
 SerialPort::SerialPort(){
   _serialDev = new Serial(ZB_MBED_SERIAL_TXPIN, ZB_MBED_SERIAL_RXPIN);
   _head = _tail = 0;
+  _baudrate = 0;
 }
 
 void SerialPort::setBuff(void){
@@ -279,6 +581,16 @@ void SerialPort::begin(long baudrate){
   _serialDev->baud(baudrate);
   _serialDev->format(8,Serial::None,1);
   _serialDev->attach(this, &SerialPort::setBuff,Serial::RxIrq);
+  _baudrate = baudrate;
+}
+
+void SerialPort::setBaudrate(long baudrate){
+  _serialDev->baud(baudrate);
+  _baudrate = baudrate;
+}
+
+long SerialPort::getBaudrate(){
+  return _baudrate;
 }
 
 bool SerialPort::checkRecvBuf(){
@@ -291,6 +603,13 @@ bool SerialPort::send(unsigned char b){
       return true;
 }
 
+bool SerialPort::send(const uint8_t* buf, uint8_t len){
+  for (uint8_t i = 0; i < len; i++){
+      _serialDev->putc(buf[i]);
+  }
+  return true;
+}
+
 
 bool SerialPort::recv(unsigned char* buf){
     if(_head != _tail){
@@ -316,6 +635,7 @@ void SerialPort::flush(void){
 #ifdef LINUX
 
 SerialPort::SerialPort(){
+    memset(&_tio, 0, sizeof(_tio));    // raw mode, no ICANON left over
     _tio.c_iflag = IGNBRK | IGNPAR;
 #ifdef XBEE_FLOWCTRL_CRTSCTS
     _tio.c_cflag = CS8 | CLOCAL | CREAD | CRTSCTS;
@@ -326,6 +646,9 @@ SerialPort::SerialPort(){
     _tio.c_cc[VTIME] = 0;
     _tio.c_cc[VMIN] = 0;
     _fd = 0;
+    _baudrate = 0;
+    _rxHead = _rxTail = _rxCnt = 0;
+    _txHead = _txTail = _txCnt = 0;
 }
 
 SerialPort::~SerialPort(){
@@ -348,7 +671,7 @@ int SerialPort::begin(const char* devName, unsigned int boaurate, bool parity){
 }
 
 int SerialPort::begin(const char* devName, unsigned int boaurate,  bool parity, unsigned int stopbit){
-  _fd = open(devName, O_RDWR | O_NOCTTY);
+  _fd = open(devName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if(_fd < 0){
       return _fd;
   }
@@ -359,48 +682,344 @@ int SerialPort::begin(const char* devName, unsigned int boaurate,  bool parity,
   if (stopbit == 2){
       _tio.c_cflag = _tio.c_cflag | CSTOPB ;
   }
-  switch(boaurate){
+  int rc = setSpeed(boaurate, TCSANOW);
+#ifdef XBEE_LOW_LATENCY
+  if (rc == 0){
+      setLowLatency(true);     // not supported by every driver
+  }
+#endif
+  return rc;
+}
+
+/*
+ *  Change the speed after the pending output is sent.
+ *  This waits for a radio holding CTS, so call it at the setup only.
+ */
+int SerialPort::setBaudrate(unsigned int baudrate){
+  struct pollfd pfd;
+  pfd.fd = _fd;
+  pfd.events = POLLOUT;
+  while (sendPending() > 0){
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR){
+          break;
+      }
+  }
+  return setSpeed(baudrate, TCSADRAIN);
+}
+
+unsigned int SerialPort::getBaudrate(){
+  return _baudrate;
+}
+
+/*
+ *  baudrate is any Bxxx constant of the C library, or a rate in bps set
+ *  through termios2. The constants are below 16 or 0010001 to 0010017,
+ *  rates which no serial port uses.
+ */
+int SerialPort::setSpeed(unsigned int baudrate, int action){
+  switch(baudrate){
+    case B0:
+      return -1;         // hangs up the line
+    case B50:
+    case B75:
+    case B110:
+    case B134:
+    case B150:
+    case B200:
+    case B300:
+    case B600:
+    case B1200:
+    case B1800:
+    case B2400:
+    case B4800:
     case B9600:
     case B19200:
     case B38400:
     case B57600:
     case B115200:
-      if( cfsetspeed(&_tio, boaurate)<0){
+#ifdef B230400
+    case B230400:
+#endif
+#ifdef B460800
+    case B460800:
+#endif
+#ifdef B500000
+    case B500000:
+#endif
+#ifdef B576000
+    case B576000:
+#endif
+#ifdef B921600
+    case B921600:
+#endif
+#ifdef B1000000
+    case B1000000:
+#endif
+#ifdef B1152000
+    case B1152000:
+#endif
+#ifdef B1500000
+    case B1500000:
+#endif
+#ifdef B2000000
+    case B2000000:
+#endif
+#ifdef B2500000
+    case B2500000:
+#endif
+#ifdef B3000000
+    case B3000000:
+#endif
+#ifdef B3500000
+    case B3500000:
+#endif
+#ifdef B4000000
+    case B4000000:
+#endif
+      if( cfsetspeed(&_tio, baudrate)<0){
         return errno;
       }
-      break;
+      if (tcsetattr(_fd, action, &_tio) < 0){
+        return -1;
+      }
+      _baudrate = baudrate;
+      return 0;
     default:
+#ifdef TCGETS2
+      {
+        struct termios2 tio2;
+        if (tcsetattr(_fd, action, &_tio) < 0 || ioctl(_fd, TCGETS2, &tio2) < 0){
+            return -1;
+        }
+        tio2.c_cflag &= ~CBAUD;
+        tio2.c_cflag |= BOTHER;
+        tio2.c_ispeed = tio2.c_ospeed = baudrate;
+        if (ioctl(_fd, TCSETS2, &tio2) < 0){
+            return -1;
+        }
+        _baudrate = baudrate;
+        return tcgetattr(_fd, &_tio);    // BOTHER into _tio, flush() sets it again
+      }
+#else
       return -1;
+#endif
   }
-    return tcsetattr(_fd, TCSANOW, &_tio);
+}
+
+/*
+ *  ASYNC_LOW_LATENCY makes USB serial drivers (FTDI) deliver received
+ *  data at once instead of after their 16ms latency timer.
+ */
+int SerialPort::setLowLatency(bool on){
+  struct serial_struct serial;
+  if (ioctl(_fd, TIOCGSERIAL, &serial) < 0){
+      return -1;
+  }
+  if (on){
+      serial.flags |= ASYNC_LOW_LATENCY;
+  }else{
+      serial.flags &= ~ASYNC_LOW_LATENCY;
+  }
+  return ioctl(_fd, TIOCSSERIAL, &serial);
 }
 
 bool SerialPort::checkRecvBuf(){
-    return true;
+    if (_rxCnt == 0){
+        fillRecvBuf();
+    }
+    return _rxCnt > 0;
 }
 
 bool SerialPort::send(unsigned char b){
-  if (write(_fd, &b,1) != 1){
+  return send(&b, 1);
+}
+
+/*
+ *  Send a whole frame with one write(). What the port doesn't accept
+ *  (the radio drops CTS) is queued and written by sendPending(),
+ *  so the caller never blocks. The frame is dropped if the queue is full.
+ */
+bool SerialPort::send(const uint8_t* buf, uint8_t len){
+  if (len > SERIAL_SEND_BUFFER_SIZE - _txCnt){
       return false;
-  }else{
-      D_ZBSTACKF( " 0x%x", b);
-      return true;
   }
+  int pos = 0;
+  if (_txCnt == 0){
+      while ((pos = write(_fd, buf, len)) < 0 && errno == EINTR);
+      if (pos < 0){
+          if (errno != EAGAIN && errno != EWOULDBLOCK){
+              return false;
+          }
+          pos = 0;
+      }
+  }
+  for (int i = 0; i < len; i++){
+      D_ZBSTACKF( " 0x%x", buf[i]);
+  }
+  while (pos < len){
+      int seg = SERIAL_SEND_BUFFER_SIZE - _txHead;
+      if (seg > len - pos){
+          seg = len - pos;
+      }
+      memcpy(_txBuf + _txHead, buf + pos, seg);
+      _txHead = (_txHead + seg) % SERIAL_SEND_BUFFER_SIZE;
+      _txCnt += seg;
+      pos += seg;
+  }
+  return true;
 }
 
-bool SerialPort::recv(unsigned char* buf){
-  if(read(_fd, buf, 1) == 0){
-      return false;
-  }else{
-      D_ZBSTACKF( " 0x%x",*buf );
-      return true;
+/*
+ *  Write the queued bytes as far as the port accepts them.
+ *  Returns the bytes still queued.
+ */
+int SerialPort::sendPending(){
+  while (_txCnt > 0){
+      int seg = SERIAL_SEND_BUFFER_SIZE - _txTail;
+      if (seg > _txCnt){
+          seg = _txCnt;
+      }
+      int n = write(_fd, _txBuf + _txTail, seg);
+      if (n < 0){
+          if (errno == EINTR){
+              continue;
+          }
+          break;
+      }
+      _txTail = (_txTail + n) % SERIAL_SEND_BUFFER_SIZE;
+      _txCnt -= n;
+      if (n < seg){
+          break;
+      }
+  }
+  if (_txCnt == 0){
+      _txHead = _txTail = 0;
   }
+  return _txCnt;
+}
+
+int SerialPort::getPendingCount(){
+  return _txCnt;
+}
+
+bool SerialPort::recv(unsigned char* buf){
+    if (_rxCnt == 0 && fillRecvBuf() <= 0){
+        return false;
+    }
+    *buf = _rxBuf[_rxTail];
+    if (++_rxTail == SERIAL_RECV_BUFFER_SIZE){
+        _rxTail = 0;
+    }
+    _rxCnt--;
+    D_ZBSTACKF( " 0x%x",*buf );
+    return true;
+}
+
+/*
+ *  Copy up to len bytes out of the receive buffer.
+ *  read() is issued only when the buffer is empty.
+ */
+int SerialPort::recv(uint8_t* buf, int len){
+    if (_rxCnt == 0 && fillRecvBuf() <= 0){
+        return 0;
+    }
+    int cnt = (len < _rxCnt ? len : _rxCnt);
+    int seg = SERIAL_RECV_BUFFER_SIZE - _rxTail;
+    if (cnt <= seg){
+        memcpy(buf, _rxBuf + _rxTail, cnt);
+    }else{
+        memcpy(buf, _rxBuf + _rxTail, seg);
+        memcpy(buf + seg, _rxBuf, cnt - seg);
+    }
+    _rxTail = (_rxTail + cnt) % SERIAL_RECV_BUFFER_SIZE;
+    _rxCnt -= cnt;
+    return cnt;
+}
+
+/*
+ *  Block in poll() until data arrives or the timeout expires.
+ *  Queued output is written meanwhile, and returns false when the port
+ *  becomes writable, the caller waits again.
+ */
+bool SerialPort::waitRecv(uint32_t timeoutMillsec){
+    if (_rxCnt > 0){
+        return true;
+    }
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = (_txCnt > 0 ? POLLIN | POLLOUT : POLLIN);
+    pfd.revents = 0;
+    int timeout = (timeoutMillsec > 0x7fffffff ? -1 : (int)timeoutMillsec);
+    if (poll(&pfd, 1, timeout) <= 0){
+        return false;
+    }
+    if (pfd.revents & POLLOUT){
+        sendPending();
+    }
+    return (pfd.revents & POLLIN) != 0;
+}
+
+/*
+ *  Return the contiguous part of the received data without copying.
+ *  The caller releases what it has used with skip().
+ */
+int SerialPort::peek(uint8_t** buf){
+    if (_rxCnt == 0 && fillRecvBuf() <= 0){
+        return 0;
+    }
+    *buf = _rxBuf + _rxTail;
+    int seg = SERIAL_RECV_BUFFER_SIZE - _rxTail;
+    return (_rxCnt < seg ? _rxCnt : seg);
+}
+
+void SerialPort::skip(int len){
+    _rxTail = (_rxTail + len) % SERIAL_RECV_BUFFER_SIZE;
+    _rxCnt -= len;
+}
+
+/*
+ *  Fill all free space of the ring buffer with one readv().
+ *  VMIN = VTIME = 0, so the call never blocks.
+ */
+int SerialPort::fillRecvBuf(){
+    if (_rxCnt == 0){
+        _rxHead = _rxTail = 0;
+    }
+    struct iovec iov[2];
+    int iovCnt = 1;
+    if (_rxHead >= _rxTail && _rxCnt < SERIAL_RECV_BUFFER_SIZE){
+        iov[0].iov_base = _rxBuf + _rxHead;
+        iov[0].iov_len = SERIAL_RECV_BUFFER_SIZE - _rxHead;
+        if (_rxTail > 0){
+            iov[1].iov_base = _rxBuf;
+            iov[1].iov_len = _rxTail;
+            iovCnt = 2;
+        }
+    }else{
+        iov[0].iov_base = _rxBuf + _rxHead;
+        iov[0].iov_len = _rxTail - _rxHead;
+    }
+    if (iov[0].iov_len == 0){
+        return 0;     // buffer full
+    }
+    int n = readv(_fd, iov, iovCnt);
+    if (n <= 0){
+        return 0;
+    }
+    _rxHead = (_rxHead + n) % SERIAL_RECV_BUFFER_SIZE;
+    _rxCnt += n;
+    return n;
 }
 
 void SerialPort::flush(void){
+  _rxHead = _rxTail = _rxCnt = 0;
   tcsetattr(_fd, TCSAFLUSH, &_tio);
 }
 
+int SerialPort::getFd(){
+  return _fd;
+}
+
 #endif
 
 /*=========================================
@@ -459,7 +1078,7 @@ uint8_t ZBResponse::getFrameDataLength(){
 }
 
 uint16_t ZBResponse::getPacketLength() {
-    return ((_msbLength << 8) & 0xff) + (_lsbLength & 0xff);
+    return ((uint16_t)_msbLength << 8) + _lsbLength;
 }
 
 void ZBResponse::setMsbLength(uint8_t msbLength){
@@ -559,12 +1178,77 @@ bool ZBResponse::isBrodcast(){
     return ( _options && 0x02);
 }
 
+/*=========================================
+           Class FrameBuf
+ =========================================*/
+FrameBuf::FrameBuf(){
+    init(NULL, 0, 0);
+}
+
+void FrameBuf::init(uint8_t* buf, uint16_t size, uint16_t headroom){
+    _buf = buf;
+    _size = size;
+    _head = (headroom > size ? size : headroom);
+    _length = 0;
+}
+
+uint8_t* FrameBuf::getData(){
+    return _buf + _head;
+}
+
+uint16_t FrameBuf::getLength(){
+    return _length;
+}
+
+uint16_t FrameBuf::getHeadroom(){
+    return _head;
+}
+
+uint16_t FrameBuf::getTailroom(){
+    return _size - _head - _length;
+}
+
+uint8_t* FrameBuf::push(uint16_t len){
+    if (len > _head){
+        return NULL;
+    }
+    _head -= len;
+    _length += len;
+    return _buf + _head;
+}
+
+uint8_t* FrameBuf::pull(uint16_t len){
+    if (len > _length){
+        return NULL;
+    }
+    _head += len;
+    _length -= len;
+    return _buf + _head;
+}
+
+uint8_t* FrameBuf::put(uint16_t len){
+    if (len > getTailroom()){
+        return NULL;
+    }
+    _length += len;
+    return _buf + _head + _length - len;
+}
+
+void FrameBuf::trim(uint16_t len){
+    if (len < _length){
+        _length = len;
+    }
+}
+
 /*=========================================
            Class ZBRequest
  =========================================*/
 
 ZBRequest::ZBRequest(){
-
+    _broadcastRadius = ZB_BROADCAST_RADIUS_MAX_HOPS;
+    _option = 0;
+    _payloadPtr = NULL;
+    _payloadLength = 0;
 }
 
 uint8_t ZBRequest::getFrameDataLength(){
@@ -610,17 +1294,39 @@ void ZBRequest::setPayloadLength(uint8_t payLoadLength){
 
 ZBeeStack::ZBeeStack(){
     _rxCallbackPtr = NULL;
+    _xmitStatusCallbackPtr = NULL;
+    _rxCallbackArg = NULL;
+    _xmitStatusCallbackArg = NULL;
     _returnCode = 0;
-    _response = ZBResponse();
+    _rxQueHead = 0;
+    _rxQueCnt = 0;
+    _rxQueHighWater = 0;
+    _rxDropCnt = 0;
+    _rxRejectCnt = 0;
     _pos = 0;
     _escape = false;
     _checksumTotal = 0;
-    _response.setPayload(_responsePayload);
+    _frameLength = 0;
+    _frameData = NULL;
+    _rxPoolUsed = 0;
     _serialPort = 0;
     _gwAddress64.setMsb(0);
     _gwAddress64.setLsb(0);
     _gwAddress16 = 0;
-    _tm.stop();
+    _gwTableUsed = 0;
+    memset(_gwAge, 0, sizeof(_gwAge));
+    _gwCnt = 0;
+    _frameId = 0;
+    _atFrameId = 0;
+    _atStatus = ZB_AT_STATUS_OK;
+    _atValue = NULL;
+    _atValueSize = _atValueLen = 0;
+    _myAddress64.setMsb(0);
+    _myAddress64.setLsb(0);
+    _myAddress16 = 0;
+    _maxPayload = MAX_PAYLOAD_SIZE;
+    setAddrHeader(UcastReq);
+    setAddrHeader(BcastReq);
 }
 
 ZBeeStack::~ZBeeStack(){
@@ -640,10 +1346,34 @@ bool ZBeeStack::init(const char* nodeId){
       }
 }
 
-void ZBeeStack::setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode)){
+void ZBeeStack::setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg){
     _rxCallbackPtr = callbackPtr;
+    _rxCallbackArg = arg;
 }
 
+void ZBeeStack::setXmitStatusHandler(void (*callbackPtr)(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount, void* arg), void* arg){
+    _xmitStatusCallbackPtr = callbackPtr;
+    _xmitStatusCallbackArg = arg;
+}
+
+#ifdef LINUX
+uint8_t ZBeeStack::getFds(int* fds, uint8_t size){
+    if (size < 1 || _serialPort == NULL){
+        return 0;
+    }
+    fds[0] = _serialPort->getFd();
+    return 1;
+}
+
+uint16_t ZBeeStack::getTxQueCount(){
+    return _serialPort->getPendingCount();
+}
+
+uint16_t ZBeeStack::sendTxQue(){
+    return _serialPort->sendPending();
+}
+#endif
+
 XBeeAddress64& ZBeeStack::getRxRemoteAddress64(){
     return _rxResp.getRemoteAddress64();
 }
@@ -658,15 +1388,32 @@ ZBResponse* ZBeeStack::getRxResponse(){
 
 
 void ZBeeStack::getResponse(ZBResponse& response){
-    response.setMsbLength(_response.getMsbLength());
-    response.setLsbLength(_response.getLsbLength());
-    response.setApiId(_response.getApiId());
-    response.setPayloadLength(_response.getPayloadLength());
-    response.setPayload(_response.getPayload());
-    response.setOption(_response.getOption());
-    response.setRemoteAddress16(_response.getRemoteAddress16());
-    response.getRemoteAddress64().setMsb(_response.getRemoteAddress64().getMsb());
-    response.getRemoteAddress64().setLsb(_response.getRemoteAddress64().getLsb());
+    ZBResponse& resp = _rxQue[_rxQueHead];
+    response.setMsbLength(resp.getMsbLength());
+    response.setLsbLength(resp.getLsbLength());
+    response.setApiId(resp.getApiId());
+    response.setPayloadLength(resp.getPayloadLength());
+    response.setPayload(resp.getPayload());
+    response.setOption(resp.getOption());
+    response.setRemoteAddress16(resp.getRemoteAddress16());
+    response.getRemoteAddress64().setMsb(resp.getRemoteAddress64().getMsb());
+    response.getRemoteAddress64().setLsb(resp.getRemoteAddress64().getLsb());
+}
+
+uint8_t ZBeeStack::getRxQueCount(){
+    return _rxQueCnt;
+}
+
+uint8_t ZBeeStack::getRxQueHighWater(){
+    return _rxQueHighWater;
+}
+
+uint16_t ZBeeStack::getRxDropCount(){
+    return _rxDropCnt;
+}
+
+uint16_t ZBeeStack::getRxRejectCount(){
+    return _rxRejectCnt;
 }
 
 
@@ -674,6 +1421,107 @@ void ZBeeStack::setGwAddress(XBeeAddress64& addr64, uint16_t addr16){
     _gwAddress64.setMsb(addr64.getMsb());
     _gwAddress64.setLsb(addr64.getLsb());
     _gwAddress16 = addr16;
+    setAddrHeader(UcastReq);
+    addGwAddress(addr64);
+}
+
+void ZBeeStack::setGwAddress(){
+    setGwAddress(_rxResp.getRemoteAddress64(), _rxResp.getRemoteAddress16());
+}
+
+/*
+ *  Unicast frames are accepted from the Gateways in the table only.
+ *  The table is empty until the first Gateway is found. When it is
+ *  full, the Gateway heard from least recently gives way, never the
+ *  one in use.
+ */
+bool ZBeeStack::addGwAddress(XBeeAddress64& addr64){
+    uint8_t i = getGwHash(addr64);
+    while (_gwTableUsed & (1 << i)){
+        if (_gwTable[i].getMsb() == addr64.getMsb() && _gwTable[i].getLsb() == addr64.getLsb()){
+            touchGwAddress(i);
+            return true;
+        }
+        i = (i + 1) & (ZB_GW_TABLE_SIZE - 1);
+    }
+    if (_gwCnt == ZB_MAX_GATEWAYS){
+        D_ZBSTACKW("  Gateway table is full, the oldest is replaced\r\n");
+        removeGwAddress(getOldestGwAddress());
+        return addGwAddress(addr64);      // the entries may have moved
+    }
+    _gwTable[i].setMsb(addr64.getMsb());
+    _gwTable[i].setLsb(addr64.getLsb());
+    _gwTableUsed |= (1 << i);
+    _gwCnt++;
+    touchGwAddress(i);
+    return true;
+}
+
+void ZBeeStack::addGwAddress(){
+    addGwAddress(_rxResp.getRemoteAddress64());
+}
+
+bool ZBeeStack::isGwAddress(XBeeAddress64& addr64){
+    uint8_t i = getGwHash(addr64);
+    while (_gwTableUsed & (1 << i)){
+        if (_gwTable[i].getMsb() == addr64.getMsb() && _gwTable[i].getLsb() == addr64.getLsb()){
+            return true;
+        }
+        i = (i + 1) & (ZB_GW_TABLE_SIZE - 1);
+    }
+    return false;
+}
+
+/*
+ *  Entry i is the newest, all others get one older.
+ */
+void ZBeeStack::touchGwAddress(uint8_t i){
+    for (uint8_t j = 0; j < ZB_GW_TABLE_SIZE; j++){
+        if (_gwAge[j] < 0xff){
+            _gwAge[j]++;
+        }
+    }
+    _gwAge[i] = 0;
+}
+
+uint8_t ZBeeStack::getOldestGwAddress(){
+    uint8_t oldest = 0;
+    int age = -1;
+    for (uint8_t i = 0; i < ZB_GW_TABLE_SIZE; i++){
+        if ((_gwTableUsed & (1 << i)) && _gwAge[i] > age &&
+            (_gwTable[i].getMsb() != _gwAddress64.getMsb() || _gwTable[i].getLsb() != _gwAddress64.getLsb())){
+            oldest = i;
+            age = _gwAge[i];
+        }
+    }
+    return oldest;
+}
+
+/*
+ *  Free entry i and move the rest of its probe run up,
+ *  so that no probe stops at the hole.
+ */
+void ZBeeStack::removeGwAddress(uint8_t i){
+    _gwTableUsed &= ~(1 << i);
+    _gwCnt--;
+    for (uint8_t j = (i + 1) & (ZB_GW_TABLE_SIZE - 1); _gwTableUsed & (1 << j); j = (j + 1) & (ZB_GW_TABLE_SIZE - 1)){
+        _gwTableUsed &= ~(1 << j);
+        uint8_t k = getGwHash(_gwTable[j]);
+        while (_gwTableUsed & (1 << k)){
+            k = (k + 1) & (ZB_GW_TABLE_SIZE - 1);
+        }
+        _gwTable[k].setMsb(_gwTable[j].getMsb());
+        _gwTable[k].setLsb(_gwTable[j].getLsb());
+        _gwAge[k] = _gwAge[j];
+        _gwTableUsed |= (1 << k);
+    }
+}
+
+uint8_t ZBeeStack::getGwHash(XBeeAddress64& addr64){
+    uint32_t h = addr64.getMsb() ^ addr64.getLsb();
+    h ^= h >> 16;
+    h ^= h >> 8;
+    return h & (ZB_GW_TABLE_SIZE - 1);
 }
 
 void ZBeeStack::setSerialPort(SerialPort *serialPort){
@@ -681,254 +1529,542 @@ void ZBeeStack::setSerialPort(SerialPort *serialPort){
 }
 
 
-void ZBeeStack::send(uint8_t* payload, uint8_t payloadLen, uint8_t option, SendReqType type ){
+/*
+ *  Returns the frame ID which the Transmit Status (0x8B) refers to,
+ *  or PACKET_ERROR_NOT_SENT if the SerialPort queue is full.
+ */
+int ZBeeStack::send(uint8_t* payload, uint8_t payloadLen, uint8_t option, SendReqType type ){
     _txRequest.setOption(option);
     _txRequest.setPayload(payload);
     _txRequest.setPayloadLength(payloadLen);
-    sendZBRequest(_txRequest, type);
+    return sendZBRequest(_txRequest, type);
 }
 
+/*
+ *  Dispatch the oldest received frame to the RX handler.
+ *  Frames are queued by the parser, so one read may queue several.
+ *  Never waits, PACKET_ERROR_NODATA until a whole frame is received.
+ */
 int ZBeeStack::readPacket(){
     _returnCode = PACKET_ERROR_NODATA;
 
-    if(_serialPort->checkRecvBuf()){
-        _returnCode = PACKET_ERROR_NODATA;
+    if(_rxQueCnt == 0){
+        readApiFrame();
+    }
 
-        if(readApiFrame(PACKET_TIMEOUT_CHECK)){
-            if(_response.getApiId() == ZB_API_RESPONSE){
-                if (!_response.isError()){
-                    getResponse(_rxResp);
-                    for ( int i = 0; i < _rxResp.getPayloadLength(); i++){
-                        _rxPayloadBuf[i] = _rxResp.getPayload()[i];
-                    }
-                    _rxResp.setPayload(_rxPayloadBuf);
-                    if (_rxCallbackPtr != NULL){
-                        _rxCallbackPtr(&_rxResp, &_returnCode);
-                    }
-                }
-            }
+    if(_rxQueCnt > 0){
+        getResponse(_rxResp);     // payload stays in the pool buffer
+        if(_rxResp.getApiId() == ZB_API_RESPONSE && _rxCallbackPtr != NULL){
+            _rxCallbackPtr(&_rxResp, &_returnCode, _rxCallbackArg);
+
+        }else if(_rxResp.getApiId() == ZB_API_XMIT_STATUS && _xmitStatusCallbackPtr != NULL){
+            _xmitStatusCallbackPtr(_rxResp.getPayload(0),    // Frame ID
+                                   _rxResp.getPayload(4),    // Delivery status
+                                   _rxResp.getPayload(3),    // Transmit retry count
+                                   _xmitStatusCallbackArg);
+
+        }else if(_rxResp.getApiId() == ZB_API_AT_RESPONSE){
+            setAtResponse(&_rxResp);
         }
+        freeFrameBuf(_rxQueBuf[_rxQueHead]);   // return the buffer to the pool
+        _rxQue[_rxQueHead].reset();
+        _rxQueHead = (_rxQueHead + 1) % ZB_RX_QUE_SIZE;
+        _rxQueCnt--;
     }
     return _returnCode;
 }
 
-bool ZBeeStack::readApiFrame(uint16_t timeoutMillsec){
-    _pos = 0;
-    _tm.start((uint32_t)timeoutMillsec);
-
-
-    while(!_tm.isTimeUp()){
-
-        readApiFrame();
-
-        if(_response.isAvailable()){
-            D_ZBSTACKW("\r\n<=== CheckSum OK\r\n\n");
-            if( (_response.getOption() & 0x02 ) == 0x02 ){ //  broadcast ?
-                return true;
-            }else if(_gwAddress16 &&
-                (_gwAddress64.getMsb() != _response.getRemoteAddress64().getMsb()) &&
-                (_gwAddress64.getLsb() != _response.getRemoteAddress64().getLsb())){
-                D_ZBSTACKW("  Sender is not Gateway!\r\n" );
-                return false;
-            }else{
-                return true;
-            }
-        }else if(_response.isError()){
-            D_ZBSTACKW("\r\n<=== Packet Error Code = ");
-            D_ZBSTACKLN(_response.getErrorCode(), DEC);
-            D_ZBSTACKF("%d\r\n",_response.getErrorCode() );
-            return false;
-        }
+/*
+ *  Wait until received data is available or the timeout expires.
+ *  Only Linux can sleep on the device; other targets just poll it.
+ */
+bool ZBeeStack::waitPacket(uint32_t timeoutMillsec){
+    if(_rxQueCnt > 0){
+        return true;
     }
-    return false;   //Timeout
+#ifdef LINUX
+    return _serialPort->waitRecv(timeoutMillsec);
+#else
+    return _serialPort->checkRecvBuf();
+#endif
 }
 
+/*
+ *  Parse received data until the queue is full. Every completed frame
+ *  is queued; the rest stays in the receive buffer for the next call.
+ */
 void ZBeeStack::readApiFrame(){
-
-    if (_response.isAvailable() || _response.isError()){
-      resetResponse();
+#ifdef LINUX
+    uint8_t* buf;
+    int len;
+    while(_rxQueCnt < ZB_RX_QUE_SIZE && (len = _serialPort->peek(&buf)) > 0){
+        _serialPort->skip(parseApiFrame(buf, len));
     }
+#else
+    uint8_t data;
+    while(_rxQueCnt < ZB_RX_QUE_SIZE && read(&data)){
+        parseApiFrame(&data, 1);
+    }
+#endif
+}
 
-    while(read(&_byteData )){
+/*
+ *  Feed received bytes to the API frame parser.
+ *  The parser state survives between calls, so a frame may be split
+ *  at any byte. Each completed frame is added to the receive queue.
+ *  Stops at the start of a frame when the queue is full.
+ *  Returns the number of bytes consumed.
+ */
+uint16_t ZBeeStack::parseApiFrame(uint8_t* buf, uint16_t len){
+    uint16_t i = 0;
+    while(i < len){
+        if(_pos >= API_ID_POS && _pos < _frameLength + API_ID_POS){
+            uint16_t used;
+            _pos += zbUnescape(_frameData + _pos - API_ID_POS, _frameLength + API_ID_POS - _pos,
+                               buf + i, len - i, &used, &_escape, &_checksumTotal);
+            i += used;
+            if(i == len){
+                break;
+            }
+        }
+        uint8_t data = buf[i++];
 
-        if( _byteData == START_BYTE){
+        if(data == START_BYTE){
+            if(_rxQueCnt == ZB_RX_QUE_SIZE){
+                return i - 1;      // queue is full, leave the frame in the receive buffer
+            }
+            if(_frameData == NULL && (_frameData = allocFrameBuf()) == NULL){
+                _rxDropCnt++;      // no free buffer, drop the frame
+                _pos = 0;
+                continue;
+            }
             _pos = 1;
+            _escape = false;
+            _checksumTotal = 0;
             continue;
         }
+        if(_pos == 0){
+            continue;      // wait for Start byte
+        }
         // Check ESC
-        if(_pos > 0 && _byteData == ESCAPE){
-          if(read(&_byteData )){
-              _byteData = 0x20 ^ _byteData;  // decode
-          }else{
-              _escape = true;
-              continue;
-          }
+        if(data == ESCAPE){
+            _escape = true;
+            continue;
         }
-
         if(_escape){
-            _byteData = 0x20 ^ _byteData;
+            data = 0x20 ^ data;
             _escape = false;
         }
 
-        if(_pos >= API_ID_POS){
-            _checksumTotal+= _byteData;
-        }
-
-        switch(_pos){
-        case 0:
-            break;
-
-        case 1:
-            _response.setMsbLength(_byteData);
-            break;
+        if(_pos == 1){
+            _frameLength = (uint16_t)data << 8;
 
-        case 2:
-            _response.setLsbLength(_byteData);
+        }else if(_pos == 2){
+            _frameLength += data;
             D_ZBSTACKW("\r\n===> Recv:    ");
-            break;
-        case 3:
-            _response.setApiId(_byteData);   // API
-            break;
-
-        case 4:
-            _addr32 = (uint32_t(_byteData) << 24);
-            break;
-        case 5:
-            _addr32 += (uint32_t(_byteData) << 16);
-            break;
-
-        case 6:
-            _addr32 += (uint32_t(_byteData) << 8);
-            break;
-
-        case 7:
-            _addr32 += _byteData;
-            _response.getRemoteAddress64().setMsb(_addr32);
-            break;
-
-        case 8:
-            _addr32 = (uint32_t(_byteData) << 24);
-            break;
-
-        case 9:
-            _addr32 += (uint32_t(_byteData) << 16);
-            break;
-
-        case 10:
-            _addr32 += (uint32_t(_byteData) << 8);
-            break;
-
-        case 11:
-            _addr32 += _byteData;
-            _response.getRemoteAddress64().setLsb(_addr32);
-            break;
-
-        case 12:
-            _addr16 = (uint16_t(_byteData) << 8);
-            break;
-
-        case 13:
-            _addr16 += _byteData;
-            _response.setRemoteAddress16(_addr16);
-            break;
+            if(_frameLength == 0 || _frameLength > ZB_MAX_FRAME_DATA){
+                D_ZBSTACKW("\r\n<=== Packet Error Code = ");
+                D_ZBSTACKLN(PACKET_EXCEEDS_BYTE_ARRAY_LENGTH, DEC);
+                D_ZBSTACKF("%d\r\n", PACKET_EXCEEDS_BYTE_ARRAY_LENGTH);
+                _pos = 0;
+                continue;
+            }
 
-        case 14:
-            _response.setOption(_byteData);
-            D_ZBSTACKW( "\r\n     Payload: ");
-            break;
+        }else if(_pos < _frameLength + API_ID_POS){
+            _frameData[_pos - API_ID_POS] = data;
+            _checksumTotal += data;
 
-        default:
-            if(_pos > MAX_PAYLOAD_SIZE){
-              _response.setErrorCode(PACKET_EXCEEDS_BYTE_ARRAY_LENGTH);
-              _pos = 0;
-              return;
-            }else if(_pos == (_response.getPacketLength() + 3)){  // 3 = 2(packet len) + 1(checksum)
-              if((_checksumTotal & 0xff) == 0xff){
-                  _response.setChecksum(_byteData);
-                  _response.setAvailable(true);
-                  _response.setErrorCode(NO_ERROR);
-              }else{
-                  _response.setErrorCode(CHECKSUM_FAILURE);
-              }
-              _response.setPayloadLength(_pos - 4 - ZB_RSP_DATA_OFFSET);    // 4 = 2(packet len) + 1(Api) + 1(checksum)
-              _pos = 0;
-              _checksumTotal = 0;
-              return;
+        }else{                    // Checksum
+            _checksumTotal += data;
+            _pos = 0;
+            if(_checksumTotal == 0xff){
+                D_ZBSTACKW("\r\n<=== CheckSum OK\r\n\n");
+                setResponse(data);
             }else{
-              _response.getPayload()[_pos - 4 - ZB_RSP_DATA_OFFSET] = _byteData;
+                D_ZBSTACKW("\r\n<=== Packet Error Code = ");
+                D_ZBSTACKLN(CHECKSUM_FAILURE, DEC);
+                D_ZBSTACKF("%d\r\n", CHECKSUM_FAILURE);
             }
-            break;
+            continue;
         }
         _pos++;
+    }
+    return i;
+}
 
+/*
+ *  Decode the frame data of a completed frame into the receive queue.
+ */
+void ZBeeStack::setResponse(uint8_t checksum){
+    if(_rxQueCnt == ZB_RX_QUE_SIZE){
+        _rxDropCnt++;             // queue overflow, drop the frame
+        return;
     }
+    ZBResponse& resp = _rxQue[(_rxQueHead + _rxQueCnt) % ZB_RX_QUE_SIZE];
+    resp.reset();
+    resp.setMsbLength((_frameLength >> 8) & 0xff);
+    resp.setLsbLength(_frameLength & 0xff);
+    resp.setApiId(_frameData[0]);
+    resp.setChecksum(checksum);
+
+    if(_frameData[0] == ZB_API_RESPONSE){
+        if(_frameLength < ZB_RSP_DATA_OFFSET + 1){
+            return;
+        }
+        resp.getRemoteAddress64().setMsb(getUint32(_frameData + 1));
+        resp.getRemoteAddress64().setLsb(getUint32(_frameData + 5));
+        resp.setRemoteAddress16(getUint16(_frameData + 9));
+        resp.setOption(_frameData[11]);
+        resp.setPayload(_frameData + ZB_RSP_DATA_OFFSET + 1);
+        resp.setPayloadLength(_frameLength - ZB_RSP_DATA_OFFSET - 1);
+
+        if( (resp.getOption() & 0x02 ) != 0x02 &&    //  not broadcast
+            _gwCnt && !isGwAddress(resp.getRemoteAddress64())){
+            D_ZBSTACKW("  Sender is not Gateway!\r\n" );
+            _rxRejectCnt++;
+            return;
+        }
+    }else{
+        if((_frameData[0] == ZB_API_XMIT_STATUS && _frameLength < ZB_XMIT_STATUS_LENGTH) ||
+           (_frameData[0] == ZB_API_AT_RESPONSE && _frameLength < ZB_AT_RESPONSE_LENGTH)){
+            return;
+        }
+        resp.setPayload(_frameData + 1);       // frame data after the API ID
+        resp.setPayloadLength(_frameLength - 1);
+    }
+    resp.setErrorCode(NO_ERROR);
+    resp.setAvailable(true);
+    _rxQueBuf[(_rxQueHead + _rxQueCnt) % ZB_RX_QUE_SIZE] = _frameData;  // hand the buffer over
+    _frameData = NULL;
+    if(++_rxQueCnt > _rxQueHighWater){
+        _rxQueHighWater = _rxQueCnt;
+    }
+}
+
+/*
+ *  Receive frame buffers are taken from a fixed pool, so a frame is
+ *  never copied between the parser and the message handler.
+ */
+uint8_t* ZBeeStack::allocFrameBuf(){
+    for (uint8_t i = 0; i < ZB_RX_POOL_SIZE; i++){
+        if ((_rxPoolUsed & ((uint32_t)1 << i)) == 0){
+            _rxPoolUsed |= ((uint32_t)1 << i);
+            return _rxPool[i];
+        }
+    }
+    return NULL;
 }
 
-void ZBeeStack::sendZBRequest(ZBRequest& request, SendReqType type){
+void ZBeeStack::freeFrameBuf(uint8_t* buf){
+    for (uint8_t i = 0; i < ZB_RX_POOL_SIZE; i++){
+        if (_rxPool[i] == buf){
+            _rxPoolUsed &= ~((uint32_t)1 << i);
+        }
+    }
+}
+
+int ZBeeStack::sendZBRequest(ZBRequest& request, SendReqType type){
     D_ZBSTACKW("\r\n===> Send:    ");
 
-    sendByte(START_BYTE, false);           // Start byte
+    uint8_t* buf = _txFrameBuf;
+    uint8_t pos = 0;
+
+    buf[pos++] = START_BYTE;             // Start byte
 
     uint8_t msbLen = ((request.getFrameDataLength() + 1) >> 8) & 0xff; // 1  for Checksum
     uint8_t lsbLen = (request.getFrameDataLength() + 1) & 0xff;
-    sendByte(msbLen, true);               // Message Length
-    sendByte(lsbLen, true);               // Message Length
-
-    sendByte(ZB_API_REQUEST, true);       // API
-    uint8_t checksum = 0;
-    checksum+= ZB_API_REQUEST;
+    pos += escapeByte(buf + pos, msbLen); // Message Length
+    pos += escapeByte(buf + pos, lsbLen); // Message Length
 
-    sendByte(0x00, true);                 // Frame ID
+    buf[pos++] = ZB_API_REQUEST;         // API
+    pos += escapeByte(buf + pos, getNextFrameId()); // Frame ID
 
-    for(int i = 0; i < 10; i++){
-        sendByte(getAddrByte(i,type), true);   // Gateway Address 64 & 16
-        checksum += getAddrByte(i,type);       //   or Broadcast Address
+    uint8_t checksum;
+    if (type == UcastReq){
+        memcpy(buf + pos, _ucastHeader, _ucastHeaderLen);  // Gateway Address 64 & 16
+        pos += _ucastHeaderLen;
+        checksum = _ucastChecksum;
+    }else{
+        memcpy(buf + pos, _bcastHeader, _bcastHeaderLen);  // Broadcast Address
+        pos += _bcastHeaderLen;
+        checksum = _bcastChecksum;
     }
+    checksum += _frameId;
 
-    sendByte(request.getBroadcastRadius(), true);
+    pos += escapeByte(buf + pos, request.getBroadcastRadius());
     checksum += request.getBroadcastRadius();
 
-    sendByte(request.getOption(), true);
+    pos += escapeByte(buf + pos, request.getOption());
     checksum += request.getOption();
 
-    D_ZBSTACKW("\r\n     Payload: ");
+    pos += zbEscape(buf + pos, request.getPayload(), request.getPayloadLength(), &checksum);  // Payload
+    checksum = 0xff - checksum;
+    pos += escapeByte(buf + pos, checksum);
 
-    for( int i = 0; i < request.getPayloadLength(); i++ ){
-        sendByte(request.getPayload()[i], true);     // Payload
-        checksum+= request.getPayload()[i];
+    if (!write(buf, pos)){
+        D_ZBSTACKW("\r\n<=== Send queue is full\r\n\n" );
+        return PACKET_ERROR_NOT_SENT;
     }
-    checksum = 0xff - checksum;
-    sendByte(checksum, true);
 
-    //flush();  // clear receive buffer
+    D_ZBSTACKW("\r\n<=== Send completed\r\n\n" );
+    return _frameId;
+}
+
+/*
+ *  Build the 0x10 frame around the payload in its own buffer and write it
+ *  without a copy. A frame with a byte to be escaped (rare) is escaped into
+ *  _txFrameBuf. The frame is restored to the payload on return.
+ */
+int ZBeeStack::sendFrame(FrameBuf* frame, uint8_t option, SendReqType type){
+    uint16_t len = frame->getLength();
+    if (frame->getHeadroom() < ZB_FRAME_HEADROOM || frame->getTailroom() < ZB_FRAME_TAILROOM){
+        return send(frame->getData(), len, option, type);
+    }
+    D_ZBSTACKW("\r\n===> Send:    ");
+
+    uint16_t dataLen = ZB_REQ_DATA_OFFSET + 1 + len;    // API ID + frame data
+    uint8_t* buf = frame->push(ZB_FRAME_HEADROOM);
+    buf[0] = START_BYTE;
+    buf[1] = (dataLen >> 8) & 0xff;
+    buf[2] = dataLen & 0xff;
+    buf[3] = ZB_API_REQUEST;
+    buf[4] = getNextFrameId();
+    memcpy(buf + 5, (type == UcastReq ? _ucastAddr : _bcastAddr), ZB_ADDR_LENGTH);
+    buf[15] = ZB_BROADCAST_RADIUS_MAX_HOPS;
+    buf[16] = option;
+    uint8_t* checksum = frame->put(ZB_FRAME_TAILROOM);
+
+    /*---- sum and look for the bytes to be escaped at once, in place ----*/
+    uint8_t sum = 0;
+    bool clean = (copyCleanRun(buf + 3, buf + 3, dataLen, &sum, true) == dataLen);
+    *checksum = 0xff - sum;
+    clean = clean && !isEscapeTarget(buf[1], true) && !isEscapeTarget(buf[2], true) &&
+            !isEscapeTarget(*checksum, true);
+
+    bool sent;
+    if (clean){
+        sent = write(buf, frame->getLength());
+    }else{
+        uint16_t pos = 0;
+        sum = 0;
+        _txFrameBuf[pos++] = START_BYTE;
+        pos += escapeByte(_txFrameBuf + pos, buf[1]);
+        pos += escapeByte(_txFrameBuf + pos, buf[2]);
+        pos += zbEscape(_txFrameBuf + pos, buf + 3, dataLen, &sum);
+        pos += escapeByte(_txFrameBuf + pos, 0xff - sum);
+        sent = write(_txFrameBuf, pos);
+    }
+    frame->pull(ZB_FRAME_HEADROOM);
+    frame->trim(len);
 
+    if (!sent){
+        D_ZBSTACKW("\r\n<=== Send queue is full\r\n\n" );
+        return PACKET_ERROR_NOT_SENT;
+    }
     D_ZBSTACKW("\r\n<=== Send completed\r\n\n" );
+    return _frameId;
 }
 
-void ZBeeStack::sendByte(uint8_t b, bool escape){
-  if(escape && (b == START_BYTE || b == ESCAPE || b == XON || b == XOFF)){
-      write(ESCAPE);
-      write(b ^ 0x20);
+/*
+ *  Frame ID 0 disables the response of the radio, so it is skipped.
+ */
+uint8_t ZBeeStack::getNextFrameId(){
+    if (++_frameId == 0){
+        _frameId = 1;
+    }
+    return _frameId;
+}
+
+uint8_t ZBeeStack::escapeByte(uint8_t* pos, uint8_t b){
+  if(b == START_BYTE || b == ESCAPE || b == XON || b == XOFF){
+      pos[0] = ESCAPE;
+      pos[1] = b ^ 0x20;
+      return 2;
   }else{
-      write(b);
+      pos[0] = b;
+      return 1;
   }
 }
 
-void ZBeeStack::resetResponse(){
-  _pos = 0;
-  _escape = 0;
-  _response.reset();
-  _addr16 = 0;
-  _addr32 = 0;
+/*
+ *  Cache the escaped destination address and its partial checksum.
+ */
+void ZBeeStack::setAddrHeader(SendReqType type){
+    uint8_t* header = (type == UcastReq ? _ucastHeader : _bcastHeader);
+    uint8_t* addr = (type == UcastReq ? _ucastAddr : _bcastAddr);
+    uint8_t len = 0;
+    uint8_t checksum = ZB_API_REQUEST;
+    for (uint8_t i = 0; i < ZB_ADDR_LENGTH; i++){
+        uint8_t b = getAddrByte(i, type);
+        addr[i] = b;
+        len += escapeByte(header + len, b);
+        checksum += b;
+    }
+    if (type == UcastReq){
+        _ucastHeaderLen = len;
+        _ucastChecksum = checksum;
+    }else{
+        _bcastHeaderLen = len;
+        _bcastChecksum = checksum;
+    }
+}
+
+/*===========================================
+        AT Command (0x08) & Response (0x88)
+ ============================================*/
+/*  Baudrate of each BD parameter, 8 to 10 are supported by XBee3 and S2C  */
+#ifdef LINUX
+static const unsigned int theBaudrate[] = {B1200, B2400, B4800, B9600, B19200, B38400, B57600, B115200,
+#if defined(B230400) && defined(B460800) && defined(B921600)
+                                           B230400, B460800, B921600
+#endif
+                                           };
+#else
+static const long theBaudrate[] = {1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200,
+                                   230400, 460800, 921600};
+#endif
+typedef char zbAtBdMaxInTable[ZB_AT_BD_MAX < sizeof(theBaudrate) / sizeof(theBaudrate[0]) ? 1 : -1];
+
+/*
+ *  Send an AT command and wait for the response of the same frame ID.
+ *  Frames received meanwhile are dispatched as usual.
+ *  Returns the length of the value, PACKET_ERROR_RESPONSE if the radio
+ *  rejects the command, PACKET_ERROR_NODATA on timeout, PACKET_ERROR_NOT_SENT
+ *  if the SerialPort queue is full.
+ */
+int ZBeeStack::atCommand(const char* cmd, const uint8_t* param, uint8_t paramLen,
+                         uint8_t* value, uint8_t valueSize){
+    D_ZBSTACKW("\r\n===> AT Command:    ");
+
+    uint8_t* buf = _txFrameBuf;
+    uint8_t pos = 0;
+
+    buf[pos++] = START_BYTE;                         // Start byte
+    pos += escapeByte(buf + pos, 0);                 // Message Length
+    pos += escapeByte(buf + pos, 4 + paramLen);      // API ID + Frame ID + command
+
+    buf[pos++] = ZB_API_AT_COMMAND;                  // API
+    _atFrameId = getNextFrameId();
+    pos += escapeByte(buf + pos, _atFrameId);        // Frame ID
+    pos += escapeByte(buf + pos, cmd[0]);            // AT command
+    pos += escapeByte(buf + pos, cmd[1]);
+    uint8_t checksum = ZB_API_AT_COMMAND + _atFrameId + cmd[0] + cmd[1];
+    pos += zbEscape(buf + pos, param, paramLen, &checksum);   // Parameter
+    pos += escapeByte(buf + pos, 0xff - checksum);
+
+    if (!write(buf, pos)){
+        _atFrameId = 0;
+        return PACKET_ERROR_NOT_SENT;
+    }
+    _atStatus = ZB_AT_STATUS_WAITING;
+    _atValue = value;
+    _atValueSize = valueSize;
+    _atValueLen = 0;
+
+    XTimer tm;
+    tm.start(ZB_AT_TIMEOUT);
+    while(_atStatus == ZB_AT_STATUS_WAITING && !tm.isTimeUp()){
+        waitPacket(tm.getRemain());
+        readPacket();
+    }
+    _atValue = NULL;
+
+    if(_atStatus == ZB_AT_STATUS_WAITING){
+        _atFrameId = 0;
+        return PACKET_ERROR_NODATA;
+    }else if(_atStatus != ZB_AT_STATUS_OK){
+        return PACKET_ERROR_RESPONSE;
+    }
+    return _atValueLen;
+}
+
+/*
+ *  Payload of the response: Frame ID, AT command, Status, Value.
+ */
+void ZBeeStack::setAtResponse(ZBResponse* resp){
+    if(_atStatus != ZB_AT_STATUS_WAITING || resp->getPayload(0) != _atFrameId){
+        return;
+    }
+    _atValueLen = resp->getPayloadLength() - 4;
+    if(_atValueLen > _atValueSize){
+        _atValueLen = _atValueSize;
+    }
+    if(_atValue){
+        memcpy(_atValue, resp->getPayload() + 4, _atValueLen);
+    }
+    _atStatus = resp->getPayload(3);
+}
+
+/*
+ *  Read the addresses and the max payload of the radio and
+ *  switch the interface to the fastest baudrate.
+ */
+bool ZBeeStack::initRadio(){
+    uint8_t val[4];
+
+    if(atCommand("SH", NULL, 0, val, 4) != 4){
+        /*---- The radio may be left at the fastest baudrate ----*/
+        long baudrate = _serialPort->getBaudrate();
+        _serialPort->setBaudrate(theBaudrate[ZB_AT_BD_MAX]);
+        if(atCommand("SH", NULL, 0, val, 4) != 4){
+            _serialPort->setBaudrate(baudrate);     // no radio answers, keep the configured speed
+            return false;
+        }
+    }
+    _myAddress64.setMsb(getUint32(val));
+    if(atCommand("SL", NULL, 0, val, 4) != 4){
+        return false;
+    }
+    _myAddress64.setLsb(getUint32(val));
+    if(atCommand("MY", NULL, 0, val, 2) != 2){
+        return false;
+    }
+    _myAddress16 = getUint16(val);
+
+    if(atCommand("NP", NULL, 0, val, 2) == 2 && getUint16(val) < MAX_PAYLOAD_SIZE){
+        _maxPayload = getUint16(val);
+    }
+    getRssi();
+
+    /*---- Baudrate is changed after the response ----*/
+    int len = atCommand("BD", NULL, 0, val, 4);
+    if(len > 0 && val[len - 1] != ZB_AT_BD_MAX){
+        val[0] = ZB_AT_BD_MAX;
+        if(atCommand("BD", val, 1, NULL, 0) >= 0){
+            _serialPort->setBaudrate(theBaudrate[ZB_AT_BD_MAX]);
+        }
+    }
+    D_ZBSTACKW("\r\n<=== Radio initialized\r\n");
+    return true;
+}
+
+/*
+ *  RSSI of the last received packet in -dBm, or the error code.
+ */
+int ZBeeStack::getRssi(){
+    uint8_t val;
+    int rc = atCommand("DB", NULL, 0, &val, 1);
+    return rc == 1 ? val : rc;
+}
+
+XBeeAddress64& ZBeeStack::getMyAddress64(){
+    return _myAddress64;
+}
+
+uint16_t ZBeeStack::getMyAddress16(){
+    return _myAddress16;
+}
 
+uint8_t ZBeeStack::getMaxPayload(){
+    return _maxPayload;
 }
 
 void ZBeeStack::flush(){
   _serialPort->flush();
 }
 
-bool ZBeeStack::write(uint8_t val){
-  return (_serialPort->send(val) ? true : false );
+bool ZBeeStack::write(uint8_t* buff, uint8_t len){
+  return _serialPort->send(buff, len);
 }
 
 bool ZBeeStack::read(uint8_t *buff){
@@ -81,6 +81,20 @@ namespace tomyClient {
 
 #define ZB_API_REQUEST               0x10
 #define ZB_API_RESPONSE              0x90
+#define ZB_API_XMIT_STATUS           0x8B
+
+#define ZB_XMIT_STATUS_SUCCESS       0x00
+#define ZB_XMIT_STATUS_LENGTH           7  // API ID + frame data
+
+#define ZB_API_AT_COMMAND            0x08
+#define ZB_API_AT_RESPONSE           0x88
+#define ZB_AT_RESPONSE_LENGTH           5  // API ID + frame data without value
+#define ZB_AT_STATUS_OK              0x00
+#define ZB_AT_STATUS_WAITING         0xff
+#define ZB_AT_TIMEOUT                 500  // msec
+#ifndef ZB_AT_BD_MAX
+  #define ZB_AT_BD_MAX                  7  // BD parameter of the fastest baudrate, 115200bps, up to 10 (921600bps)
+#endif
 
 #define ZB_PACKET_ACKNOWLEGED        0x01
 #define ZB_BROADCAST_PACKET          0x02
@@ -90,6 +104,13 @@ namespace tomyClient {
 
 #define API_ID_POS                    3
 #define PACKET_OVERHEAD_LENGTH        6
+#define ZB_ADDR_LENGTH               10  // 64bit + 16bit address
+#define ZB_MAX_FRAME_DATA   (MAX_PAYLOAD_SIZE + ZB_RSP_DATA_OFFSET + 1)  // API ID + frame data
+#define ZB_TX_BUFFER_SIZE   ((MAX_PAYLOAD_SIZE + ZB_REQ_DATA_OFFSET + 4) * 2) // escaped worst case
+#define ZB_FRAME_HEADROOM   (ZB_REQ_DATA_OFFSET + 4)  // Start byte, length, API ID and frame data before the payload
+#define ZB_FRAME_TAILROOM    1                        // checksum
+#define NW_MAX_HEADROOM     ZB_FRAME_HEADROOM         // of the networks, reserved by MqttsMessage
+#define NW_MAX_TAILROOM     ZB_FRAME_TAILROOM
 //#define TX_API_LENGTH  12
 
 #define ZB_MAX_NODEID  20
@@ -108,6 +129,7 @@ namespace tomyClient {
 #define PACKET_ERROR_RESPONSE  -1
 #define PACKET_ERROR_UNKOWN    -2
 #define PACKET_ERROR_NODATA    -3
+#define PACKET_ERROR_NOT_SENT  -4   // the network did not take the frame
 
 enum SendReqType{
     NoReq = 0,
@@ -135,6 +157,27 @@ enum NodeStatus {
 #endif
 
 #define RING_BUFFER_SIZE  256
+#ifndef ZB_RX_QUE_SIZE
+  #if defined(ARDUINO)
+    #define ZB_RX_QUE_SIZE   2
+  #elif defined(MBED)
+    #define ZB_RX_QUE_SIZE   4
+  #else
+    #define ZB_RX_QUE_SIZE  16   // max 31
+  #endif
+#endif
+#define ZB_RX_POOL_SIZE  (ZB_RX_QUE_SIZE + 1)  // + 1 for the frame being parsed
+#ifndef ZB_GW_TABLE_SIZE
+  #if defined(ARDUINO)
+    #define ZB_GW_TABLE_SIZE  4
+  #else
+    #define ZB_GW_TABLE_SIZE  8  // power of 2, max 8
+  #endif
+#endif
+#define ZB_MAX_GATEWAYS  (ZB_GW_TABLE_SIZE / 2)  // keeps the probes short
+#define XTIMER_INFINITE   0xffffffff
+#define SERIAL_RECV_BUFFER_SIZE  1024
+#define SERIAL_SEND_BUFFER_SIZE  1024   // frames held while the radio drops CTS
 /*============================================
               XBeeAddress64
  =============================================*/
@@ -207,6 +250,33 @@ private:
 
 };
 
+/*============================================*
+                FrameBuf
+ =============================================*/
+/*
+ *  Message with room for the header and the trailer of a network in front
+ *  of and behind it, like sk_buff of Linux. The network pushes its header
+ *  and puts its trailer around the message and sends the frame in place.
+ */
+class FrameBuf {
+public:
+    FrameBuf();
+    void init(uint8_t* buf, uint16_t size, uint16_t headroom);
+    uint8_t* getData();
+    uint16_t getLength();
+    uint16_t getHeadroom();
+    uint16_t getTailroom();
+    uint8_t* push(uint16_t len);   // add len bytes at the head, NULL if no room
+    uint8_t* pull(uint16_t len);   // remove len bytes from the head
+    uint8_t* put(uint16_t len);    // add len bytes at the tail, returns them
+    void     trim(uint16_t len);   // cut the tail to len bytes
+private:
+    uint8_t* _buf;
+    uint16_t _size;
+    uint16_t _head;
+    uint16_t _length;
+};
+
 /*============================================*
                 ZBRequest
  =============================================*/
@@ -245,12 +315,16 @@ class SerialPort{
 public:
     SerialPort( );
     void begin(long baudrate);
+    void setBaudrate(long baudrate);
+    long getBaudrate();
     bool send(unsigned char b);
+    bool send(const uint8_t* buf, uint8_t len);
     bool recv(unsigned char* b);
     void flush();
     bool checkRecvBuf();
 private:
     Stream* _serialDev;
+    long _baudrate;
 };
 #endif /* ARDUINO */
 
@@ -262,13 +336,17 @@ class SerialPort{
 public:
     SerialPort( );
     void begin(long baudrate);
+    void setBaudrate(long baudrate);
+    long getBaudrate();
     bool send(unsigned char b);
+    bool send(const uint8_t* buf, uint8_t len);
     bool recv(unsigned char* b);
     void flush();
     bool checkRecvBuf();
     void setBuff(void);
 private:
         Serial* _serialDev;
+        long _baudrate;
         uint8_t _data[RING_BUFFER_SIZE];
         int _head;
         int _tail;
@@ -290,15 +368,37 @@ public:
     int begin(const char* devName, unsigned int boaurate, bool parity);
     int begin(const char* devName, unsigned int boaurate,
                   bool parity, unsigned int stopbit);
+    int setBaudrate(unsigned int baudrate);
+    unsigned int getBaudrate();
+    int setLowLatency(bool on);
 
     bool send(unsigned char b);
+    bool send(const uint8_t* buf, uint8_t len);
     bool recv(unsigned char* b);
+    int  recv(uint8_t* buf, int len);
     bool checkRecvBuf();
+    bool waitRecv(uint32_t timeoutMillsec);
+    int  peek(uint8_t** buf);
+    void skip(int len);
     void flush();
     void putc(uint8_t c);
+    int  getFd();
+    int  sendPending();
+    int  getPendingCount();
 private:
-    int _fd;  // file descriptor
+    int  fillRecvBuf();
+    int  setSpeed(unsigned int baudrate, int action);
+    int _fd;  // file descriptor, non-blocking
     struct termios _tio;
+    unsigned int _baudrate;   // as given to setSpeed()
+    uint8_t _rxBuf[SERIAL_RECV_BUFFER_SIZE];  // receive ring buffer
+    int _rxHead;
+    int _rxTail;
+    int _rxCnt;
+    uint8_t _txBuf[SERIAL_SEND_BUFFER_SIZE];  // bytes not accepted by the port yet
+    int _txHead;
+    int _txTail;
+    int _txCnt;
 };
 #endif /* LINUX */
 
@@ -314,6 +414,8 @@ public:
     void start(uint32_t msec = 0);
     bool isTimeUp(uint32_t msec);
     bool isTimeUp(void);
+    uint32_t getRemain(uint32_t msec);
+    uint32_t getRemain(void);
     void stop();
 private:
     uint32_t _startTime;
@@ -332,6 +434,8 @@ public:
     void start(uint32_t msec = 0);
     bool isTimeUp(uint32_t msec);
     bool isTimeUp(void);
+    uint32_t getRemain(uint32_t msec);
+    uint32_t getRemain(void);
     void stop();
 private:
     Timer    _timer;
@@ -350,30 +454,77 @@ public:
     void start(uint32_t msec = 0);
     bool isTimeUp(uint32_t msec);
     bool isTimeUp(void);
+    uint32_t getRemain(uint32_t msec);
+    uint32_t getRemain(void);
     void stop();
+    static uint64_t now();       // msec of CLOCK_MONOTONIC
 private:
-    struct timeval _startTime;
+    uint64_t _startTime;         // 0 while stopped
     uint32_t _millis;
 };
 #endif
 
 
+/*===========================================
+               Class  Network
+ ============================================*/
+/*
+ *  Datagram link between the Client and the Gateway.
+ *  A received message is passed to the Rx handler as a ZBResponse.
+ */
+class Network {
+public:
+    virtual ~Network(){}
+    virtual int  send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type) = 0;  // frame ID or PACKET_ERROR_NOT_SENT
+    virtual int  readPacket() = 0;
+    virtual bool waitPacket(uint32_t timeoutMillsec) = 0;
+    virtual void setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg) = 0;
+    virtual void setGwAddress() = 0;         // sender of the message in the Rx handler
+    virtual void addGwAddress(){}            // trust it as a standby Gateway
+    virtual uint8_t getMaxPayload() = 0;
+    virtual int  sendFrame(FrameBuf* frame, uint8_t option, SendReqType type){   // frame is kept
+        return send(frame->getData(), frame->getLength(), option, type);
+    }
+    virtual uint16_t getTxQueCount(){ return 0; }  // bytes held by the backpressure of the network
+    virtual uint16_t sendTxQue(){ return 0; }      // write them, returns the bytes still held
+#ifdef LINUX
+    virtual uint8_t getFds(int* fds, uint8_t size) = 0;  // descriptors to poll, 0 if none
+#endif
+};
+
 /*===========================================
                Class  ZBeeStack
  ============================================*/
-class ZBeeStack {
+class ZBeeStack : public Network {
 public:
     ZBeeStack();
     ~ZBeeStack();
 
-    void send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type);
+    int  send(uint8_t* xmitData, uint8_t dataLen, uint8_t option, SendReqType type);
+    int  sendFrame(FrameBuf* frame, uint8_t option, SendReqType type);
     int  readPacket();
+    bool waitPacket(uint32_t timeoutMillsec);
+    uint16_t parseApiFrame(uint8_t* buf, uint16_t len);
+    uint8_t  getRxQueCount();
+    uint8_t  getRxQueHighWater();
+    uint16_t getRxDropCount();
+    uint16_t getRxRejectCount();
 //    int  readResp();
 
 
     void setSerialPort(SerialPort *serialPort);
     void setGwAddress(XBeeAddress64& addr64, uint16_t addr16);
-    void setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode));
+    void setGwAddress();
+    bool addGwAddress(XBeeAddress64& addr64);
+    void addGwAddress();
+    bool isGwAddress(XBeeAddress64& addr64);
+    void setRxHandler(void (*callbackPtr)(ZBResponse* data, int* returnCode, void* arg), void* arg);
+    void setXmitStatusHandler(void (*callbackPtr)(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount, void* arg), void* arg);
+#ifdef LINUX
+    uint8_t getFds(int* fds, uint8_t size);
+    uint16_t getTxQueCount();
+    uint16_t sendTxQue();
+#endif
 
     XBeeAddress64& getRxRemoteAddress64();
     uint16_t       getRxRemoteAddress16();
@@ -383,46 +534,102 @@ public:
     ZBResponse*    getRxResponse();
 
     bool init(const char* nodeId);
+    bool initRadio();
+    int  atCommand(const char* cmd, const uint8_t* param, uint8_t paramLen,
+                   uint8_t* value, uint8_t valueSize);
+    XBeeAddress64& getMyAddress64();
+    uint16_t       getMyAddress16();
+    uint8_t        getMaxPayload();
+    int            getRssi();
 
 private:
-    void sendZBRequest(ZBRequest& request, SendReqType type);
+    friend class ZBeeStackTest;     // src/test/ParserTest.cpp
+    int  sendZBRequest(ZBRequest& request, SendReqType type);
+    uint8_t getNextFrameId();
+    void setAtResponse(ZBResponse* resp);
     int  packetHandle();
     void execCallback();
     void readApiFrame(void);
-    bool readApiFrame(uint16_t timeoutMillsec);
     void flush();
-    void resetResponse();
+    void setResponse(uint8_t checksum);
+    uint8_t* allocFrameBuf();
+    void freeFrameBuf(uint8_t* buf);
     bool read(uint8_t* buff);
-    bool write(uint8_t val);
-    void sendByte(uint8_t, bool escape);
+    bool write(uint8_t* buff, uint8_t len);
+    uint8_t escapeByte(uint8_t* pos, uint8_t b);
     uint8_t getAddrByte(uint8_t pos, SendReqType type);
+    uint8_t getGwHash(XBeeAddress64& addr64);
+    void    touchGwAddress(uint8_t i);
+    uint8_t getOldestGwAddress();
+    void    removeGwAddress(uint8_t i);
+    void setAddrHeader(SendReqType type);
 
     ZBRequest   _txRequest;
     ZBResponse  _rxResp;
     ZBRequest   _txRetryRequest;
     int         _returnCode;
 
-    uint8_t _rxPayloadBuf[MAX_PAYLOAD_SIZE];
-
     NodeStatus _nodeStatus;
 
-    ZBResponse _response;    //  Received data
+    ZBResponse _rxQue[ZB_RX_QUE_SIZE];      //  Received frames (FIFO)
+    uint8_t*   _rxQueBuf[ZB_RX_QUE_SIZE];   //  pool buffer of each frame
+    uint8_t    _rxQueHead;
+    uint8_t    _rxQueCnt;
+    uint8_t    _rxQueHighWater;
+    uint16_t   _rxDropCnt;
+    uint16_t   _rxRejectCnt;    // unicast frames not from a Gateway
 
-    uint8_t _pos;
-    uint8_t _byteData;
+    uint16_t _pos;            // frame parser state
     bool   _escape;
     uint8_t _checksumTotal;
-    uint16_t _addr16;
-    uint32_t _addr32;
-    uint8_t _responsePayload[MAX_PAYLOAD_SIZE];
+    uint16_t _frameLength;
+    uint8_t* _frameData;      // pool buffer of the frame being parsed
+
+    uint8_t _rxPool[ZB_RX_POOL_SIZE][ZB_MAX_FRAME_DATA];
+    uint32_t _rxPoolUsed;     // bit map of the buffers in use
     SerialPort *_serialPort;
     XBeeAddress64 _gwAddress64;
     uint16_t  _gwAddress16;
-
-    XTimer  _tm;
-
-    void (*_rxCallbackPtr)(ZBResponse* data, int* returnCode);
+    XBeeAddress64 _gwTable[ZB_GW_TABLE_SIZE];  // trusted Gateways, open addressing
+    uint8_t   _gwTableUsed;                    // bit map of the entries in use
+    uint8_t   _gwAge[ZB_GW_TABLE_SIZE];        // Gateways heard from since this one
+    uint8_t   _gwCnt;
+
+    uint8_t _txFrameBuf[ZB_TX_BUFFER_SIZE];
+    uint8_t _ucastHeader[ZB_ADDR_LENGTH * 2];  // escaped address of the Gateway
+    uint8_t _ucastAddr[ZB_ADDR_LENGTH];        // not escaped, for sendFrame()
+    uint8_t _bcastAddr[ZB_ADDR_LENGTH];
+    uint8_t _ucastHeaderLen;
+    uint8_t _ucastChecksum;                    // API ID + address
+    uint8_t _bcastHeader[ZB_ADDR_LENGTH * 2];  // escaped broadcast address
+    uint8_t _bcastHeaderLen;
+    uint8_t _bcastChecksum;
+    uint8_t _frameId;                          // ID of the last transmit request
+
+    uint8_t  _atFrameId;      // AT command waiting for the response
+    uint8_t  _atStatus;
+    uint8_t* _atValue;
+    uint8_t  _atValueSize;
+    uint8_t  _atValueLen;
+
+    XBeeAddress64 _myAddress64;  // SH & SL of the radio
+    uint16_t _myAddress16;       // MY
+    uint8_t  _maxPayload;        // NP, limited to MAX_PAYLOAD_SIZE
+
+    void (*_rxCallbackPtr)(ZBResponse* data, int* returnCode, void* arg);
+    void (*_xmitStatusCallbackPtr)(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount, void* arg);
+    void* _rxCallbackArg;      // owner of the handlers, ex) MqttsClient
+    void* _xmitStatusCallbackArg;
 };
 
+/*===========================================
+    Escape & Checksum kernels (API mode 2)
+ ============================================*/
+uint16_t zbEscape(uint8_t* dst, const uint8_t* src, uint16_t len, uint8_t* checksum);
+uint16_t zbUnescape(uint8_t* dst, uint16_t dstLen, const uint8_t* src, uint16_t srcLen,
+                    uint16_t* srcUsed, bool* escape, uint8_t* checksum);
+uint8_t  zbChecksum(const uint8_t* buf, uint16_t len);
+
 }
+
 #endif  /* ZBEESTACK_H_ */
@@ -0,0 +1,558 @@
+/*
+ * GatewayEmulator.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "GatewayEmulator.h"
+#include <string.h>
+
+static uint16_t getUint16(uint8_t* pos){
+    return (pos[0] << 8) + pos[1];
+}
+
+static void setUint16(uint8_t* pos, uint16_t val){
+    pos[0] = val >> 8;
+    pos[1] = val & 0xff;
+}
+
+/*=====================================
+        Class GatewayEmulator
+ ======================================*/
+/*
+ *  Create the emulator before any other radio, so that it is the coordinator.
+ */
+GatewayEmulator::GatewayEmulator(XBeeSimulator* sim, uint32_t addrMsb, uint32_t addrLsb, uint8_t gwId){
+    initialize(gwId);
+    _sim = sim;
+    _radio = sim->addLocalRadio(addrMsb, addrLsb, 0x0000, this);
+}
+
+/*
+ *  For a subclass on another link, which overrides transmit(), lock() and unlock().
+ */
+GatewayEmulator::GatewayEmulator(uint8_t gwId){
+    initialize(gwId);
+}
+
+void GatewayEmulator::initialize(uint8_t gwId){
+    _sim = 0;
+    _radio = -1;
+    _gwId = gwId;
+    _delay = 0;
+    _congestion = 0;
+    _invalidTopic = 0;
+    _reqCnt = 0;
+    _topicReqCnt = 0;
+    _duration = 0;
+    _topicCnt = 0;
+    memset(_client, 0, sizeof(_client));
+    memset(_recvCnt, 0, sizeof(_recvCnt));
+    memset(_sendCnt, 0, sizeof(_sendCnt));
+}
+
+GatewayEmulator::~GatewayEmulator(){
+
+}
+
+/*
+ *  Time from a request to its response, usec.
+ */
+void GatewayEmulator::setResponseDelay(uint32_t usec){
+    _delay = usec;
+}
+
+/*
+ *  Reject every Nth CONNECT, REGISTER, SUBSCRIBE and QoS1 PUBLISH
+ *  with "Rejected: congestion". 0 disables it.
+ */
+void GatewayEmulator::setCongestion(uint16_t every){
+    _congestion = every;
+    _reqCnt = 0;
+}
+
+/*
+ *  Reject every Nth REGISTER and PUBLISH with "Rejected: invalid topic ID".
+ */
+void GatewayEmulator::setInvalidTopic(uint16_t every){
+    _invalidTopic = every;
+    _topicReqCnt = 0;
+}
+
+void GatewayEmulator::setAdvertiseDuration(uint16_t sec){
+    _duration = sec;
+}
+
+int GatewayEmulator::getRadio(){
+    return _radio;
+}
+
+uint32_t GatewayEmulator::getRecvCount(uint8_t msgType){
+    return msgType < GWE_MSGTYPE_CNT ? _recvCnt[msgType] : 0;
+}
+
+uint32_t GatewayEmulator::getSendCount(uint8_t msgType){
+    return msgType < GWE_MSGTYPE_CNT ? _sendCnt[msgType] : 0;
+}
+
+uint8_t GatewayEmulator::getConnectedCount(){
+    uint8_t cnt = 0;
+    lock();
+    for (int i = 0; i < GWE_MAX_CLIENTS; i++){
+        if (_client[i].connected){
+            cnt++;
+        }
+    }
+    unlock();
+    return cnt;
+}
+
+/*
+ *  Lose all the sessions and topics like a rebooted Gateway, then ADVERTISE.
+ */
+void GatewayEmulator::restart(){
+    lock();
+    memset(_client, 0, sizeof(_client));
+    _topicCnt = 0;
+    unlock();
+    advertise();
+}
+
+void GatewayEmulator::advertise(){
+    uint8_t msg[5];
+    msg[0] = 5;
+    msg[1] = GWE_ADVERTISE;
+    msg[2] = _gwId;
+    setUint16(msg + 3, _duration);
+    lock();
+    broadcast(msg);
+    unlock();
+}
+
+/*
+ *  Publish to the connected clients which subscribe the topic.
+ *  A client which doesn't know the topic ID gets REGISTER first.
+ *  Returns the number of clients.
+ */
+int GatewayEmulator::publish(const char* topic, const uint8_t* data, uint8_t len, uint8_t qos){
+    int cnt = 0;
+    lock();
+    uint16_t topicId = getTopicId(topic, strlen(topic));
+    int idx = getTopicIndex(topicId);
+    for (int i = 0; idx >= 0 && i < GWE_MAX_CLIENTS; i++){
+        GweClient* cl = &_client[i];
+        for (int j = 0; cl->connected && j < GWE_MAX_SUBSCRIBE; j++){
+            if (cl->subscribe[j][0] && match(cl->subscribe[j], _topic[idx])){
+                pushPublish(cl, idx, qos, data, len);
+                cnt++;
+                break;
+            }
+        }
+    }
+    unlock();
+    return cnt;
+}
+
+/*
+ *  Called by the simulator with it locked.
+ */
+void GatewayEmulator::recv(uint32_t srcMsb, uint32_t srcLsb, uint16_t src16, uint8_t option,
+                           uint8_t* payload, uint16_t len){
+    if (len < 2 || payload[0] > len || payload[0] < 2){
+        return;
+    }
+    uint8_t  msgType = payload[1];
+    uint8_t* body = payload + 2;
+    uint8_t  bodyLen = payload[0] - 2;
+    uint8_t  msg[GWE_MSG_SIZE];
+
+    if (msgType < GWE_MSGTYPE_CNT){
+        _recvCnt[msgType]++;
+    }
+
+    if (msgType == GWE_ADVERTISE || msgType == GWE_GWINFO){
+        return;                                       // from another Gateway, or our own
+    }
+    if (msgType == GWE_SEARCHGW){
+        msg[0] = 3;
+        msg[1] = GWE_GWINFO;
+        msg[2] = _gwId;
+        broadcast(msg);
+        return;
+    }
+
+    if (msgType == GWE_PUBLISH && bodyLen >= 5 &&
+        (body[0] & GWE_FLAG_QOS_MASK) == GWE_FLAG_QOS_N1){    // needs no session
+        forward(getUint16(body + 1), 0, body + 5, bodyLen - 5);
+        return;
+    }
+
+    GweClient* cl = getClient(srcMsb, srcLsb);
+    if (cl == 0){
+        return;                                       // no room
+    }
+
+    if (msgType == GWE_CONNECT){
+        if (bodyLen < 4){
+            return;
+        }
+        cl->connected = false;
+        cl->known = 0;
+        memset(cl->subscribe, 0, sizeof(cl->subscribe));
+        if (isCongested()){
+            msg[0] = GWE_RC_CONGESTION;
+            reply(cl, GWE_CONNACK, msg, 1);
+        }else if (body[0] & GWE_FLAG_WILL){
+            reply(cl, GWE_WILLTOPICREQ, msg, 0);
+        }else{
+            cl->connected = true;
+            msg[0] = GWE_RC_ACCEPTED;
+            reply(cl, GWE_CONNACK, msg, 1);
+        }
+        return;
+    }
+    if (msgType == GWE_WILLTOPIC){
+        reply(cl, GWE_WILLMSGREQ, msg, 0);
+        return;
+    }
+    if (msgType == GWE_WILLMSG){
+        cl->connected = true;
+        msg[0] = GWE_RC_ACCEPTED;
+        reply(cl, GWE_CONNACK, msg, 1);
+        return;
+    }
+
+    if (!cl->connected){
+        if (msgType != GWE_DISCONNECT){
+            reply(cl, GWE_DISCONNECT, msg, 0);        // ex) after restart()
+        }
+        return;
+    }
+
+    switch (msgType){
+    case GWE_REGISTER:
+        if (bodyLen < 5){
+            return;
+        }
+        memcpy(msg + 2, body + 2, 2);                 // MsgId
+        if (isCongested()){
+            setUint16(msg, 0);
+            msg[4] = GWE_RC_CONGESTION;
+        }else if (isInvalidTopic()){
+            setUint16(msg, 0);
+            msg[4] = GWE_RC_INVALID_TOPIC_ID;
+        }else{
+            uint8_t* name;
+            uint8_t nameLen;
+            getTopicName(GWE_TOPIC_NORMAL, body + 4, bodyLen - 4, &name, &nameLen);
+            uint16_t topicId = getTopicId((char*)name, nameLen);
+            setUint16(msg, topicId);
+            msg[4] = topicId ? GWE_RC_ACCEPTED : GWE_RC_CONGESTION;
+            if (topicId){
+                cl->known |= 1UL << getTopicIndex(topicId);
+            }
+        }
+        reply(cl, GWE_REGACK, msg, 5);
+        break;
+
+    case GWE_PUBLISH:{
+        if (bodyLen < 5){
+            return;
+        }
+        uint8_t qos = body[0] & GWE_FLAG_QOS_MASK;
+        uint16_t topicId = getUint16(body + 1);
+        uint8_t rc = GWE_RC_ACCEPTED;
+        if (qos && isCongested()){
+            rc = GWE_RC_CONGESTION;
+        }else if (isInvalidTopic()){
+            rc = GWE_RC_INVALID_TOPIC_ID;
+        }else if ((body[0] & GWE_TOPIC_TYPE) == GWE_TOPIC_NORMAL && getTopicIndex(topicId) < 0){
+            rc = GWE_RC_INVALID_TOPIC_ID;
+        }
+        if (qos == GWE_FLAG_QOS_1 || rc != GWE_RC_ACCEPTED){
+            memcpy(msg, body + 1, 4);                 // TopicId, MsgId
+            msg[4] = rc;
+            reply(cl, GWE_PUBACK, msg, 5);
+        }
+        if (rc == GWE_RC_ACCEPTED){
+            forward(topicId, qos, body + 5, bodyLen - 5);
+        }
+        break;
+    }
+    case GWE_SUBSCRIBE:{
+        if (bodyLen < 4){
+            return;
+        }
+        uint8_t* name;
+        uint8_t nameLen;
+        getTopicName(body[0], body + 3, bodyLen - 3, &name, &nameLen);
+        uint16_t topicId = 0;
+        uint8_t rc = GWE_RC_ACCEPTED;
+        int slot = -1;
+
+        if ((body[0] & GWE_TOPIC_TYPE) == GWE_TOPIC_PREDEFINED){
+            topicId = getUint16(name);
+        }else if (nameLen >= GWE_TOPIC_LEN){
+            rc = GWE_RC_INVALID_TOPIC_ID;
+        }else if (isCongested()){
+            rc = GWE_RC_CONGESTION;
+        }else{
+            for (int i = 0; i < GWE_MAX_SUBSCRIBE && slot < 0; i++){
+                if (cl->subscribe[i][0] == 0 ||
+                    (strncmp(cl->subscribe[i], (char*)name, nameLen) == 0 && cl->subscribe[i][nameLen] == 0)){
+                    slot = i;
+                }
+            }
+            if (slot < 0){
+                rc = GWE_RC_CONGESTION;
+            }else{
+                memcpy(cl->subscribe[slot], name, nameLen);
+                cl->subscribe[slot][nameLen] = 0;
+                if (memchr(name, '+', nameLen) == 0 && memchr(name, '#', nameLen) == 0){
+                    topicId = getTopicId((char*)name, nameLen);
+                    if (topicId){
+                        cl->known |= 1UL << getTopicIndex(topicId);
+                    }
+                }
+            }
+        }
+        msg[0] = body[0] & GWE_FLAG_QOS_MASK;
+        setUint16(msg + 1, topicId);
+        memcpy(msg + 3, body + 1, 2);                 // MsgId
+        msg[5] = rc;
+        reply(cl, GWE_SUBACK, msg, 6);
+        break;
+    }
+    case GWE_UNSUBSCRIBE:{
+        if (bodyLen < 4){
+            return;
+        }
+        uint8_t* name;
+        uint8_t nameLen;
+        getTopicName(body[0], body + 3, bodyLen - 3, &name, &nameLen);
+        for (int i = 0; i < GWE_MAX_SUBSCRIBE; i++){
+            if (strncmp(cl->subscribe[i], (char*)name, nameLen) == 0 && cl->subscribe[i][nameLen] == 0){
+                cl->subscribe[i][0] = 0;
+            }
+        }
+        memcpy(msg, body + 1, 2);
+        reply(cl, GWE_UNSUBACK, msg, 2);
+        break;
+    }
+    case GWE_PINGREQ:
+        reply(cl, GWE_PINGRESP, msg, 0);
+        break;
+
+    case GWE_DISCONNECT:
+        cl->connected = false;
+        reply(cl, GWE_DISCONNECT, msg, 0);
+        break;
+
+    default:
+        break;                                        // PUBACK, REGACK from the client
+    }
+}
+
+GweClient* GatewayEmulator::getClient(uint32_t msb, uint32_t lsb){
+    GweClient* free = 0;
+    for (int i = 0; i < GWE_MAX_CLIENTS; i++){
+        if (_client[i].active){
+            if (_client[i].addrMsb == msb && _client[i].addrLsb == lsb){
+                return &_client[i];
+            }
+        }else if (free == 0){
+            free = &_client[i];
+        }
+    }
+    if (free){
+        free->active = true;
+        free->addrMsb = msb;
+        free->addrLsb = lsb;
+    }
+    return free;
+}
+
+/*
+ *  Topic ID of the name, registered if it is new. 0 when the table is full.
+ */
+uint16_t GatewayEmulator::getTopicId(const char* name, uint8_t len){
+    if (len == 0 || len >= GWE_TOPIC_LEN){
+        return 0;
+    }
+    for (uint8_t i = 0; i < _topicCnt; i++){
+        if (strncmp(_topic[i], name, len) == 0 && _topic[i][len] == 0){
+            return GWE_TOPICID_NORMAL + i;
+        }
+    }
+    if (_topicCnt == GWE_MAX_TOPICS){
+        return 0;
+    }
+    memcpy(_topic[_topicCnt], name, len);
+    _topic[_topicCnt][len] = 0;
+    return GWE_TOPICID_NORMAL + _topicCnt++;
+}
+
+int GatewayEmulator::getTopicIndex(uint16_t topicId){
+    if (topicId < GWE_TOPICID_NORMAL || topicId >= GWE_TOPICID_NORMAL + _topicCnt){
+        return -1;
+    }
+    return topicId - GWE_TOPICID_NORMAL;
+}
+
+/*
+ *  Topic name of REGISTER, SUBSCRIBE and UNSUBSCRIBE. The client writes a name
+ *  with a 2 bytes length in front, which is removed. A registered topic ID
+ *  in place of the name is taken as the topic, whatever the topic type is.
+ */
+void GatewayEmulator::getTopicName(uint8_t flags, uint8_t* buf, uint8_t len, uint8_t** name, uint8_t* nameLen){
+    *name = buf;
+    *nameLen = len;
+    if (len >= 2 && getUint16(buf) == len - 2){
+        *name = buf + 2;
+        *nameLen = len - 2;
+    }else if ((flags & GWE_TOPIC_TYPE) != GWE_TOPIC_PREDEFINED && len == 2){
+        int idx = getTopicIndex(getUint16(buf));
+        if (idx >= 0){
+            *name = (uint8_t*)_topic[idx];
+            *nameLen = strlen(_topic[idx]);
+        }
+    }
+}
+
+bool GatewayEmulator::isCongested(){
+    return _congestion && ++_reqCnt % _congestion == 0;
+}
+
+bool GatewayEmulator::isInvalidTopic(){
+    return _invalidTopic && ++_topicReqCnt % _invalidTopic == 0;
+}
+
+/*
+ *  Topic filter with + and # wildcards.
+ */
+bool GatewayEmulator::match(const char* filter, const char* topic){
+    while (*filter){
+        if (*filter == '#'){
+            return true;
+        }
+        if (*filter == '+'){
+            while (*topic && *topic != '/'){
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (*filter != *topic){
+            return false;
+        }
+        filter++;
+        topic++;
+    }
+    return *topic == 0;
+}
+
+/*
+ *  Deliver a PUBLISH of a registered topic to the subscribers.
+ */
+void GatewayEmulator::forward(uint16_t topicId, uint8_t qos, uint8_t* data, uint8_t len){
+    int idx = getTopicIndex(topicId);
+    if (idx < 0){
+        return;
+    }
+    for (int i = 0; i < GWE_MAX_CLIENTS; i++){
+        GweClient* cl = &_client[i];
+        for (int j = 0; cl->connected && j < GWE_MAX_SUBSCRIBE; j++){
+            if (cl->subscribe[j][0] && match(cl->subscribe[j], _topic[idx])){
+                pushPublish(cl, idx, qos, data, len);
+                break;
+            }
+        }
+    }
+}
+
+void GatewayEmulator::pushPublish(GweClient* cl, int topic, uint8_t qos, const uint8_t* data, uint8_t len){
+    uint8_t msg[GWE_MSG_SIZE];
+    uint16_t topicId = GWE_TOPICID_NORMAL + topic;
+
+    if ((cl->known & (1UL << topic)) == 0){
+        uint8_t nameLen = strlen(_topic[topic]);
+        msg[0] = 8 + nameLen;
+        msg[1] = GWE_REGISTER;
+        setUint16(msg + 2, topicId);
+        setUint16(msg + 4, ++cl->msgId);
+        setUint16(msg + 6, nameLen);                  // as the client reads it
+        memcpy(msg + 8, _topic[topic], nameLen);
+        send(cl, msg);
+        cl->known |= 1UL << topic;
+    }
+    if (len > GWE_MSG_SIZE - 7){
+        len = GWE_MSG_SIZE - 7;
+    }
+    msg[0] = 7 + len;
+    msg[1] = GWE_PUBLISH;
+    msg[2] = (qos == GWE_FLAG_QOS_1 ? GWE_FLAG_QOS_1 : 0) | GWE_TOPIC_NORMAL;
+    setUint16(msg + 3, topicId);
+    setUint16(msg + 5, qos == GWE_FLAG_QOS_1 ? ++cl->msgId : 0);
+    memcpy(msg + 7, data, len);
+    send(cl, msg);
+}
+
+void GatewayEmulator::reply(GweClient* cl, uint8_t type, uint8_t* body, uint8_t bodyLen){
+    uint8_t msg[GWE_MSG_SIZE];
+    msg[0] = 2 + bodyLen;
+    msg[1] = type;
+    memcpy(msg + 2, body, bodyLen);
+    send(cl, msg);
+}
+
+/*
+ *  The serial line of the receiver keeps the order of messages sent in a row.
+ */
+void GatewayEmulator::send(GweClient* cl, uint8_t* msg){
+    if (msg[1] < GWE_MSGTYPE_CNT){
+        _sendCnt[msg[1]]++;
+    }
+    transmit(cl->addrMsb, cl->addrLsb, msg, _delay);
+}
+
+void GatewayEmulator::transmit(uint32_t msb, uint32_t lsb, uint8_t* msg, uint32_t delay){
+    _sim->transmit(_radio, msb, lsb, msg, msg[0], delay);
+}
+
+void GatewayEmulator::lock(){
+    _sim->lock();
+}
+
+void GatewayEmulator::unlock(){
+    _sim->unlock();
+}
+
+void GatewayEmulator::broadcast(uint8_t* msg){
+    if (msg[1] < GWE_MSGTYPE_CNT){
+        _sendCnt[msg[1]]++;
+    }
+    transmit(0, GWE_BROADCAST_LSB, msg, _delay);
+}
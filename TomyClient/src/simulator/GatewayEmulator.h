@@ -0,0 +1,165 @@
+/*
+ * GatewayEmulator.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *
+ *  In-process MQTT-SN Gateway stand-in on a radio of XBeeSimulator.
+ *  It answers the whole message flow of a client and can push
+ *  REGISTER + PUBLISH and ADVERTISE. Knobs inject response delay,
+ *  congestion, invalid topic rejections and restarts.
+ *  Constants are defined here, not taken from mqttslib, so that
+ *  the client is checked against an independent peer.
+ */
+
+#ifndef GATEWAYEMULATOR_H_
+#define GATEWAYEMULATOR_H_
+
+#include "XBeeSimulator.h"
+
+#define GWE_MAX_CLIENTS        8
+#define GWE_MAX_TOPICS        32    // bits of GweClient::known
+#define GWE_MAX_SUBSCRIBE      8
+#define GWE_TOPIC_LEN         48
+#define GWE_MSG_SIZE          90
+#define GWE_TOPICID_NORMAL   256    // first Id given to a topic name
+#define GWE_MSGTYPE_CNT     0x20
+#define GWE_BROADCAST_LSB   0x0000ffff   // with MSB 0
+
+/*---- Message types ----*/
+#define GWE_ADVERTISE     0x00
+#define GWE_SEARCHGW      0x01
+#define GWE_GWINFO        0x02
+#define GWE_CONNECT       0x04
+#define GWE_CONNACK       0x05
+#define GWE_WILLTOPICREQ  0x06
+#define GWE_WILLTOPIC     0x07
+#define GWE_WILLMSGREQ    0x08
+#define GWE_WILLMSG       0x09
+#define GWE_REGISTER      0x0A
+#define GWE_REGACK        0x0B
+#define GWE_PUBLISH       0x0C
+#define GWE_PUBACK        0x0D
+#define GWE_SUBSCRIBE     0x12
+#define GWE_SUBACK        0x13
+#define GWE_UNSUBSCRIBE   0x14
+#define GWE_UNSUBACK      0x15
+#define GWE_PINGREQ       0x16
+#define GWE_PINGRESP      0x17
+#define GWE_DISCONNECT    0x18
+
+/*---- Flags ----*/
+#define GWE_FLAG_QOS_MASK   0x60
+#define GWE_FLAG_QOS_1      0x20
+#define GWE_FLAG_QOS_N1     0x60
+#define GWE_FLAG_WILL       0x08
+#define GWE_TOPIC_TYPE      0x03
+#define GWE_TOPIC_NORMAL    0x00
+#define GWE_TOPIC_PREDEFINED 0x01
+#define GWE_TOPIC_SHORT     0x02
+
+/*---- Return codes ----*/
+#define GWE_RC_ACCEPTED          0x00
+#define GWE_RC_CONGESTION        0x01
+#define GWE_RC_INVALID_TOPIC_ID  0x02
+
+/*=====================================
+        Struct GweClient
+ ======================================*/
+struct GweClient {
+    uint32_t addrMsb;
+    uint32_t addrLsb;
+    bool     active;               // slot in use
+    bool     connected;
+    uint16_t msgId;
+    uint32_t known;                // bit map of the topics the client knows the Id of
+    char     subscribe[GWE_MAX_SUBSCRIBE][GWE_TOPIC_LEN];
+};
+
+/*=====================================
+        Class GatewayEmulator
+ ======================================*/
+class GatewayEmulator : public XSimNode {
+public:
+    GatewayEmulator(XBeeSimulator* sim, uint32_t addrMsb, uint32_t addrLsb, uint8_t gwId = 1);
+    virtual ~GatewayEmulator();
+
+    void recv(uint32_t srcMsb, uint32_t srcLsb, uint16_t src16, uint8_t option,
+              uint8_t* payload, uint16_t len);
+
+    void setResponseDelay(uint32_t usec);
+    void setCongestion(uint16_t every);
+    void setInvalidTopic(uint16_t every);
+    void setAdvertiseDuration(uint16_t sec);
+
+    void restart();
+    void advertise();
+    int  publish(const char* topic, const uint8_t* data, uint8_t len, uint8_t qos);
+
+    int      getRadio();
+    uint32_t getRecvCount(uint8_t msgType);
+    uint32_t getSendCount(uint8_t msgType);
+    uint8_t  getConnectedCount();
+
+protected:
+    GatewayEmulator(uint8_t gwId);
+    virtual void transmit(uint32_t msb, uint32_t lsb, uint8_t* msg, uint32_t delay);
+    virtual void lock();
+    virtual void unlock();
+
+private:
+    void     initialize(uint8_t gwId);
+    GweClient* getClient(uint32_t msb, uint32_t lsb);
+    uint16_t getTopicId(const char* name, uint8_t len);
+    int      getTopicIndex(uint16_t topicId);
+    void     getTopicName(uint8_t flags, uint8_t* buf, uint8_t len, uint8_t** name, uint8_t* nameLen);
+    bool     isCongested();
+    bool     isInvalidTopic();
+    bool     match(const char* filter, const char* topic);
+    void     forward(uint16_t topicId, uint8_t qos, uint8_t* data, uint8_t len);
+    void     pushPublish(GweClient* client, int topic, uint8_t qos, const uint8_t* data, uint8_t len);
+    void     send(GweClient* client, uint8_t* msg);
+    void     broadcast(uint8_t* msg);
+    void     reply(GweClient* client, uint8_t type, uint8_t* body, uint8_t bodyLen);
+
+    XBeeSimulator* _sim;
+    int       _radio;
+    uint8_t   _gwId;
+    uint32_t  _delay;
+    uint16_t  _congestion;
+    uint16_t  _invalidTopic;
+    uint16_t  _reqCnt;
+    uint16_t  _topicReqCnt;
+    uint16_t  _duration;
+
+    GweClient _client[GWE_MAX_CLIENTS];
+    char      _topic[GWE_MAX_TOPICS][GWE_TOPIC_LEN];
+    uint8_t   _topicCnt;
+
+    uint32_t  _recvCnt[GWE_MSGTYPE_CNT];
+    uint32_t  _sendCnt[GWE_MSGTYPE_CNT];
+};
+
+#endif /* GATEWAYEMULATOR_H_ */
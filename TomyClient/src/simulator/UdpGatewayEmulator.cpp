@@ -0,0 +1,248 @@
+/*
+ * UdpGatewayEmulator.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#include "UdpGatewayEmulator.h"
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+/*=====================================
+        Class UdpGatewayEmulator
+ ======================================*/
+UdpGatewayEmulator::UdpGatewayEmulator(uint8_t gwId) : GatewayEmulator(gwId){
+    _sockfd = _bcastfd = -1;
+    memset(&_bcastAddr, 0, sizeof(_bcastAddr));
+    _pendingCnt = 0;
+    _running = false;
+    _threadStarted = false;
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+UdpGatewayEmulator::~UdpGatewayEmulator(){
+    stop();
+    if (_sockfd >= 0){
+        close(_sockfd);
+    }
+    if (_bcastfd >= 0){
+        close(_bcastfd);
+    }
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*
+ *  port : unicast port of the Gateway.
+ *  bcastAddr, bcastPort : SEARCHGW is received and GWINFO, ADVERTISE are sent there.
+ *  Returns 0, or -1.
+ */
+int UdpGatewayEmulator::open(uint16_t port, const char* bcastAddr, uint16_t bcastPort){
+    struct sockaddr_in addr;
+    int on = 1;
+
+    _bcastAddr.sin_family = AF_INET;
+    _bcastAddr.sin_port = htons(bcastPort);
+    if (inet_aton(bcastAddr, &_bcastAddr.sin_addr) == 0){
+        return -1;
+    }
+    bool multicast = IN_MULTICAST(ntohl(_bcastAddr.sin_addr.s_addr));
+
+    _sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    _bcastfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_sockfd < 0 || _bcastfd < 0){
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        return -1;
+    }
+    if (multicast){
+        uint8_t loop = 1;
+        setsockopt(_sockfd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    }else{
+        setsockopt(_sockfd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    }
+
+    setsockopt(_bcastfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    addr.sin_port = htons(bcastPort);
+    if (multicast){
+        addr.sin_addr = _bcastAddr.sin_addr;
+    }
+    if (bind(_bcastfd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        return -1;
+    }
+    if (multicast){
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = _bcastAddr.sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(_bcastfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int UdpGatewayEmulator::start(){
+    _running = true;
+    if (pthread_create(&_thread, NULL, threadMain, this) != 0){
+        _running = false;
+        return -1;
+    }
+    _threadStarted = true;
+    return 0;
+}
+
+void UdpGatewayEmulator::stop(){
+    _running = false;
+    if (_threadStarted){
+        pthread_join(_thread, NULL);
+        _threadStarted = false;
+    }
+}
+
+void* UdpGatewayEmulator::threadMain(void* gw){
+    ((UdpGatewayEmulator*)gw)->run();
+    return NULL;
+}
+
+void UdpGatewayEmulator::run(){
+    _running = true;
+    while (_running){
+        exec(100);
+    }
+}
+
+/*
+ *  Wait for datagrams or the time of a delayed response, then handle both.
+ */
+void UdpGatewayEmulator::exec(int timeoutMillsec){
+    struct pollfd fds[2];
+    fds[0].fd = _sockfd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _bcastfd;
+    fds[1].events = POLLIN;
+
+    lock();
+    int timeout = getTimeout(timeoutMillsec);
+    unlock();
+    int rc = poll(fds, 2, timeout);
+
+    lock();
+    if (rc > 0){
+        for (int i = 0; i < 2; i++){
+            if (fds[i].revents & POLLIN){
+                receive(fds[i].fd);
+            }
+        }
+    }
+    flushDue();
+    unlock();
+}
+
+void UdpGatewayEmulator::receive(int sockfd){
+    uint8_t buf[GWE_MSG_SIZE];
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int len;
+    while ((len = recvfrom(sockfd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr*)&addr, &addrLen)) > 0){
+        recv(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port), 0, 0, buf, len);
+        addrLen = sizeof(addr);
+    }
+}
+
+/*
+ *  Called with the emulator locked.
+ */
+void UdpGatewayEmulator::transmit(uint32_t msb, uint32_t lsb, uint8_t* msg, uint32_t delay){
+    struct sockaddr_in addr;
+    if (msb == 0 && lsb == GWE_BROADCAST_LSB){
+        addr = _bcastAddr;
+    }else{
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(msb);
+        addr.sin_port = htons(lsb);
+    }
+    if (delay == 0){
+        sendto(_sockfd, msg, msg[0], 0, (struct sockaddr*)&addr, sizeof(addr));
+    }else if (_pendingCnt < UGWE_MAX_PENDING){
+        UgweFrame* f = &_pending[_pendingCnt++];
+        f->due = now() + delay;
+        f->addr = addr;
+        f->len = msg[0];
+        memcpy(f->data, msg, msg[0]);
+    }
+}
+
+/*
+ *  Send the delayed messages which are due, in the order they were sent.
+ */
+void UdpGatewayEmulator::flushDue(){
+    uint64_t t = now();
+    uint16_t i = 0;
+    while (i < _pendingCnt && _pending[i].due <= t){
+        i++;
+    }
+    for (uint16_t j = 0; j < i; j++){
+        sendto(_sockfd, _pending[j].data, _pending[j].len, 0,
+               (struct sockaddr*)&_pending[j].addr, sizeof(struct sockaddr_in));
+    }
+    memmove(_pending, _pending + i, (_pendingCnt - i) * sizeof(UgweFrame));
+    _pendingCnt -= i;
+}
+
+int UdpGatewayEmulator::getTimeout(int maxMillsec){
+    if (_pendingCnt == 0){
+        return maxMillsec;
+    }
+    uint64_t t = now();
+    if (_pending[0].due <= t){
+        return 0;
+    }
+    int timeout = (_pending[0].due - t + 999) / 1000;
+    return timeout < maxMillsec ? timeout : maxMillsec;
+}
+
+uint64_t UdpGatewayEmulator::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void UdpGatewayEmulator::lock(){
+    pthread_mutex_lock(&_mutex);
+}
+
+void UdpGatewayEmulator::unlock(){
+    pthread_mutex_unlock(&_mutex);
+}
@@ -0,0 +1,89 @@
+/*
+ * UdpGatewayEmulator.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  GatewayEmulator on UDP, to test UdpStack on loopback.
+ *  A client is addressed by IPv4 address (MSB) and port (LSB).
+ *  Linux only.
+ */
+
+#ifndef UDPGATEWAYEMULATOR_H_
+#define UDPGATEWAYEMULATOR_H_
+
+#include "GatewayEmulator.h"
+#include <netinet/in.h>
+
+#define UGWE_MAX_PENDING  64     // delayed messages
+
+/*=====================================
+        Struct UgweFrame
+ ======================================*/
+struct UgweFrame {
+    uint64_t due;
+    struct sockaddr_in addr;
+    uint8_t  len;
+    uint8_t  data[GWE_MSG_SIZE];
+};
+
+/*=====================================
+        Class UdpGatewayEmulator
+ ======================================*/
+class UdpGatewayEmulator : public GatewayEmulator {
+public:
+    UdpGatewayEmulator(uint8_t gwId = 1);
+    ~UdpGatewayEmulator();
+
+    int  open(uint16_t port, const char* bcastAddr, uint16_t bcastPort);
+    int  start();                    // run in a thread
+    void stop();
+    void run();                      // run in the caller until stop()
+    void exec(int timeoutMillsec);   // one pass of the loop
+
+protected:
+    void transmit(uint32_t msb, uint32_t lsb, uint8_t* msg, uint32_t delay);
+    void lock();
+    void unlock();
+
+private:
+    static void* threadMain(void* gw);
+    void receive(int sockfd);
+    void flushDue();
+    int  getTimeout(int maxMillsec);
+    uint64_t now();
+
+    int       _sockfd;
+    int       _bcastfd;
+    struct sockaddr_in _bcastAddr;
+    UgweFrame _pending[UGWE_MAX_PENDING];
+    uint16_t  _pendingCnt;
+
+    volatile bool _running;
+    pthread_mutex_t _mutex;
+    pthread_t _thread;
+    bool      _threadStarted;
+};
+
+#endif /* UDPGATEWAYEMULATOR_H_ */
@@ -0,0 +1,648 @@
+/*
+ * XBeeSimulator.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE          // ppoll()
+#endif
+
+#include "XBeeSimulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+
+#define START_BYTE 0x7e
+#define ESCAPE     0x7d
+#define XON        0x11
+#define XOFF       0x13
+
+#define XSIM_API_AT_COMMAND     0x08
+#define XSIM_API_AT_QUEUE       0x09
+#define XSIM_API_REQUEST        0x10
+#define XSIM_API_AT_RESPONSE    0x88
+#define XSIM_API_XMIT_STATUS    0x8B
+#define XSIM_API_RESPONSE       0x90
+
+#define XSIM_OPT_ACKNOWLEDGED   0x01
+#define XSIM_OPT_BROADCAST      0x02
+
+#define XSIM_AT_OK              0x00
+#define XSIM_AT_INVALID_COMMAND 0x02
+#define XSIM_AT_INVALID_PARAM   0x03
+
+#define XSIM_RSSI               0x28   // -40dBm
+
+static const uint32_t theBaudrate[] = {1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200,
+                                       230400, 460800, 921600};
+#define XSIM_BD_MAX  10
+
+static uint32_t getUint32(uint8_t* pos){
+    return ((uint32_t)pos[0] << 24) + ((uint32_t)pos[1] << 16) +
+           ((uint32_t)pos[2] <<  8) + pos[3];
+}
+
+static void setUint32(uint8_t* pos, uint32_t val){
+    pos[0] = (val >> 24) & 0xff;
+    pos[1] = (val >> 16) & 0xff;
+    pos[2] = (val >>  8) & 0xff;
+    pos[3] = val & 0xff;
+}
+
+static bool isEscaped(uint8_t b){
+    return b == START_BYTE || b == ESCAPE || b == XON || b == XOFF;
+}
+
+/*=====================================
+        Class XBeeSimulator
+ ======================================*/
+XBeeSimulator::XBeeSimulator(){
+    _radioCnt = 0;
+    _pendingCnt = 0;
+    _latency = XSIM_DEFAULT_LATENCY;
+    _baudrate = XSIM_DEFAULT_BAUDRATE;
+    _lossRate = 0;
+    _macRetries = 0;
+    _seed = 1;
+    _sentCnt = _deliveredCnt = _lostCnt = 0;
+    _running = false;
+    _threadStarted = false;
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+XBeeSimulator::~XBeeSimulator(){
+    stop();
+    for (int i = 0; i < _radioCnt; i++){
+        if (_radio[i].node == NULL){
+            close(_radio[i].fd);
+            close(_radio[i].slaveFd);
+        }
+    }
+    pthread_mutex_destroy(&_mutex);
+}
+
+/*
+ *  Open a pty for a new radio. Radio 0 is the coordinator.
+ *  Returns the index of the radio, or -1.
+ */
+int XBeeSimulator::addRadio(uint32_t addrMsb, uint32_t addrLsb, uint16_t addr16){
+    if (_radioCnt == XSIM_MAX_RADIOS){
+        return -1;
+    }
+    XSimRadio* r = &_radio[_radioCnt];
+    memset(r, 0, sizeof(XSimRadio));
+
+    r->fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (r->fd < 0 || grantpt(r->fd) < 0 || unlockpt(r->fd) < 0 ||
+        ptsname_r(r->fd, r->devName, XSIM_DEVNAME_LEN) != 0){
+        return -1;
+    }
+    r->slaveFd = open(r->devName, O_RDWR | O_NOCTTY);
+    if (r->slaveFd < 0){
+        close(r->fd);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(r->slaveFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(r->slaveFd, TCSANOW, &tio);
+    fcntl(r->fd, F_SETFL, fcntl(r->fd, F_GETFL) | O_NONBLOCK);
+
+    r->addrMsb = addrMsb;
+    r->addrLsb = addrLsb;
+    r->addr16 = addr16;
+    r->baudrate = _baudrate;
+    return _radioCnt++;
+}
+
+/*
+ *  Add a radio whose host runs in this process, ex) a Gateway emulator.
+ *  It has no serial line, so only the RF hops take time.
+ */
+int XBeeSimulator::addLocalRadio(uint32_t addrMsb, uint32_t addrLsb, uint16_t addr16, XSimNode* node){
+    if (_radioCnt == XSIM_MAX_RADIOS){
+        return -1;
+    }
+    XSimRadio* r = &_radio[_radioCnt];
+    memset(r, 0, sizeof(XSimRadio));
+    r->node = node;
+    r->fd = r->slaveFd = -1;       // ignored by poll()
+    r->addrMsb = addrMsb;
+    r->addrLsb = addrLsb;
+    r->addr16 = addr16;
+    return _radioCnt++;
+}
+
+/*
+ *  Send from a local radio after delay usec. Call it with the simulator
+ *  locked, which is the case in XSimNode::recv().
+ */
+void XBeeSimulator::transmit(int radio, uint32_t dstMsb, uint32_t dstLsb,
+                             const uint8_t* payload, uint16_t len, uint32_t delay){
+    sendRF(radio, 0, dstMsb, dstLsb, payload, len, now() + delay + _latency);
+}
+
+void XBeeSimulator::lock(){
+    pthread_mutex_lock(&_mutex);
+}
+
+void XBeeSimulator::unlock(){
+    pthread_mutex_unlock(&_mutex);
+}
+
+const char* XBeeSimulator::getDeviceName(int radio){
+    return _radio[radio].devName;
+}
+
+uint8_t XBeeSimulator::getRadioCount(){
+    return _radioCnt;
+}
+
+void XBeeSimulator::setLatency(uint32_t usec){
+    _latency = usec;
+}
+
+/*
+ *  Serial speed between a radio and its host, 0 for unlimited.
+ *  The host may change it with ATBD.
+ */
+void XBeeSimulator::setBaudrate(uint32_t bps){
+    _baudrate = bps;
+    for (int i = 0; i < _radioCnt; i++){
+        if (_radio[i].node == NULL){
+            _radio[i].baudrate = bps;
+        }
+    }
+}
+
+/*
+ *  Probability that one RF transmission is lost.
+ */
+void XBeeSimulator::setLossRate(double rate){
+    _lossRate = rate;
+}
+
+/*
+ *  MAC level retries of a unicast before a Network ACK failure.
+ */
+void XBeeSimulator::setMacRetries(uint8_t cnt){
+    _macRetries = cnt;
+}
+
+void XBeeSimulator::setSeed(unsigned int seed){
+    _seed = seed;
+}
+
+uint32_t XBeeSimulator::getSentCount(){
+    return _sentCnt;
+}
+
+uint32_t XBeeSimulator::getDeliveredCount(){
+    return _deliveredCnt;
+}
+
+uint32_t XBeeSimulator::getLostCount(){
+    return _lostCnt;
+}
+
+int XBeeSimulator::start(){
+    _running = true;
+    if (pthread_create(&_thread, NULL, threadMain, this) != 0){
+        _running = false;
+        return -1;
+    }
+    _threadStarted = true;
+    return 0;
+}
+
+void XBeeSimulator::stop(){
+    _running = false;
+    if (_threadStarted){
+        pthread_join(_thread, NULL);
+        _threadStarted = false;
+    }
+}
+
+void* XBeeSimulator::threadMain(void* sim){
+    ((XBeeSimulator*)sim)->run();
+    return NULL;
+}
+
+void XBeeSimulator::run(){
+    _running = true;
+    while (_running){
+        exec(100);
+    }
+}
+
+/*
+ *  Wait for frames from the hosts or the next delivery time,
+ *  then handle both.
+ */
+void XBeeSimulator::exec(int timeoutMillsec){
+    struct pollfd fds[XSIM_MAX_RADIOS];
+    for (int i = 0; i < _radioCnt; i++){
+        fds[i].fd = _radio[i].fd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    int timeout = getTimeout(timeoutMillsec);
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000000;
+    ts.tv_nsec = (timeout % 1000000) * 1000;
+
+    int rc = ppoll(fds, _radioCnt, &ts, NULL);
+
+    lock();
+    if (rc > 0){
+        for (int i = 0; i < _radioCnt; i++){
+            if (fds[i].revents & POLLIN){
+                recv(i);
+            }
+        }
+    }
+    flushDue();
+    unlock();
+}
+
+uint64_t XBeeSimulator::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*---------------------------------------
+ *   Frames from the host
+ ---------------------------------------*/
+void XBeeSimulator::recv(int radio){
+    uint8_t buf[256];
+    int len;
+    while ((len = read(_radio[radio].fd, buf, sizeof(buf))) > 0){
+        for (int i = 0; i < len; i++){
+            parse(radio, buf[i]);
+        }
+    }
+}
+
+void XBeeSimulator::parse(int radio, uint8_t data){
+    XSimRadio* r = &_radio[radio];
+
+    if (data == START_BYTE){
+        r->pos = 1;
+        r->escape = false;
+        r->checksum = 0;
+        return;
+    }
+    if (r->pos == 0){
+        return;
+    }
+    if (data == ESCAPE){
+        r->escape = true;
+        return;
+    }
+    if (r->escape){
+        data ^= 0x20;
+        r->escape = false;
+    }
+
+    if (r->pos == 1){
+        r->frameLen = (uint16_t)data << 8;
+    }else if (r->pos == 2){
+        r->frameLen += data;
+        if (r->frameLen == 0 || r->frameLen > XSIM_MAX_FRAME){
+            r->pos = 0;
+            return;
+        }
+    }else if (r->pos < r->frameLen + 3){
+        r->frame[r->pos - 3] = data;
+        r->checksum += data;
+    }else{
+        r->pos = 0;
+        if ((uint8_t)(r->checksum + data) == 0xff){
+            frameHandler(radio, r->frame, r->frameLen);
+        }
+        return;
+    }
+    r->pos++;
+}
+
+void XBeeSimulator::frameHandler(int radio, uint8_t* data, uint16_t len){
+    switch (data[0]){
+    case XSIM_API_REQUEST:
+        transmitRequest(radio, data, len);
+        break;
+    case XSIM_API_AT_COMMAND:
+    case XSIM_API_AT_QUEUE:
+        atCommand(radio, data, len);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ *  0x10: API ID, Frame ID, Address 64, Address 16, Radius, Option, Payload
+ */
+void XBeeSimulator::transmitRequest(int radio, uint8_t* data, uint16_t len){
+    if (len < 14){
+        return;
+    }
+    XSimRadio* r = &_radio[radio];
+
+    /*---- Serial line from the host, then one hop ----*/
+    uint64_t t = now();
+    if (r->upFree > t){
+        t = r->upFree;
+    }
+    t += wireTime(radio, data, len);
+    r->upFree = t;
+    sendRF(radio, data[1], getUint32(data + 2), getUint32(data + 6), data + 14, len - 14, t + _latency);
+}
+
+/*
+ *  The frame reaches the destination at t unless it is lost.
+ */
+void XBeeSimulator::sendRF(int radio, uint8_t frameId, uint32_t msb, uint32_t lsb,
+                           const uint8_t* payload, uint16_t len, uint64_t t){
+    _sentCnt++;
+
+    if (msb == 0 && lsb == XSIM_BROADCAST_LSB){
+        for (int i = 0; i < _radioCnt; i++){
+            if (i == radio){
+                continue;
+            }
+            if (isLost()){
+                _lostCnt++;
+            }else{
+                deliver(radio, i, XSIM_OPT_BROADCAST, payload, len, t);
+            }
+        }
+        xmitStatus(radio, frameId, 0, XSIM_DELIVERY_OK, t);
+        return;
+    }
+
+    int dst = (msb == 0 && lsb == 0) ? 0 : findRadio(msb, lsb);   // 0 is the coordinator
+    if (dst < 0 || dst == radio){
+        xmitStatus(radio, frameId, 0, XSIM_DELIVERY_NOT_FOUND, t);
+        return;
+    }
+    for (uint8_t retry = 0; retry <= _macRetries; retry++){
+        if (!isLost()){
+            deliver(radio, dst, XSIM_OPT_ACKNOWLEDGED, payload, len, t);
+            xmitStatus(radio, frameId, retry, XSIM_DELIVERY_OK, t + _latency);  // ACK comes back
+            return;
+        }
+        t += 2 * _latency;          // ACK timeout
+    }
+    _lostCnt++;
+    xmitStatus(radio, frameId, _macRetries, XSIM_DELIVERY_NACK, t);
+}
+
+/*
+ *  0x08: API ID, Frame ID, AT command, Parameter
+ */
+void XBeeSimulator::atCommand(int radio, uint8_t* data, uint16_t len){
+    if (len < 4){
+        return;
+    }
+    XSimRadio* r = &_radio[radio];
+    uint8_t* param = data + 4;
+    uint8_t paramLen = len - 4;
+    uint8_t resp[16];
+    uint8_t pos = 0;
+    resp[pos++] = XSIM_API_AT_RESPONSE;
+    resp[pos++] = data[1];
+    resp[pos++] = data[2];
+    resp[pos++] = data[3];
+    resp[pos++] = XSIM_AT_OK;
+    uint32_t newBaudrate = 0;
+
+    if (data[2] == 'S' && data[3] == 'H'){
+        setUint32(resp + pos, r->addrMsb);
+        pos += 4;
+    }else if (data[2] == 'S' && data[3] == 'L'){
+        setUint32(resp + pos, r->addrLsb);
+        pos += 4;
+    }else if (data[2] == 'M' && data[3] == 'Y'){
+        resp[pos++] = r->addr16 >> 8;
+        resp[pos++] = r->addr16 & 0xff;
+    }else if (data[2] == 'N' && data[3] == 'P'){
+        resp[pos++] = 0;
+        resp[pos++] = XSIM_MAX_PAYLOAD;
+    }else if (data[2] == 'D' && data[3] == 'B'){
+        resp[pos++] = XSIM_RSSI;
+    }else if (data[2] == 'B' && data[3] == 'D'){
+        if (paramLen){
+            uint32_t val = 0;
+            for (uint8_t i = 0; i < paramLen && i < 4; i++){
+                val = (val << 8) + param[i];
+            }
+            newBaudrate = val <= XSIM_BD_MAX ? theBaudrate[val] : val;   // non standard rate in bps
+        }else{
+            uint32_t val = r->baudrate;
+            for (uint8_t i = 0; i <= XSIM_BD_MAX; i++){
+                if (theBaudrate[i] == r->baudrate){
+                    val = i;
+                }
+            }
+            setUint32(resp + pos, val);
+            pos += 4;
+        }
+    }else if (paramLen == 0){
+        resp[4] = XSIM_AT_INVALID_COMMAND;
+    }
+
+    if (data[1]){
+        enqueue(radio, resp, pos, now());
+    }
+    if (newBaudrate){
+        r->baudrate = newBaudrate;     // after the response, as a radio does
+    }
+}
+
+void XBeeSimulator::xmitStatus(int radio, uint8_t frameId, uint8_t retries, uint8_t status, uint64_t at){
+    if (frameId == 0){
+        return;
+    }
+    uint8_t resp[7];
+    resp[0] = XSIM_API_XMIT_STATUS;
+    resp[1] = frameId;
+    resp[2] = 0xff;                // 16bit address, unknown
+    resp[3] = 0xfe;
+    resp[4] = retries;
+    resp[5] = status;
+    resp[6] = 0x00;                // Discovery status
+    enqueue(radio, resp, 7, at);
+}
+
+/*
+ *  0x90: API ID, Address 64, Address 16, Option, Payload
+ */
+void XBeeSimulator::deliver(int src, int dst, uint8_t option, const uint8_t* payload, uint16_t len, uint64_t at){
+    uint8_t frame[XSIM_MAX_FRAME];
+    frame[0] = XSIM_API_RESPONSE;
+    setUint32(frame + 1, _radio[src].addrMsb);
+    setUint32(frame + 5, _radio[src].addrLsb);
+    frame[9] = _radio[src].addr16 >> 8;
+    frame[10] = _radio[src].addr16 & 0xff;
+    frame[11] = option;
+    if (len > XSIM_MAX_FRAME - 12){
+        len = XSIM_MAX_FRAME - 12;
+    }
+    memcpy(frame + 12, payload, len);
+    _deliveredCnt++;
+    enqueue(dst, frame, len + 12, at);
+}
+
+bool XBeeSimulator::isLost(){
+    return _lossRate > 0 && rand_r(&_seed) < _lossRate * RAND_MAX;
+}
+
+int XBeeSimulator::findRadio(uint32_t msb, uint32_t lsb){
+    for (int i = 0; i < _radioCnt; i++){
+        if (_radio[i].addrMsb == msb && _radio[i].addrLsb == lsb){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ *  Time to send the escaped frame over the serial line (10 bits a byte).
+ */
+uint64_t XBeeSimulator::wireTime(int radio, uint8_t* data, uint16_t len){
+    if (_radio[radio].baudrate == 0){
+        return 0;
+    }
+    uint32_t bytes = len + 4;      // Start byte, length, checksum
+    for (uint16_t i = 0; i < len; i++){
+        if (isEscaped(data[i])){
+            bytes++;
+        }
+    }
+    return (uint64_t)bytes * 10 * 1000000 / _radio[radio].baudrate;
+}
+
+/*---------------------------------------
+ *   Frames to the host
+ ---------------------------------------*/
+/*
+ *  The frame reaches the radio at 'at' and is written to the host when
+ *  the serial line has carried it.
+ */
+void XBeeSimulator::enqueue(int radio, uint8_t* data, uint16_t len, uint64_t at){
+    if (_pendingCnt == XSIM_MAX_PENDING){
+        _lostCnt++;
+        return;
+    }
+    XSimRadio* r = &_radio[radio];
+    uint64_t due = at > r->lineFree ? at : r->lineFree;
+    due += wireTime(radio, data, len);
+    r->lineFree = due;
+
+    XSimFrame* f = &_pending[_pendingCnt++];
+    f->due = due;
+    f->radio = radio;
+    f->len = len;
+    memcpy(f->data, data, len);
+}
+
+/*
+ *  Write the due frames in the order of their due time.
+ */
+void XBeeSimulator::flushDue(){
+    uint64_t t = now();
+    while (_pendingCnt){
+        XSimFrame* f = &_pending[0];
+        for (uint16_t i = 1; i < _pendingCnt; i++){
+            if (_pending[i].due < f->due){
+                f = &_pending[i];
+            }
+        }
+        if (f->due > t){
+            break;
+        }
+
+        if (_radio[f->radio].node){
+            XSimFrame frame = *f;          // the node may enqueue replies
+            *f = _pending[--_pendingCnt];
+            if (frame.data[0] == XSIM_API_RESPONSE){
+                _radio[frame.radio].node->recv(getUint32(frame.data + 1), getUint32(frame.data + 5),
+                        (frame.data[9] << 8) + frame.data[10], frame.data[11], frame.data + 12, frame.len - 12);
+            }
+            continue;
+        }
+
+        uint8_t buf[XSIM_MAX_FRAME * 2 + 8];
+        uint16_t pos = 0;
+        uint8_t checksum = 0;
+        buf[pos++] = START_BYTE;
+        for (int j = -2; j <= f->len; j++){
+            uint8_t b;
+            if (j == -2){
+                b = 0;                 // Length MSB
+            }else if (j == -1){
+                b = f->len;            // Length LSB
+            }else if (j < f->len){
+                b = f->data[j];
+                checksum += b;
+            }else{
+                b = 0xff - checksum;
+            }
+            if (isEscaped(b)){
+                buf[pos++] = ESCAPE;
+                b ^= 0x20;
+            }
+            buf[pos++] = b;
+        }
+        if (write(_radio[f->radio].fd, buf, pos) != pos){
+            _lostCnt++;            // host does not read
+        }
+        *f = _pending[--_pendingCnt];
+    }
+}
+
+/*
+ *  usec until the next frame is due, at most maxMillsec.
+ */
+int XBeeSimulator::getTimeout(int maxMillsec){
+    uint64_t t = now();
+    uint64_t timeout = (uint64_t)maxMillsec * 1000;
+    for (uint16_t i = 0; i < _pendingCnt; i++){
+        uint64_t wait = _pending[i].due > t ? _pending[i].due - t : 0;
+        if (wait < timeout){
+            timeout = wait;
+        }
+    }
+    return (int)timeout;
+}
@@ -0,0 +1,171 @@
+/*
+ * XBeeSimulator.h
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ *  Simulated XBee ZB radios (API mode 2) connected by a lossy network.
+ *  Each radio is a pty which SerialPort::begin() opens like a device.
+ *  Linux only.
+ */
+
+#ifndef XBEESIMULATOR_H_
+#define XBEESIMULATOR_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define XSIM_MAX_RADIOS        8
+#define XSIM_MAX_PENDING     128    // frames in flight
+#define XSIM_MAX_FRAME       128    // unescaped frame data (API ID + data)
+#define XSIM_DEVNAME_LEN      64
+
+#define XSIM_MAX_PAYLOAD      84    // NP of ZB firmware without encryption
+#define XSIM_DEFAULT_BAUDRATE  9600
+#define XSIM_DEFAULT_LATENCY  10000 // usec per hop
+
+#define XSIM_BROADCAST_LSB  0x0000ffff
+#define XSIM_DELIVERY_OK          0x00
+#define XSIM_DELIVERY_NACK        0x21  // Network ACK failure
+#define XSIM_DELIVERY_NOT_FOUND   0x24  // Address not found
+
+/*=====================================
+        Class XSimNode
+ ======================================*/
+/*
+ *  In-process host of a radio, called in the simulator thread
+ *  with the simulator locked.
+ */
+class XSimNode {
+public:
+    virtual ~XSimNode(){}
+    virtual void recv(uint32_t srcMsb, uint32_t srcLsb, uint16_t src16, uint8_t option,
+                      uint8_t* payload, uint16_t len) = 0;
+};
+
+/*=====================================
+        Struct XSimRadio
+ ======================================*/
+struct XSimRadio {
+    XSimNode* node;                // in-process host, or NULL for a pty
+    int      fd;                   // pty master
+    int      slaveFd;              // keeps the pty open while no host is attached
+    char     devName[XSIM_DEVNAME_LEN];
+    uint32_t addrMsb;
+    uint32_t addrLsb;
+    uint16_t addr16;
+    uint32_t baudrate;             // serial line to the host, bps
+    uint64_t lineFree;             // time the line to the host becomes free
+    uint64_t upFree;               // time the line from the host becomes free
+
+    uint8_t  frame[XSIM_MAX_FRAME]; // API frame parser
+    uint16_t pos;
+    uint16_t frameLen;
+    bool     escape;
+    uint8_t  checksum;
+};
+
+/*=====================================
+        Struct XSimFrame
+ ======================================*/
+struct XSimFrame {
+    uint64_t due;                  // time the frame is written to the host
+    uint8_t  radio;
+    uint8_t  len;
+    uint8_t  data[XSIM_MAX_FRAME]; // unescaped frame data
+};
+
+/*=====================================
+        Class XBeeSimulator
+ ======================================*/
+class XBeeSimulator {
+public:
+    XBeeSimulator();
+    ~XBeeSimulator();
+
+    int  addRadio(uint32_t addrMsb, uint32_t addrLsb, uint16_t addr16);
+    int  addLocalRadio(uint32_t addrMsb, uint32_t addrLsb, uint16_t addr16, XSimNode* node);
+    void transmit(int radio, uint32_t dstMsb, uint32_t dstLsb,
+                  const uint8_t* payload, uint16_t len, uint32_t delay);
+    const char* getDeviceName(int radio);
+    uint8_t getRadioCount();
+
+    void setLatency(uint32_t usec);
+    void setBaudrate(uint32_t bps);
+    void setLossRate(double rate);
+    void setMacRetries(uint8_t cnt);
+    void setSeed(unsigned int seed);
+
+    int  start();                    // run in a thread
+    void stop();
+    void run();                      // run in the caller until stop()
+    void exec(int timeoutMillsec);   // one pass of the loop
+    void lock();
+    void unlock();
+    uint64_t now();                  // usec, CLOCK_MONOTONIC
+
+    uint32_t getSentCount();
+    uint32_t getDeliveredCount();
+    uint32_t getLostCount();
+
+private:
+    static void* threadMain(void* sim);
+    void recv(int radio);
+    void parse(int radio, uint8_t data);
+    void frameHandler(int radio, uint8_t* data, uint16_t len);
+    void transmitRequest(int radio, uint8_t* data, uint16_t len);
+    void sendRF(int radio, uint8_t frameId, uint32_t msb, uint32_t lsb,
+                const uint8_t* payload, uint16_t len, uint64_t t);
+    void atCommand(int radio, uint8_t* data, uint16_t len);
+    void xmitStatus(int radio, uint8_t frameId, uint8_t retries, uint8_t status, uint64_t at);
+    void deliver(int src, int dst, uint8_t option, const uint8_t* payload, uint16_t len, uint64_t at);
+    bool isLost();
+    uint64_t wireTime(int radio, uint8_t* data, uint16_t len);
+    void enqueue(int radio, uint8_t* data, uint16_t len, uint64_t at);
+    void flushDue();
+    int  getTimeout(int maxMillsec);
+    int  findRadio(uint32_t msb, uint32_t lsb);
+
+    XSimRadio _radio[XSIM_MAX_RADIOS];
+    uint8_t   _radioCnt;
+    XSimFrame _pending[XSIM_MAX_PENDING];
+    uint16_t  _pendingCnt;
+
+    uint32_t  _latency;
+    uint32_t  _baudrate;
+    double    _lossRate;
+    uint8_t   _macRetries;
+    unsigned int _seed;
+
+    uint32_t  _sentCnt;
+    uint32_t  _deliveredCnt;
+    uint32_t  _lostCnt;
+
+    volatile bool _running;
+    pthread_mutex_t _mutex;
+    pthread_t _thread;
+    bool      _threadStarted;
+};
+
+#endif /* XBEESIMULATOR_H_ */
@@ -0,0 +1,151 @@
+/*
+ * XBeeSimulatorApp.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Run simulated radios as a separate process.
+ *
+ *  $ XBeeSimulator [-n radios] [-l latency usec] [-b bps] [-p loss rate] [-r MAC retries]
+ *                  [-g] [-d response delay usec] [-c congestion every N] [-i invalid topic every N]
+ *                  [-u UDP port] [-m broadcast address:port]
+ *
+ *  Radio 0 is the coordinator (Gateway). Open the printed devices with
+ *  TomyGateway and TomyClient. With -g, radio 0 is the Gateway emulator.
+ *  With -u, the Gateway emulator also runs on UDP for UdpStack.
+ */
+
+#include "XBeeSimulator.h"
+#include "GatewayEmulator.h"
+#include "UdpGatewayEmulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+
+static XBeeSimulator* theSimulator;
+
+static void stopHandler(int sig){
+    theSimulator->stop();
+}
+
+int main(int argc, char** argv){
+    XBeeSimulator sim;
+    GatewayEmulator* gw = NULL;
+    int radios = 2;
+    int opt;
+    int delay = 0;
+    int congestion = 0;
+    int invalidTopic = 0;
+    int udpPort = 0;
+    char bcastAddr[32] = "225.1.1.1";
+    int bcastPort = 1883;
+
+    while ((opt = getopt(argc, argv, "n:l:b:p:r:s:gd:c:i:u:m:")) != -1){
+        switch (opt){
+        case 'n':
+            radios = atoi(optarg);
+            break;
+        case 'l':
+            sim.setLatency(atoi(optarg));
+            break;
+        case 'b':
+            sim.setBaudrate(atoi(optarg));
+            break;
+        case 'p':
+            sim.setLossRate(atof(optarg));
+            break;
+        case 'r':
+            sim.setMacRetries(atoi(optarg));
+            break;
+        case 's':
+            sim.setSeed(atoi(optarg));
+            break;
+        case 'g':
+            gw = new GatewayEmulator(&sim, 0x0013a200, 0x40000000);
+            break;
+        case 'd':
+            delay = atoi(optarg);
+            break;
+        case 'c':
+            congestion = atoi(optarg);
+            break;
+        case 'i':
+            invalidTopic = atoi(optarg);
+            break;
+        case 'u':
+            udpPort = atoi(optarg);
+            break;
+        case 'm':
+            sscanf(optarg, "%31[^:]:%d", bcastAddr, &bcastPort);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n radios] [-l latency usec] [-b bps] [-p loss rate] [-r MAC retries] [-s seed]"
+                    " [-g] [-d response delay usec] [-c congestion every N] [-i invalid topic every N]"
+                    " [-u UDP port] [-m broadcast address:port]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (gw){
+        gw->setResponseDelay(delay);
+        gw->setCongestion(congestion);
+        gw->setInvalidTopic(invalidTopic);
+        printf("Radio 0  0013A200 40000000 : Gateway emulator\n");
+    }
+    UdpGatewayEmulator udpGw;
+    if (udpPort){
+        if (udpGw.open(udpPort, bcastAddr, bcastPort) < 0){
+            fprintf(stderr, "Can't open UDP port %d\n", udpPort);
+            return 1;
+        }
+        udpGw.setResponseDelay(delay);
+        udpGw.setCongestion(congestion);
+        udpGw.setInvalidTopic(invalidTopic);
+        udpGw.start();
+        printf("UDP      port %d  %s:%d : Gateway emulator\n", udpPort, bcastAddr, bcastPort);
+    }
+    for (int i = gw ? 1 : 0; i < radios; i++){
+        int radio = sim.addRadio(0x0013a200, 0x40000000 + i, i == 0 ? 0x0000 : 0x1000 + i);
+        if (radio < 0){
+            fprintf(stderr, "Can't open radio %d\n", i);
+            return 1;
+        }
+        printf("Radio %d  0013A200 %08X : %s\n", radio, 0x40000000 + i, sim.getDeviceName(radio));
+    }
+    fflush(stdout);
+
+    theSimulator = &sim;
+    signal(SIGINT, stopHandler);
+    signal(SIGTERM, stopHandler);
+    sim.run();
+
+    printf("\nSent %u  Delivered %u  Lost %u\n",
+           sim.getSentCount(), sim.getDeliveredCount(), sim.getLostCount());
+    delete gw;
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * GatewayTest.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Table of the trusted Gateways of ZBeeStack.
+ *
+ *  $ GatewayTest
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MqttsClient.h"
+#include "../simulator/XBeeSimulator.h"
+#include "../simulator/GatewayEmulator.h"
+#include "TestUtil.h"
+#include <stdio.h>
+
+using namespace tomyClient;
+
+#define GW_MSB  0x0013a200
+
+/*
+ *  The oldest Gateway gives way to a new one, the one in use stays.
+ */
+static void testEviction(){
+    ZBeeStack* zb = new ZBeeStack();
+    XBeeAddress64 old[ZB_MAX_GATEWAYS];
+    XBeeAddress64 added[ZB_MAX_GATEWAYS];
+    XBeeAddress64 gw(GW_MSB, 0x40001000);
+
+    for (int i = 0; i < ZB_MAX_GATEWAYS; i++){
+        old[i] = XBeeAddress64(GW_MSB, 0x40000010 + i * ZB_GW_TABLE_SIZE);   // one probe run
+        CHECK(zb->addGwAddress(old[i]));
+    }
+    CHECK(zb->addGwAddress(old[0]));          // heard from again
+    zb->setGwAddress(gw, 0x1234);
+    CHECK(zb->isGwAddress(gw));
+    CHECK(zb->isGwAddress(old[0]));
+    CHECK(!zb->isGwAddress(old[1]));
+    for (int i = 2; i < ZB_MAX_GATEWAYS; i++){
+        CHECK(zb->isGwAddress(old[i]));
+    }
+
+    for (int i = 0; i < ZB_MAX_GATEWAYS; i++){
+        added[i] = XBeeAddress64(GW_MSB, 0x40000100 + i);
+        CHECK(zb->addGwAddress(added[i]));
+    }
+    CHECK(zb->isGwAddress(gw));               // in use
+    for (int i = 0; i < ZB_MAX_GATEWAYS; i++){
+        CHECK(!zb->isGwAddress(old[i]));
+    }
+    for (int i = 1; i < ZB_MAX_GATEWAYS; i++){
+        CHECK(zb->isGwAddress(added[i]));
+    }
+    CHECK(!zb->isGwAddress(added[0]));
+    delete zb;
+}
+
+/*
+ *  Other Gateways fill the table before the client finds its Gateway,
+ *  which must still be trusted when it answers CONNECT.
+ */
+static void testConnectWhenFull(){
+    XBeeSimulator sim;
+    sim.setLatency(2000);
+    sim.setBaudrate(0);
+    GatewayEmulator gwe(&sim, GW_MSB, 0x40000000, 1);
+    int client = sim.addRadio(GW_MSB, 0x40000001, 0x1001);
+    CHECK(sim.start() == 0);
+
+    MqttsClient mqtts;
+    mqtts.init("gwtest");
+    mqtts.begin((char*)sim.getDeviceName(client), B9600);
+    mqtts.setQos(1);
+    mqtts.setKeepAlive(60);
+    ZBeeStack* zb = (ZBeeStack*)mqtts.getNetwork();
+    for (int i = 0; i < ZB_MAX_GATEWAYS; i++){
+        XBeeAddress64 addr(GW_MSB, 0x40000080 + i);       // ADVERTISE of a standby
+        zb->addGwAddress(addr);
+    }
+
+    MQString topic("gw/test");
+    MQString data("hello");
+    CHECK(mqtts.publish(&topic, &data) == MQTTS_ERR_NO_ERROR);   // REGISTER
+    CHECK(mqtts.publish(&topic, &data) == MQTTS_ERR_NO_ERROR);
+    CHECK(gwe.getConnectedCount() == 1);
+    CHECK(gwe.getRecvCount(MQTTS_TYPE_PUBLISH) == 1);
+    CHECK(zb->getRxRejectCount() == 0);
+    XBeeAddress64 gw(GW_MSB, 0x40000000);
+    CHECK(zb->isGwAddress(gw));
+    sim.stop();
+}
+
+int main(int argc, char** argv){
+    setvbuf(stdout, NULL, _IONBF, 0);
+    testEviction();
+    testConnectWhenFull();
+    return testResult("GatewayTest");
+}
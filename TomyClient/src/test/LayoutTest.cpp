@@ -0,0 +1,378 @@
+/*
+ * LayoutTest.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Every message layout of MQTTS.h, encoded by MqttsEncoder and the
+ *  message classes and read back through the fields, the views and
+ *  setFrame() of the classes.
+ *
+ *  $ LayoutTest
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MQTTS.h"
+#include "TestUtil.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace tomyClient;
+
+static uint8_t theBuf[MQTTS_MAX_PACKET_LENGTH];
+static ZBResponse theResp;
+
+static ZBResponse* received(uint8_t* frame){
+    theResp.setPayload(frame);
+    theResp.setPayloadLength(frame[0]);
+    return &theResp;
+}
+
+static uint8_t* body(uint8_t* frame){
+    return frame + MQTTS_HEADER_SIZE;
+}
+
+/*
+ *  A string of MQString, a length of two bytes and the characters.
+ */
+static bool isString(uint8_t* pos, const char* str){
+    return getUint16(pos) == strlen(str) && memcmp(pos + 2, str, strlen(str)) == 0;
+}
+
+/*
+ *  Type and Length of Layout, and the same bytes from both encoders.
+ */
+template<class Layout>
+static void checkFrame(uint8_t len, MqttsMessage* msg, uint8_t varLen){
+    CHECK(len == Layout::Length + varLen);
+    CHECK(theBuf[0] == len);
+    CHECK(theBuf[1] == Layout::Type);
+    if (msg){
+        CHECK(msg->getLength() == len);
+        CHECK(msg->getType() == Layout::Type);
+        CHECK(memcmp(msg->getMsgBuff(), theBuf, len) == 0);
+    }
+}
+
+static void testAdvertise(){
+    MqttsAdvertise msg;
+    msg.setGwId(0x12);
+    msg.setDuration(0x3456);
+    memcpy(theBuf, msg.getMsgBuff(), msg.getLength());
+    checkFrame<MqttsAdvertiseLayout>(msg.getLength(), NULL, 0);
+    CHECK(MqttsAdvertiseLayout::GwId::get(body(theBuf)) == 0x12);
+    CHECK(MqttsAdvertiseLayout::Duration::get(body(theBuf)) == 0x3456);
+    MqttsAdvertiseView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getGwId() == 0x12 && view.getDuration() == 0x3456);
+    CHECK(msg.getGwId() == 0x12 && msg.getDuration() == 0x3456);
+}
+
+static void testSearchGw(){
+    MqttsSearchGw msg;
+    msg.setRadius(3);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsSearchGwLayout>(enc.searchGw(3), &msg, 0);
+    CHECK(MqttsSearchGwLayout::Radius::get(body(theBuf)) == 3);
+    CHECK(msg.getRadius() == 3);
+}
+
+static void testGwInfo(){
+    MqttsGwInfo msg;
+    msg.setGwId(0x21);
+    memcpy(theBuf, msg.getMsgBuff(), msg.getLength());
+    checkFrame<MqttsGwInfoLayout>(msg.getLength(), NULL, 0);
+    CHECK(MqttsGwInfoLayout::GwId::get(body(theBuf)) == 0x21);
+    MqttsGwInfoView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getGwId() == 0x21 && msg.getGwId() == 0x21);
+}
+
+static void testConnect(){
+    MQString id("client-01");
+    MqttsConnect msg(&id);
+    msg.setFlags(MQTTS_FLAG_WILL | MQTTS_FLAG_CLEAN);
+    msg.setDuration(300);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsConnectLayout>(enc.connect(MQTTS_FLAG_WILL | MQTTS_FLAG_CLEAN, 300, &id), &msg, id.getDataLength());
+    CHECK(MqttsConnectLayout::Flags::get(body(theBuf)) == (MQTTS_FLAG_WILL | MQTTS_FLAG_CLEAN));
+    CHECK(MqttsConnectLayout::ProtocolId::get(body(theBuf)) == MQTTS_PROTOCOL_ID);
+    CHECK(MqttsConnectLayout::Duration::get(body(theBuf)) == 300);
+    CHECK(isString(body(theBuf) + MqttsConnectLayout::Tail, "client-01"));
+    MqttsConnect dec(&id);
+    dec.setFrame(body(theBuf), theBuf[0] - MQTTS_HEADER_SIZE);
+    CHECK(dec.getFlags() == (MQTTS_FLAG_WILL | MQTTS_FLAG_CLEAN) && dec.getDuration() == 300);
+}
+
+static void testConnack(){
+    MqttsConnack msg;
+    msg.setReturnCode(MQTTS_RC_REJECTED_CONGESTION);
+    memcpy(theBuf, msg.getMsgBuff(), msg.getLength());
+    checkFrame<MqttsConnackLayout>(msg.getLength(), NULL, 0);
+    CHECK(MqttsConnackLayout::ReturnCode::get(body(theBuf)) == MQTTS_RC_REJECTED_CONGESTION);
+    MqttsConnackView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getReturnCode() == MQTTS_RC_REJECTED_CONGESTION);
+}
+
+static void testWill(){
+    MqttsWillTopicReq topicReq;
+    memcpy(theBuf, topicReq.getMsgBuff(), topicReq.getLength());
+    checkFrame<MqttsWillTopicReqLayout>(topicReq.getLength(), NULL, 0);
+
+    MqttsWillMsgReq msgReq;
+    memcpy(theBuf, msgReq.getMsgBuff(), msgReq.getLength());
+    checkFrame<MqttsWillMsgReqLayout>(msgReq.getLength(), NULL, 0);
+
+    MQString topic("will/topic");
+    MqttsWillTopic willTopic;
+    willTopic.setFlags(MQTTS_FLAG_QOS_1 | MQTTS_FLAG_RETAIN);
+    willTopic.setWillTopic(&topic);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsWillTopicLayout>(enc.willTopic(MQTTS_FLAG_QOS_1 | MQTTS_FLAG_RETAIN, &topic), &willTopic, topic.getDataLength());
+    CHECK(MqttsWillTopicLayout::Flags::get(body(theBuf)) == (MQTTS_FLAG_QOS_1 | MQTTS_FLAG_RETAIN));
+    CHECK(isString(body(theBuf) + MqttsWillTopicLayout::Tail, "will/topic"));
+
+    MQString data("bye");
+    MqttsWillMsg willMsg;
+    willMsg.setWillMsg(&data);
+    checkFrame<MqttsWillMsgLayout>(enc.willMsg(&data), &willMsg, data.getDataLength());
+    CHECK(isString(body(theBuf) + MqttsWillMsgLayout::Tail, "bye"));
+}
+
+static void testRegister(){
+    MQString topic("a/b/c");
+    MqttsRegister msg;
+    msg.setTopicId(0x1234);
+    msg.setMsgId(0x5678);
+    msg.setTopicName(&topic);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsRegisterLayout>(enc.registerTopic(0x1234, 0x5678, &topic), &msg, topic.getDataLength());
+    CHECK(MqttsRegisterLayout::TopicId::get(body(theBuf)) == 0x1234);
+    CHECK(MqttsRegisterLayout::MsgId::get(body(theBuf)) == 0x5678);
+    MqttsRegisterView view;
+    CHECK(view.set(received(theBuf)));
+    MQString name;
+    view.getTopicName(&name);
+    CHECK(view.getTopicId() == 0x1234 && view.getMsgId() == 0x5678 && name.getCharLength() == 5);
+    MqttsRegister dec;
+    dec.setFrame(received(theBuf));
+    CHECK(dec.getTopicId() == 0x1234 && dec.getMsgId() == 0x5678);
+    CHECK(dec.getTopicName()->getCharLength() == 5);
+}
+
+static void testRegAck(){
+    MqttsRegAck msg;
+    msg.setTopicId(0x1234);
+    msg.setMsgId(0x5678);
+    msg.setReturnCode(MQTTS_RC_REJECTED_INVALID_TOPIC_ID);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsRegAckLayout>(enc.regAck(0x1234, 0x5678, MQTTS_RC_REJECTED_INVALID_TOPIC_ID), &msg, 0);
+    CHECK(MqttsRegAckLayout::TopicId::get(body(theBuf)) == 0x1234);
+    CHECK(MqttsRegAckLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(MqttsRegAckLayout::ReturnCode::get(body(theBuf)) == MQTTS_RC_REJECTED_INVALID_TOPIC_ID);
+    MqttsRegAckView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getTopicId() == 0x1234 && view.getMsgId() == 0x5678 &&
+          view.getReturnCode() == MQTTS_RC_REJECTED_INVALID_TOPIC_ID);
+    MqttsPubAckView other;
+    CHECK(!other.set(received(theBuf)));
+}
+
+static void testPublish(){
+    uint8_t data[] = {1, 2, 3, 4, 5, 6};
+    uint8_t flags = MQTTS_FLAG_QOS_1 | MQTTS_FLAG_RETAIN | MQTTS_TOPIC_TYPE_PREDEFINED;
+    MqttsPublish msg;
+    msg.setFlags(flags);
+    msg.setTopicId(0x1234);
+    msg.setMsgId(0x5678);
+    msg.setData(data, sizeof(data));
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsPublishLayout>(enc.publish(flags, 0x1234, 0x5678, data, sizeof(data)), &msg, sizeof(data));
+    CHECK(MqttsPublishLayout::Flags::get(body(theBuf)) == flags);
+    CHECK(MqttsPublishLayout::Qos::get(body(theBuf)) == MQTTS_FLAG_QOS_1);
+    CHECK(MqttsPublishLayout::Retain::get(body(theBuf)) == MQTTS_FLAG_RETAIN);
+    CHECK(MqttsPublishLayout::TopicType::get(body(theBuf)) == MQTTS_TOPIC_TYPE_PREDEFINED);
+    CHECK(MqttsPublishLayout::Dup::get(body(theBuf)) == 0);
+    CHECK(MqttsPublishLayout::TopicId::get(body(theBuf)) == 0x1234);
+    CHECK(MqttsPublishLayout::MsgId::get(body(theBuf)) == 0x5678);
+    MqttsPublishView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getFlags() == flags && view.getQos() == MQTTS_FLAG_QOS_1);
+    CHECK(view.getTopicId() == 0x1234 && view.getMsgId() == 0x5678);
+    CHECK(view.getDataLength() == sizeof(data) && memcmp(view.getData(), data, sizeof(data)) == 0);
+    MqttsPublish dec;
+    dec.setFrame(received(theBuf));
+    CHECK(dec.getTopicId() == 0x1234 && dec.getMsgId() == 0x5678);
+    CHECK(dec.getQos() == MQTTS_FLAG_QOS_1 && dec.isRetain());
+    CHECK(dec.getTopicType() == MQTTS_TOPIC_TYPE_PREDEFINED);
+    CHECK(memcmp(dec.getData(), data, sizeof(data)) == 0);
+}
+
+static void testPubAck(){
+    MqttsPubAck msg;
+    msg.setTopicId(0x1234);
+    msg.setMsgId(0x5678);
+    msg.setReturnCode(MQTTS_RC_REJECTED_CONGESTION);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsPubAckLayout>(enc.pubAck(0x1234, 0x5678, MQTTS_RC_REJECTED_CONGESTION), &msg, 0);
+    CHECK(MqttsPubAckLayout::TopicId::get(body(theBuf)) == 0x1234);
+    CHECK(MqttsPubAckLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(MqttsPubAckLayout::ReturnCode::get(body(theBuf)) == MQTTS_RC_REJECTED_CONGESTION);
+    MqttsPubAckView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getTopicId() == 0x1234 && view.getMsgId() == 0x5678 &&
+          view.getReturnCode() == MQTTS_RC_REJECTED_CONGESTION);
+}
+
+static void testSubscribe(){
+    MQString topic("a/+/c");
+    MqttsSubscribe msg;
+    msg.setFlags(MQTTS_FLAG_QOS_1 | MQTTS_TOPIC_TYPE_NORMAL);
+    msg.setMsgId(0x5678);
+    msg.setTopicName(&topic);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    uint8_t len = enc.subscribe(MQTTS_FLAG_QOS_1 | MQTTS_TOPIC_TYPE_NORMAL, 0x5678, &topic);
+    CHECK(len == MqttsSubscribeLayout::Tail + MQTTS_HEADER_SIZE + topic.getDataLength());
+    CHECK(msg.getLength() == len && memcmp(msg.getMsgBuff(), theBuf, len) == 0);
+    CHECK(theBuf[1] == MqttsSubscribeLayout::Type);
+    CHECK(MqttsSubscribeLayout::TopicType::get(body(theBuf)) == MQTTS_TOPIC_TYPE_NORMAL);
+    CHECK(MqttsSubscribeLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(isString(body(theBuf) + MqttsSubscribeLayout::Tail, "a/+/c"));
+    MqttsSubscribe dec;
+    dec.setFrame(received(theBuf));
+    CHECK(dec.getMsgId() == 0x5678 && dec.getTopicName()->getCharLength() == 5);
+
+    MqttsSubscribe byId;
+    byId.setFlags(MQTTS_FLAG_QOS_1 | MQTTS_TOPIC_TYPE_PREDEFINED);
+    byId.setMsgId(0x5678);
+    byId.setTopicId(0x1234);
+    checkFrame<MqttsSubscribeLayout>(enc.subscribe(MQTTS_FLAG_QOS_1 | MQTTS_TOPIC_TYPE_PREDEFINED, 0x5678, (uint16_t)0x1234),
+                                     &byId, 2);
+    CHECK(MqttsSubscribeLayout::TopicType::get(body(theBuf)) == MQTTS_TOPIC_TYPE_PREDEFINED);
+    CHECK(MqttsSubscribeLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(MqttsSubscribeLayout::TopicId::get(body(theBuf)) == 0x1234);
+    MqttsSubscribe decId;
+    decId.setFrame(received(theBuf));
+    CHECK(decId.getMsgId() == 0x5678 && decId.getTopicId() == 0x1234);
+}
+
+static void testSubAck(){
+    MqttsSubAck msg;
+    msg.setFlags(MQTTS_FLAG_QOS_1);
+    msg.setTopicId(0x1234);
+    msg.setMsgId(0x5678);
+    msg.setReturnCode(MQTTS_RC_ACCEPTED);
+    memcpy(theBuf, msg.getMsgBuff(), msg.getLength());
+    checkFrame<MqttsSubAckLayout>(msg.getLength(), NULL, 0);
+    CHECK(MqttsSubAckLayout::Flags::get(body(theBuf)) == MQTTS_FLAG_QOS_1);
+    CHECK(MqttsSubAckLayout::Qos::get(body(theBuf)) == MQTTS_FLAG_QOS_1);
+    CHECK(MqttsSubAckLayout::TopicId::get(body(theBuf)) == 0x1234);
+    CHECK(MqttsSubAckLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(MqttsSubAckLayout::ReturnCode::get(body(theBuf)) == MQTTS_RC_ACCEPTED);
+    MqttsSubAckView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getFlags() == MQTTS_FLAG_QOS_1 && view.getTopicId() == 0x1234 &&
+          view.getMsgId() == 0x5678 && view.getReturnCode() == MQTTS_RC_ACCEPTED);
+    CHECK(msg.getQos() == MQTTS_FLAG_QOS_1 && msg.getTopicId() == 0x1234 && msg.getMsgId() == 0x5678);
+}
+
+static void testUnsubscribe(){
+    MQString topic("a/b");
+    MqttsUnsubscribe msg;
+    msg.setFlags(MQTTS_TOPIC_TYPE_NORMAL);
+    msg.setMsgId(0x5678);
+    msg.setTopicName(&topic);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    uint8_t len = enc.unsubscribe(MQTTS_TOPIC_TYPE_NORMAL, 0x5678, &topic);
+    CHECK(len == MqttsUnsubscribeLayout::Tail + MQTTS_HEADER_SIZE + topic.getDataLength());
+    CHECK(msg.getLength() == len && memcmp(msg.getMsgBuff(), theBuf, len) == 0);
+    CHECK(theBuf[1] == MqttsUnsubscribeLayout::Type);
+    CHECK(MqttsUnsubscribeLayout::Flags::get(body(theBuf)) == MQTTS_TOPIC_TYPE_NORMAL);
+    CHECK(MqttsUnsubscribeLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(isString(body(theBuf) + MqttsUnsubscribeLayout::Tail, "a/b"));
+
+    checkFrame<MqttsUnsubscribeLayout>(enc.unsubscribe(MQTTS_TOPIC_TYPE_PREDEFINED, 0x5678, (uint16_t)0x1234), NULL, 2);
+    CHECK(MqttsUnsubscribeLayout::Flags::get(body(theBuf)) == MQTTS_TOPIC_TYPE_PREDEFINED);
+    CHECK(MqttsUnsubscribeLayout::MsgId::get(body(theBuf)) == 0x5678);
+    CHECK(MqttsUnsubscribeLayout::TopicId::get(body(theBuf)) == 0x1234);
+}
+
+static void testUnSubAck(){
+    MqttsUnSubAck msg;
+    msg.setMsgId(0x5678);
+    memcpy(theBuf, msg.getMsgBuff(), msg.getLength());
+    checkFrame<MqttsUnSubAckLayout>(msg.getLength(), NULL, 0);
+    CHECK(MqttsUnSubAckLayout::MsgId::get(body(theBuf)) == 0x5678);
+    MqttsUnSubAckView view;
+    CHECK(view.set(received(theBuf)));
+    CHECK(view.getMsgId() == 0x5678 && msg.getMsgId() == 0x5678);
+}
+
+static void testPing(){
+    MQString id("client-01");
+    MqttsPingReq req(&id);
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsPingReqLayout>(enc.pingReq(&id), &req, id.getDataLength());
+    CHECK(isString(body(theBuf) + MqttsPingReqLayout::Tail, "client-01"));
+
+    MqttsPingResp resp;
+    memcpy(theBuf, resp.getMsgBuff(), resp.getLength());
+    checkFrame<MqttsPingRespLayout>(resp.getLength(), NULL, 0);
+}
+
+static void testDisconnect(){
+    MqttsDisconnect msg;
+    MqttsEncoder enc(theBuf, sizeof(theBuf));
+    checkFrame<MqttsDisconnectLayout>(enc.disconnect(0), &msg, 2);
+
+    msg.setDuration(600);
+    checkFrame<MqttsDisconnectLayout>(enc.disconnect(600), &msg, 2);
+    CHECK(MqttsDisconnectLayout::Duration::get(body(theBuf)) == 600);
+    CHECK(msg.getDuration() == 600);
+}
+
+int main(int argc, char** argv){
+    testAdvertise();
+    testSearchGw();
+    testGwInfo();
+    testConnect();
+    testConnack();
+    testWill();
+    testRegister();
+    testRegAck();
+    testPublish();
+    testPubAck();
+    testSubscribe();
+    testSubAck();
+    testUnsubscribe();
+    testUnSubAck();
+    testPing();
+    testDisconnect();
+    return testResult("LayoutTest");
+}
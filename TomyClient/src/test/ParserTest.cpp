@@ -0,0 +1,322 @@
+/*
+ * ParserTest.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  API frame parser and receive queue of ZBeeStack.
+ *
+ *  $ ParserTest
+ *
+ *  Linux only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include "../mqttslib/MQTTS.h"
+#include "TestUtil.h"
+
+using namespace tomyClient;
+
+#define BURST_FRAMES  100
+
+/*
+ *  Bit map of the pool buffers in use, the pool-exhausted test takes them.
+ */
+namespace tomyClient {
+class ZBeeStackTest {
+public:
+    static uint32_t& rxPoolUsed(ZBeeStack* zb){ return zb->_rxPoolUsed; }
+};
+}
+
+#define MAX_STREAM  4096
+#define MAX_OUTPUT  4096
+
+/*
+ *  API ID, remote address and payload of every dispatched frame,
+ *  appended one after the other.
+ */
+struct Output {
+    uint8_t buf[MAX_OUTPUT];
+    uint16_t len;
+};
+
+static void append(Output* out, const uint8_t* data, uint16_t len){
+    if (out->len + len <= MAX_OUTPUT){
+        memcpy(out->buf + out->len, data, len);
+        out->len += len;
+    }
+}
+
+static void rxHandler(ZBResponse* resp, int* returnCode, void* arg){
+    Output* out = (Output*)arg;
+    uint8_t hdr[7];
+    hdr[0] = ZB_API_RESPONSE;
+    setUint16(hdr + 1, resp->getRemoteAddress16());
+    setUint16(hdr + 3, resp->getRemoteAddress64().getLsb() & 0xffff);
+    hdr[5] = resp->getOption();
+    hdr[6] = resp->getPayloadLength();
+    append(out, hdr, sizeof(hdr));
+    append(out, resp->getPayload(), resp->getPayloadLength());
+}
+
+static void xmitStatusHandler(uint8_t frameId, uint8_t deliveryStatus, uint8_t retryCount, void* arg){
+    uint8_t hdr[4] = {ZB_API_XMIT_STATUS, frameId, deliveryStatus, retryCount};
+    append((Output*)arg, hdr, sizeof(hdr));
+}
+
+/*
+ *  Append an API frame with the escaped length, frame data and checksum.
+ */
+static uint16_t addFrame(uint8_t* stream, uint16_t pos, const uint8_t* data, uint16_t len, bool badChecksum){
+    uint8_t raw[ZB_MAX_FRAME_DATA + 3];
+    uint8_t dummy = 0;
+    raw[0] = len >> 8;
+    raw[1] = len & 0xff;
+    memcpy(raw + 2, data, len);
+    raw[len + 2] = 0xff - zbChecksum(data, len) + (badChecksum ? 1 : 0);
+    stream[pos++] = START_BYTE;
+    return pos + zbEscape(stream + pos, raw, len + 3, &dummy);
+}
+
+static uint16_t addRxFrame(uint8_t* stream, uint16_t pos, uint32_t lsb, uint16_t addr16,
+                           const uint8_t* payload, uint8_t payloadLen, bool badChecksum){
+    uint8_t data[ZB_MAX_FRAME_DATA];
+    data[0] = ZB_API_RESPONSE;
+    setUint16(data + 1, 0x0013);
+    setUint16(data + 3, 0xa200);
+    setUint16(data + 5, lsb >> 16);
+    setUint16(data + 7, lsb & 0xffff);
+    setUint16(data + 9, addr16);
+    data[11] = 0x01;
+    memcpy(data + ZB_RSP_DATA_OFFSET + 1, payload, payloadLen);
+    return addFrame(stream, pos, data, ZB_RSP_DATA_OFFSET + 1 + payloadLen, badChecksum);
+}
+
+/*
+ *  Frames with escaped bytes in the length, the address, the payload
+ *  and the checksum, a broken frame and noise between the frames.
+ */
+static uint16_t makeStream(uint8_t* stream){
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+    uint16_t pos = 0;
+
+    stream[pos++] = 0x55;                               // noise before a Start byte
+    for (uint8_t i = 0; i < 40; i++){
+        payload[i] = i * 7;
+    }
+    pos = addRxFrame(stream, pos, 0x40000000, 0x1234, payload, 40, false);
+
+    uint8_t esc[] = {START_BYTE, ESCAPE, XON, XOFF, START_BYTE, START_BYTE, 0x00, ESCAPE};
+    pos = addRxFrame(stream, pos, 0x4000117d, 0x7e13, esc, sizeof(esc), false);
+
+    uint8_t status[] = {ZB_API_XMIT_STATUS, 0x7d, 0xff, 0xfe, 0x02, 0x00, 0x00};
+    pos = addFrame(stream, pos, status, sizeof(status), false);
+
+    pos = addRxFrame(stream, pos, 0x40000001, 0x0001, payload, 10, true);   // dropped
+    stream[pos++] = ESCAPE;                             // noise
+    stream[pos++] = 0x11;
+
+    for (uint8_t i = 0; i < MAX_PAYLOAD_SIZE; i++){     // 0x7e, 0x7d, 0x11 and 0x13 run
+        payload[i] = 0x7a + (i % 10);
+    }
+    pos = addRxFrame(stream, pos, 0x40000002, 0x0002, payload, MAX_PAYLOAD_SIZE, false);
+
+    for (uint8_t len = 1; len < 6; len++){
+        pos = addRxFrame(stream, pos, 0x40000003, 0x0003, payload + len, len, false);
+    }
+    return pos;
+}
+
+/*
+ *  Dispatch every queued frame.
+ */
+static void drain(ZBeeStack* zb){
+    while (zb->getRxQueCount() > 0){
+        zb->readPacket();
+    }
+}
+
+static void feed(ZBeeStack* zb, uint8_t* buf, uint16_t len){
+    uint16_t pos = 0;
+    while (pos < len){
+        pos += zb->parseApiFrame(buf + pos, len - pos);
+        drain(zb);
+    }
+}
+
+static void parse(uint8_t* stream, uint16_t len, uint16_t split, Output* out){
+    ZBeeStack* zb = new ZBeeStack();
+    zb->setRxHandler(rxHandler, out);
+    zb->setXmitStatusHandler(xmitStatusHandler, out);
+    out->len = 0;
+    feed(zb, stream, split);
+    feed(zb, stream + split, len - split);
+    delete zb;
+}
+
+static int countFrames(Output* out){
+    int frames = 0;
+    for (uint16_t pos = 0; pos < out->len; frames++){
+        pos += (out->buf[pos] == ZB_API_XMIT_STATUS ? 4 : 7 + out->buf[pos + 6]);
+    }
+    return frames;
+}
+
+/*
+ *  Every split of the stream gives the output of the whole stream.
+ */
+static void testSplit(){
+    uint8_t stream[MAX_STREAM];
+    uint16_t len = makeStream(stream);
+    static Output whole;
+    static Output part;
+
+    parse(stream, len, len, &whole);
+    CHECK(countFrames(&whole) == 9);                    // the broken frame is dropped
+
+    int bad = 0;
+    for (uint16_t split = 1; split < len; split++){
+        parse(stream, len, split, &part);
+        if (part.len != whole.len || memcmp(part.buf, whole.buf, whole.len)){
+            printf("split at %d differs\n", split);
+            bad++;
+        }
+    }
+    CHECK(bad == 0);
+}
+
+/*
+ *  More frames than the queue holds, written back to back into a pty
+ *  and taken by one read of the SerialPort.
+ */
+static void testBurst(){
+    uint8_t stream[MAX_STREAM];
+    uint8_t payload[4];
+    uint16_t len = 0;
+    int frames = BURST_FRAMES;
+    static Output out;
+
+    memset(payload, ESCAPE, sizeof(payload));
+    for (int i = 0; i < frames; i++){
+        len = addRxFrame(stream, len, 0x40000000 + i, i, payload, sizeof(payload), false);
+    }
+    CHECK(len <= MAX_STREAM);
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0);
+    SerialPort port;
+    CHECK(port.begin(ptsname(master), B115200) == 0);
+    CHECK(write(master, stream, len) == len);
+    int avail = 0;
+    for (int i = 0; i < 100 && avail < len; i++){
+        port.waitRecv(10);
+        ioctl(port.getFd(), FIONREAD, &avail);
+    }
+    CHECK(avail == len);
+
+    ZBeeStack* zb = new ZBeeStack();
+    zb->setSerialPort(&port);
+    zb->setRxHandler(rxHandler, &out);
+    out.len = 0;
+    zb->readPacket();
+    CHECK(countFrames(&out) == 1);
+    CHECK(zb->getRxQueCount() == ZB_RX_QUE_SIZE - 1);   // the rest stays in the SerialPort
+    CHECK(zb->getRxQueHighWater() == ZB_RX_QUE_SIZE);
+    for (int i = 0; i < frames * 2 && countFrames(&out) < frames; i++){
+        zb->readPacket();
+    }
+    CHECK(countFrames(&out) == frames);
+    CHECK(zb->getRxQueCount() == 0);
+    CHECK(zb->getRxDropCount() == 0);
+    CHECK(zb->getRxRejectCount() == 0);
+    CHECK(ZBeeStackTest::rxPoolUsed(zb) == 0);
+
+    /*---- frames of other radios after the Gateway is known ----*/
+    XBeeAddress64 gw(0x0013a200, 0x40000001);
+    zb->addGwAddress(gw);
+    out.len = 0;
+    CHECK(write(master, stream, len) == len);
+    for (int i = 0; i < frames * 4 && zb->getRxRejectCount() < frames - 1; i++){
+        zb->waitPacket(10);
+        zb->readPacket();
+    }
+    CHECK(countFrames(&out) == 1);
+    CHECK(zb->getRxRejectCount() == frames - 1);
+    CHECK(zb->getRxDropCount() == 0);
+    CHECK((ZBeeStackTest::rxPoolUsed(zb) & (ZBeeStackTest::rxPoolUsed(zb) - 1)) == 0);   // the parser keeps one buffer
+    delete zb;
+    close(master);
+}
+
+/*
+ *  Frames are dropped while no pool buffer is free, and the parser
+ *  goes on with the next frame once one is returned.
+ */
+static void testPoolExhausted(){
+    uint8_t stream[MAX_STREAM];
+    uint8_t payload[4] = {1, 2, 3, 4};
+    uint16_t len = 0;
+    static Output out;
+
+    for (int i = 0; i < 3; i++){
+        len = addRxFrame(stream, len, 0x40000000, 0x0001, payload, sizeof(payload), false);
+    }
+    ZBeeStack* zb = new ZBeeStack();
+    zb->setRxHandler(rxHandler, &out);
+    out.len = 0;
+
+    ZBeeStackTest::rxPoolUsed(zb) = ((uint32_t)1 << ZB_RX_POOL_SIZE) - 1;
+    CHECK(zb->parseApiFrame(stream, len) == len);
+    CHECK(zb->getRxQueCount() == 0);
+    CHECK(zb->getRxDropCount() == 3);
+
+    ZBeeStackTest::rxPoolUsed(zb) = 0;
+    feed(zb, stream, len);
+    CHECK(countFrames(&out) == 3);
+    CHECK(zb->getRxDropCount() == 3);
+
+    ZBeeStackTest::rxPoolUsed(zb) = ((uint32_t)1 << ZB_RX_POOL_SIZE) - 2;   // one left
+    uint16_t used = zb->parseApiFrame(stream, len);
+    CHECK(used == len);
+    CHECK(zb->getRxQueCount() == 1);
+    CHECK(zb->getRxDropCount() == 5);
+    delete zb;
+}
+
+int main(int argc, char** argv){
+    testSplit();
+    testBurst();
+    testPoolExhausted();
+    return testResult("ParserTest");
+}
@@ -0,0 +1,184 @@
+/*
+ * SendQueTest.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  SendQue on its pool of SENDQ_SIZE slots: the order of the requests,
+ *  the reuse of the freed slots, and a full queue against an exhausted
+ *  pool (MQTTS_ERR_POOL_EXHAUSTED and getExhaustedCount()).
+ *
+ *  $ SendQueTest
+ *
+ *  Linux only.
+ */
+
+#include "../mqttslib/MqttsClient.h"
+#include "TestUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace tomyClient;
+
+#define CHURN_STEPS  10000
+
+static uint8_t theFrame[4];
+
+/*
+ *  Frame of 4 bytes, the tag in the last one.
+ */
+static uint8_t* frame(uint8_t type, uint8_t tag){
+    theFrame[0] = sizeof(theFrame);
+    theFrame[1] = type;
+    theFrame[2] = 0;
+    theFrame[3] = tag;
+    return theFrame;
+}
+
+static int tagOf(SendQue* que, uint8_t index){
+    MqttsMessage* msg = que->getMessage(index);
+    return msg ? msg->getMsgBuff()[3] : -1;
+}
+
+/*
+ *  Requests are kept in order, a priority one goes to the top,
+ *  a deleted one closes the gap.
+ */
+static void testOrder(){
+    SendQue que;
+    CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, 1)) == 0);
+    CHECK(que.addRequest(frame(MQTTS_TYPE_SUBSCRIBE, 2)) == 1);
+    CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, 3)) == 2);
+    CHECK(que.addPriorityRequest(frame(MQTTS_TYPE_PINGREQ, 4)) == 0);
+    CHECK(que.getCount() == 4);
+    CHECK(tagOf(&que, 0) == 4 && tagOf(&que, 1) == 1 && tagOf(&que, 2) == 2 && tagOf(&que, 3) == 3);
+    CHECK(que.getMessage(0)->getType() == MQTTS_TYPE_PINGREQ);
+    CHECK(que.getMessage(2)->getType() == MQTTS_TYPE_SUBSCRIBE);
+    CHECK(que.getMessage(0)->getLength() == sizeof(theFrame));
+
+    que.setStatus(2, MQTTS_MSG_WAIT_ACK);
+    CHECK(que.deleteRequest(1) == 0);
+    CHECK(que.getCount() == 3);
+    CHECK(tagOf(&que, 0) == 4 && tagOf(&que, 1) == 2 && tagOf(&que, 2) == 3);
+    CHECK(que.getStatus(1) == MQTTS_MSG_WAIT_ACK);
+    CHECK(que.getMessage(3) == NULL);
+    CHECK(que.getStatus(3) == -1);
+    CHECK(que.deleteRequest(3) == -2);
+}
+
+/*
+ *  A freed slot is taken by the next request with a fresh copy and status,
+ *  and only SENDQ_SIZE slots are ever used.
+ */
+static void testReuse(){
+    SendQue que;
+    MqttsMessage* seen[SENDQ_SIZE];
+    int nSeen = 0;
+
+    que.addRequest(frame(MQTTS_TYPE_PUBLISH, 1));
+    que.addRequest(frame(MQTTS_TYPE_PUBLISH, 2));
+    MqttsMessage* freed = que.getMessage(0);
+    que.setStatus(0, MQTTS_MSG_WAIT_ACK);
+    que.deleteRequest(0);
+    que.addRequest(frame(MQTTS_TYPE_SUBSCRIBE, 3));
+    CHECK(que.getMessage(1) == freed);
+    CHECK(tagOf(&que, 1) == 3);
+    CHECK(que.getMessage(1)->getType() == MQTTS_TYPE_SUBSCRIBE);
+    CHECK(que.getStatus(1) == 0);
+    que.deleteAllRequest();
+    CHECK(que.getCount() == 0);
+
+    bool fresh = true;
+    bool extra = false;
+    srand(22);
+    for (int step = 0; step < CHURN_STEPS; step++){
+        if (que.getCount() < SENDQ_SIZE && (que.getCount() == 0 || rand() % 2)){
+            uint8_t tag = rand() & 0xff;
+            int index = que.addRequest(frame(MQTTS_TYPE_PUBLISH, tag));
+            MqttsMessage* msg = que.getMessage(index);
+            fresh = fresh && msg && msg->getMsgBuff()[3] == tag && msg->getStatus() == 0;
+            int i;
+            for (i = 0; i < nSeen && seen[i] != msg; i++){
+            }
+            if (i == nSeen){
+                if (nSeen == SENDQ_SIZE){
+                    extra = true;
+                }else{
+                    seen[nSeen++] = msg;
+                }
+            }
+            que.setStatus(index, MQTTS_MSG_WAIT_ACK);
+        }else{
+            que.deleteRequest(rand() % que.getCount());
+        }
+    }
+    CHECK(fresh);
+    CHECK(!extra);
+    CHECK(que.getExhaustedCount() == 0);
+}
+
+/*
+ *  A full queue refuses with MQTTS_ERR_CANNOT_ADD_REQUEST and leaves the
+ *  counter alone. A queue larger than the pool runs out of slots first,
+ *  which is MQTTS_ERR_POOL_EXHAUSTED and counted.
+ */
+static void testFull(){
+    SendQue que;
+    for (int i = 0; i < SENDQ_SIZE; i++){
+        CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, i)) == i);
+    }
+    CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, 0xff)) == MQTTS_ERR_CANNOT_ADD_REQUEST);
+    CHECK(que.addPriorityRequest(frame(MQTTS_TYPE_PINGREQ, 0xff)) == MQTTS_ERR_CANNOT_ADD_REQUEST);
+    CHECK(que.getExhaustedCount() == 0);
+
+    que.setQueSize(SENDQ_SIZE + 1);
+    CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, 0xff)) == MQTTS_ERR_POOL_EXHAUSTED);
+    CHECK(que.addPriorityRequest(frame(MQTTS_TYPE_PINGREQ, 0xff)) == MQTTS_ERR_POOL_EXHAUSTED);
+    CHECK(que.getExhaustedCount() == 2);
+    CHECK(que.getCount() == SENDQ_SIZE);
+    for (int i = 0; i < SENDQ_SIZE; i++){
+        CHECK(tagOf(&que, i) == i);
+    }
+
+    CHECK(que.deleteRequest(0) == 0);
+    CHECK(que.addPriorityRequest(frame(MQTTS_TYPE_PINGREQ, 0xfe)) == 0);
+    CHECK(tagOf(&que, 0) == 0xfe && tagOf(&que, 1) == 1);
+    CHECK(que.getExhaustedCount() == 2);
+
+    que.deleteAllRequest();
+    for (int i = 0; i < SENDQ_SIZE; i++){
+        CHECK(que.addRequest(frame(MQTTS_TYPE_PUBLISH, i)) == i);
+    }
+    CHECK(que.getExhaustedCount() == 2);
+}
+
+int main(int argc, char** argv){
+    testOrder();
+    testReuse();
+    testFull();
+    return testResult("SendQueTest");
+}
@@ -0,0 +1,51 @@
+/*
+ * TestUtil.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  Check counter of the tests. Linux only.
+ */
+
+#include "TestUtil.h"
+#include <stdio.h>
+
+static int theCheckCnt;
+static int theFailCnt;
+
+void check(bool ok, const char* expr, const char* file, int line){
+    theCheckCnt++;
+    if (!ok){
+        theFailCnt++;
+        printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+    }
+}
+
+int testResult(const char* name){
+    printf("%-16s %s  %d checks, %d failed\n", name, (theFailCnt ? "FAIL" : "OK  "), theCheckCnt, theFailCnt);
+    return theFailCnt ? 1 : 0;
+}
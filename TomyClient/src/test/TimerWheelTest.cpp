@@ -0,0 +1,406 @@
+/*
+ * TimerWheelTest.cpp
+ *                       The MIT License (MIT)
+ *
+ *               Copyright (c) 2013, Tomoaki YAMAGUCHI
+ *                       All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  Created on: 2026/10/17
+ *
+ */
+
+/*
+ *  TimerWheel against a plain table of the timers on a fake clock:
+ *  random starts, stops and clock steps up to beyond TW_MAX_DELTA
+ *  (cascades and skipped levels), getNextTimeout() against the earliest
+ *  expiry, periodic timers and callbacks which start and stop timers.
+ *
+ *  $ TimerWheelTest
+ *
+ *  Linux only. Linked with --wrap of XTimer::now() (Makefile).
+ */
+
+#include "../mqttslib/TimerWheel.h"
+#include "TestUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace tomyClient;
+
+#define TIMERS       256
+#define PERIODICS    8          // timers 0..7 may be periodic
+#define FUZZ_STEPS   17000
+
+static uint64_t theNow = 1000000007ULL;
+
+extern "C" uint64_t __wrap__ZN10tomyClient6XTimer3nowEv(){
+    return theNow;              // XTimer::now() of TimerWheel.cpp
+}
+
+/*
+ *  What the wheel should hold.
+ */
+struct Expected {
+    bool     active;
+    uint64_t expires;
+    uint32_t period;
+    int      fired;
+};
+
+static TimerWheel* theWheel;
+static TimerEntry theTimer[TIMERS];
+static Expected theExp[TIMERS];
+static int theEarly;            // fired before the expiry or after stop()
+static bool theMeddle;          // callbacks start and stop timers
+
+static void startTimer(int i, uint32_t msec, uint32_t period){
+    theWheel->start(&theTimer[i], msec, period);
+    theExp[i].active = true;
+    theExp[i].expires = theNow + msec;
+    theExp[i].period = period;
+}
+
+static void stopTimer(int i){
+    theWheel->stop(&theTimer[i]);
+    theExp[i].active = false;
+}
+
+static uint32_t randomMsec(){
+    switch (rand() % 8){
+    case 0:  return rand() % 64;
+    case 1:  return rand() % 4096;
+    case 2:  return rand() % 262144;
+    case 3:  return rand() % (1 << 24);
+    case 4:  return (uint32_t)TW_MAX_DELTA + rand() % (1 << 24);   // clamped, cascaded again
+    default: return rand() % 200;
+    }
+}
+
+static void onFire(TimerEntry* timer){
+    int i = (int)(long)timer->getArg();
+    Expected* e = &theExp[i];
+    if (!e->active || theNow < e->expires){
+        theEarly++;
+    }
+    e->fired++;
+    if (e->period){
+        e->expires += e->period;
+    }else{
+        e->active = false;
+    }
+    if (!theMeddle){
+        return;
+    }
+    switch (rand() % 8){
+    case 0:
+        stopTimer(rand() % TIMERS);         // maybe one due in this pass
+        break;
+    case 1:
+        stopTimer(i);                       // periodic one stops itself
+        break;
+    case 2:
+        startTimer(i, rand() % 100, 0);     // re-arm, maybe due in this pass
+        break;
+    case 3:
+        startTimer(PERIODICS + rand() % (TIMERS - PERIODICS), randomMsec(), 0);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ *  Earliest expiry from now, brute force over the table.
+ */
+static uint64_t earliest(){
+    uint64_t tm = 0xffffffffffffffffULL;
+    for (int i = 0; i < TIMERS; i++){
+        if (theExp[i].active){
+            uint64_t d = (theExp[i].expires > theNow ? theExp[i].expires - theNow : 0);
+            if (d < tm){
+                tm = d;
+            }
+        }
+    }
+    return tm;
+}
+
+static int activeCount(){
+    int cnt = 0;
+    for (int i = 0; i < TIMERS; i++){
+        cnt += theExp[i].active;
+    }
+    return cnt;
+}
+
+static bool noneDue(){
+    for (int i = 0; i < TIMERS; i++){
+        if (theExp[i].active && theExp[i].expires <= theNow){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void reset(){
+    for (int i = 0; i < TIMERS; i++){
+        theTimer[i].setCallback(onFire, (void*)(long)i);
+        theExp[i].active = false;
+        theExp[i].fired = 0;
+    }
+    theEarly = 0;
+    theMeddle = false;
+}
+
+/*
+ *  Random starts, stops and clock steps. After each expire() no due timer
+ *  is left, and getNextTimeout() is not later than the earliest expiry
+ *  nor 0 while nothing is due.
+ */
+static void testFuzz(){
+    TimerWheel wheel;
+    theWheel = &wheel;
+    reset();
+    theMeddle = true;
+    srand(17);
+
+    int late = 0;
+    int busy = 0;
+    int lost = 0;
+    int fired = 0;
+    for (int step = 0; step < FUZZ_STEPS; step++){
+        int i = rand() % TIMERS;
+        switch (rand() % 4){
+        case 0:
+        case 1:
+            if (i < PERIODICS){
+                startTimer(i, randomMsec() % 300000, 1000 + rand() % 300000);
+            }else{
+                startTimer(i, randomMsec(), 0);
+            }
+            break;
+        case 2:
+            stopTimer(i);
+            break;
+        default:
+            break;
+        }
+
+        uint32_t next = wheel.getNextTimeout();
+        uint64_t min = earliest();
+        if (min == 0){
+            min = 1;                            // started at 0 msec after expire(), runs at the next msec
+        }
+        if (activeCount() == 0 ? next != XTIMER_INFINITE : next > min){
+            late++;
+        }
+
+        switch (rand() % 16){
+        case 0:
+            theNow += rand() % (1 << 26);       // long sleep, up to 18 hours
+            break;
+        case 1:
+        case 2:
+        case 3:
+            theNow += rand() % 5000;
+            break;
+        case 4:
+        case 5:
+        case 6:
+        case 7:
+            if (next != XTIMER_INFINITE){
+                theNow += next;                 // as the reactor does
+            }
+            break;
+        default:
+            theNow += rand() % 70;
+            break;
+        }
+        fired += wheel.expire();
+        if (!noneDue()){
+            lost++;
+        }
+        if ((int)wheel.getCount() != activeCount()){
+            lost++;
+        }
+        if (wheel.getCount() && wheel.getNextTimeout() == 0){
+            busy++;
+        }
+    }
+    CHECK(fired > FUZZ_STEPS / 4);
+    CHECK(theEarly == 0);
+    CHECK(late == 0);
+    CHECK(lost == 0);
+    CHECK(busy == 0);
+
+    /*---- run out the rest by getNextTimeout() only ----*/
+    theMeddle = false;
+    int steps = 0;
+    while (wheel.getCount() && steps < 100000){
+        for (int i = 0; i < PERIODICS; i++){
+            stopTimer(i);
+        }
+        uint32_t next = wheel.getNextTimeout();
+        if (next == 0 || next > earliest()){
+            late++;
+        }
+        theNow += next;
+        wheel.expire();
+        steps++;
+    }
+    CHECK(wheel.getCount() == 0);
+    CHECK(activeCount() == 0);
+    CHECK(late == 0);
+    CHECK(theEarly == 0);
+    CHECK(wheel.getNextTimeout() == XTIMER_INFINITE);
+}
+
+/*
+ *  A timer in each level fires at its msec exactly when the clock
+ *  follows getNextTimeout().
+ */
+static void testCascade(){
+    static const uint32_t msec[] = {1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+                                    16777215, 16777216, 20000000, 0xfffffffe};
+    int n = sizeof(msec) / sizeof(msec[0]);
+    TimerWheel wheel;
+    theWheel = &wheel;
+    reset();
+    theNow = (theNow | 0xffffff) - 5;           // cross the top level soon
+
+    uint64_t base = theNow;
+    for (int i = 0; i < n; i++){
+        startTimer(i, msec[i], 0);
+    }
+    int exact = 0;
+    while (wheel.getCount()){
+        theNow += wheel.getNextTimeout();
+        wheel.expire();
+        for (int i = 0; i < n; i++){
+            if (theExp[i].fired == 1 && theNow == base + msec[i]){
+                theExp[i].fired++;
+                exact++;
+            }
+        }
+    }
+    CHECK(exact == n);
+    CHECK(theEarly == 0);
+}
+
+/*
+ *  A periodic timer is re-armed from its expiry, not from the time it ran,
+ *  and catches up the periods missed in a long step.
+ */
+static void testPeriodic(){
+    TimerWheel wheel;
+    theWheel = &wheel;
+    reset();
+
+    uint64_t base = theNow;
+    startTimer(0, 10, 20);
+    theNow = base + 9;
+    wheel.expire();
+    CHECK(theExp[0].fired == 0);
+    theNow = base + 10;
+    wheel.expire();
+    CHECK(theExp[0].fired == 1);
+    CHECK(wheel.getNextTimeout() == 20);
+    theNow = base + 35;                         // late by 5
+    wheel.expire();
+    CHECK(theExp[0].fired == 2);
+    CHECK(wheel.getNextTimeout() == 15);        // 50, not 55
+    theNow = base + 110;                        // 50, 70, 90, 110
+    wheel.expire();
+    CHECK(theExp[0].fired == 6);
+    CHECK(theTimer[0].isActive());
+    CHECK(wheel.getCount() == 1);
+    CHECK(theEarly == 0);
+}
+
+static int theStopped;
+
+static void stopOther(TimerEntry* timer){
+    theWheel->stop(&theTimer[1]);
+    theWheel->stop(timer);
+    theStopped++;
+}
+
+static void stopSelf(TimerEntry* timer){
+    theWheel->stop(timer);
+    theStopped++;
+}
+
+static void restartSelf(TimerEntry* timer){
+    if (++theStopped < 3){
+        theWheel->start(timer, 0);              // due again in this pass
+    }
+}
+
+/*
+ *  Callbacks stop themselves and other timers of the same slot, and
+ *  restart themselves.
+ */
+static void testStopFromCallback(){
+    TimerWheel wheel;
+    theWheel = &wheel;
+    reset();
+    uint64_t base = theNow;
+
+    /*---- stop the next timer of the same slot ----*/
+    theTimer[0].setCallback(stopOther, NULL);
+    startTimer(0, 5, 0);
+    startTimer(1, 5, 0);
+    theStopped = 0;
+    theNow = base + 5;
+    CHECK(wheel.expire() == 1);
+    CHECK(theStopped == 1);
+    CHECK(theExp[1].fired == 0);
+    CHECK(!theTimer[1].isActive());
+    CHECK(wheel.getCount() == 0);
+
+    /*---- periodic one stops itself: no re-arm is left behind ----*/
+    theTimer[2].setCallback(stopSelf, NULL);
+    wheel.start(&theTimer[2], 1, 1);
+    theStopped = 0;
+    theNow += 100;
+    CHECK(wheel.expire() == 1);
+    CHECK(theStopped == 1);
+    CHECK(!theTimer[2].isActive());
+    CHECK(wheel.getCount() == 0);
+    CHECK(wheel.getNextTimeout() == XTIMER_INFINITE);
+
+    /*---- one shot restarts itself ----*/
+    theTimer[3].setCallback(restartSelf, NULL);
+    wheel.start(&theTimer[3], 7);
+    theStopped = 0;
+    theNow += 7;
+    CHECK(wheel.expire() == 3);
+    CHECK(theStopped == 3);
+    CHECK(wheel.getCount() == 0);
+}
+
+int main(int argc, char** argv){
+    testPeriodic();
+    testStopFromCallback();
+    testCascade();
+    testFuzz();
+    return testResult("TimerWheelTest");
+}